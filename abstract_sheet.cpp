@@ -0,0 +1,336 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "abstract_sheet.h"
+
+#include "columnar_sheet.h"
+#include "sparse_sheet.h"
+
+
+namespace {
+
+// Wide sheets with few filled cells waste most of a dense column store. A
+// sparse sheet only goes back once it is twice as full, so that a sheet
+// near the line is not converted back and forth.
+bool prefersSparse(const int rows, const int columns, const qint64 cells, const bool sparse)
+{
+    const qint64 area = qint64(rows) * columns;
+    if (area < SparseSheet::BlockRows * SparseSheet::BlockColumns)
+        return false;
+
+    return cells * (sparse ? 10 : 20) < area;
+}
+
+} // namespace
+
+
+AbstractSheet::AbstractSheet(const QSharedPointer<StringPool> &pool)
+    : m_stringPool{pool}
+    , m_storageBytes{0}
+{
+
+}
+
+
+AbstractSheet::~AbstractSheet()
+{
+
+}
+
+
+AbstractSheet *AbstractSheet::create(const QSharedPointer<StringPool> &pool, const int rows, const int columns, const qint64 cells)
+{
+    if (prefersSparse(rows, columns, cells, false))
+        return new SparseSheet(pool);
+
+    return new ColumnarSheet(pool);
+}
+
+
+AbstractSheet *AbstractSheet::converted() const
+{
+    // A copy in the other storage once the fill ratio has crossed the
+    // line, or null while this one suits the sheet
+    const bool sparse = dynamic_cast<const SparseSheet *>(this);
+    if (prefersSparse(rowCount(), columnCount(), cellCount(), sparse) == sparse)
+        return nullptr;
+
+    AbstractSheet *sheet = sparse ? static_cast<AbstractSheet *>(new ColumnarSheet(m_stringPool)) : new SparseSheet(m_stringPool);
+    copyTo(sheet);
+    sheet->extend(rowCount(), columnCount());
+    sheet->compact();
+
+    return sheet;
+}
+
+
+int AbstractSheet::rowCount() const
+{
+    return m_rows.count();
+}
+
+
+int AbstractSheet::columnCount() const
+{
+    return m_columns.count();
+}
+
+
+double AbstractSheet::fillRatio() const
+{
+    const qint64 area = qint64(rowCount()) * columnCount();
+    if (!area)
+        return 0.0;
+
+    return double(cellCount()) / double(area);
+}
+
+
+//
+// Cells
+//
+
+CellValue AbstractSheet::cell(const int row, const int column) const
+{
+    if (row < 0 || row >= rowCount() || column < 0 || column >= columnCount())
+        return CellValue();
+
+    return storedCell(m_rows.map(row), m_columns.map(column));
+}
+
+
+void AbstractSheet::setCell(const int row, const int column, const CellValue &value)
+{
+    if (row < 0 || column < 0)
+        return;
+
+    if (value.isEmpty()) {
+        // Clearing a cell never grows the sheet
+        if (row < rowCount() && column < columnCount())
+            setStoredCell(m_rows.map(row), m_columns.map(column), value);
+        return;
+    }
+
+    m_rows.extend(row + 1);
+    m_columns.extend(column + 1);
+
+    setStoredCell(m_rows.map(row), m_columns.map(column), value);
+}
+
+
+void AbstractSheet::fetchRange(const int row, const int column, const int rows, const int columns, QVector<CellValue> &values) const
+{
+    values.fill(CellValue(), rows * columns);
+
+    // Resolve the axes once per run instead of once per cell
+    m_rows.forEachRun(row, rows, [&](const SheetAxis::Run &rowRun) {
+        m_columns.forEachRun(column, columns, [&](const SheetAxis::Run &columnRun) {
+            CellValue *first = values.data() + (rowRun.logical - row) * columns + (columnRun.logical - column);
+            fetchStoredRange(rowRun.physical, columnRun.physical, rowRun.length, columnRun.length, first, columns);
+        });
+    });
+}
+
+
+void AbstractSheet::fetchStoredRange(const int row, const int column, const int rows, const int columns, CellValue *values, const int stride) const
+{
+    for (int r = 0; r < rows; ++r)
+        for (int c = 0; c < columns; ++c)
+            values[r * stride + c] = storedCell(row + r, column + c);
+}
+
+
+void AbstractSheet::forEachCell(const CellVisitor &visitor) const
+{
+    if (m_rows.isIdentity() && m_columns.isIdentity()) {
+        forEachStoredCell(visitor);
+        return;
+    }
+
+    const SheetAxis::Inverse rows(m_rows);
+    const SheetAxis::Inverse columns(m_columns);
+
+    forEachStoredCell([&](const int row, const int column, const CellValue &value) {
+        visitor(rows.map(row), columns.map(column), value);
+    });
+}
+
+
+void AbstractSheet::copyTo(AbstractSheet *sheet) const
+{
+    forEachCell([sheet](const int row, const int column, const CellValue &value) {
+        sheet->setCell(row, column, value);
+    });
+    sheet->m_columnTitles = m_columnTitles;
+}
+
+
+void AbstractSheet::compact()
+{
+
+}
+
+
+//
+// Memory
+//
+
+void AbstractSheet::addMemoryUsage(MemoryUsage &usage) const
+{
+    usage.add(MemoryUsage::CellStorage, m_storageBytes);
+    usage.add(MemoryUsage::Indexes, m_rows.byteSize() + m_columns.byteSize() + indexBytes());
+}
+
+
+void AbstractSheet::addStorageBytes(const qint64 size)
+{
+    m_storageBytes += size;
+}
+
+
+qint64 AbstractSheet::indexBytes() const
+{
+    return 0;
+}
+
+
+//
+// Rows and columns
+//
+
+void AbstractSheet::extend(const int rows, const int columns)
+{
+    // Bulk loaders fill storage first and grow the axes once
+    m_rows.extend(rows);
+    m_columns.extend(columns);
+}
+
+
+void AbstractSheet::appendStoredRows(const int row, const int count)
+{
+    m_rows.append(row, count);
+}
+
+
+void AbstractSheet::appendStoredColumns(const int column, const int count)
+{
+    m_columns.append(column, count);
+}
+
+
+void AbstractSheet::insertRows(const int row, const int count)
+{
+    if (row < 0 || row > rowCount())
+        return;
+
+    m_rows.insert(row, count);
+}
+
+
+void AbstractSheet::removeRows(const int row, const int count)
+{
+    if (row < 0 || row >= rowCount())
+        return;
+
+    // Removed storage is cleared so that it never shows up in scans
+    m_rows.remove(row, qMin(count, rowCount() - row), [this](const SheetAxis::Run &run) {
+        clearStoredRows(run.physical, run.length);
+    });
+}
+
+
+void AbstractSheet::insertColumns(const int column, const int count)
+{
+    if (column < 0 || column > columnCount())
+        return;
+
+    m_columns.insert(column, count);
+
+    for (int index = 0; index < count && column < m_columnTitles.size(); ++index)
+        m_columnTitles.insert(column, QString());
+}
+
+
+void AbstractSheet::removeColumns(const int column, const int count)
+{
+    if (column < 0 || column >= columnCount())
+        return;
+
+    m_columns.remove(column, qMin(count, columnCount() - column), [this](const SheetAxis::Run &run) {
+        clearStoredColumns(run.physical, run.length);
+    });
+
+    if (column < m_columnTitles.size())
+        m_columnTitles.erase(m_columnTitles.begin() + column, m_columnTitles.begin() + qMin(column + count, m_columnTitles.size()));
+}
+
+
+QString AbstractSheet::columnTitle(const int column) const
+{
+    return m_columnTitles.value(column);
+}
+
+
+QStringList AbstractSheet::columnTitles() const
+{
+    return m_columnTitles;
+}
+
+
+void AbstractSheet::setColumnTitles(const QStringList &titles)
+{
+    m_columnTitles = titles;
+}
+
+
+const SheetAxis &AbstractSheet::rowAxis() const
+{
+    return m_rows;
+}
+
+
+const SheetAxis &AbstractSheet::columnAxis() const
+{
+    return m_columns;
+}
+
+
+//
+// Strings
+//
+
+QSharedPointer<StringPool> AbstractSheet::stringPool() const
+{
+    return m_stringPool;
+}
+
+
+QString AbstractSheet::string(const quint32 id) const
+{
+    return m_stringPool->string(id);
+}
+
+
+quint32 AbstractSheet::internString(const QString &text)
+{
+    return m_stringPool->intern(text);
+}
@@ -0,0 +1,112 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ABSTRACT_SHEET_H
+#define ABSTRACT_SHEET_H
+
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <functional>
+
+#include "cell_value.h"
+#include "memory_usage.h"
+#include "sheet_axis.h"
+#include "string_pool.h"
+
+
+class AbstractSheet
+{
+public:
+    using CellVisitor = std::function<void(const int row, const int column, const CellValue &value)>;
+
+    explicit AbstractSheet(const QSharedPointer<StringPool> &pool);
+    virtual ~AbstractSheet();
+
+    virtual AbstractSheet *clone() const = 0;
+
+    static AbstractSheet *create(const QSharedPointer<StringPool> &pool, const int rows, const int columns, const qint64 cells);
+    AbstractSheet *converted() const;
+
+    int rowCount() const;
+    int columnCount() const;
+    virtual qint64 cellCount() const = 0;
+    double fillRatio() const;
+
+    CellValue cell(const int row, const int column) const;
+    void setCell(const int row, const int column, const CellValue &value);
+
+    void fetchRange(const int row, const int column, const int rows, const int columns, QVector<CellValue> &values) const;
+    void forEachCell(const CellVisitor &visitor) const;
+    void copyTo(AbstractSheet *sheet) const;
+
+    virtual void compact();
+
+    void addMemoryUsage(MemoryUsage &usage) const;
+
+    void extend(const int rows, const int columns);
+    void appendStoredRows(const int row, const int count);
+    void appendStoredColumns(const int column, const int count);
+    void insertRows(const int row, const int count);
+    void removeRows(const int row, const int count);
+    void insertColumns(const int column, const int count);
+    void removeColumns(const int column, const int count);
+
+    QString columnTitle(const int column) const;
+    QStringList columnTitles() const;
+    void setColumnTitles(const QStringList &titles);
+
+    const SheetAxis &rowAxis() const;
+    const SheetAxis &columnAxis() const;
+
+    QSharedPointer<StringPool> stringPool() const;
+    QString string(const quint32 id) const;
+    quint32 internString(const QString &text);
+
+protected:
+    // Storage is addressed by physical row and column; the axes map
+    // logical positions onto it
+    virtual CellValue storedCell(const int row, const int column) const = 0;
+    virtual void setStoredCell(const int row, const int column, const CellValue &value) = 0;
+    virtual void fetchStoredRange(const int row, const int column, const int rows, const int columns, CellValue *values, const int stride) const;
+    virtual void forEachStoredCell(const CellVisitor &visitor) const = 0;
+    virtual void clearStoredRows(const int row, const int count) = 0;
+    virtual void clearStoredColumns(const int column, const int count) = 0;
+
+    // Storage keeps a running byte count so that reporting never walks the cells
+    void addStorageBytes(const qint64 size);
+    virtual qint64 indexBytes() const;
+
+private:
+    QSharedPointer<StringPool> m_stringPool;
+    qint64 m_storageBytes;
+
+    SheetAxis m_rows;
+    SheetAxis m_columns;
+
+    // By logical column, as read from a header row
+    QStringList m_columnTitles;
+};
+
+#endif // ABSTRACT_SHEET_H
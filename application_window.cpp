@@ -28,27 +28,35 @@
 #include <QClipboard>
 #include <QCloseEvent>
 #include <QDebug>
+#include <QDir>
 #include <QFileDialog>
 #include <QMdiSubWindow>
 #include <QMenuBar>
 #include <QMessageBox>
 #include <QMetaEnum>
+#include <QPushButton>
 #include <QScreen>
 #include <QSettings>
 #include <QStatusBar>
 #include <QTabWidget>
+#include <QTimer>
 #include <QToolBar>
 #include <QUrl>
 
 #include "about_dialog.h"
 #include "colophon_dialog.h"
 #include "confirmation_dialog.h"
+#include "csv_dialect.h"
+#include "csv_index.h"
 #include "document_manager.h"
 #include "document_widget.h"
 #include "document_window.h"
+#include "edit_journal.h"
+#include "import_dialog.h"
 #include "preferences_dialog.h"
 #include "properties_dialog.h"
 #include "recent_document_list.h"
+#include "workbook_file.h"
 
 
 ApplicationWindow::ApplicationWindow(QWidget *parent)
@@ -78,6 +86,9 @@ ApplicationWindow::ApplicationWindow(QWidget *parent)
 
     documentActivated(nullptr);
     documentClosed();
+
+    // Once the window is up and the documents of the command line are open
+    QTimer::singleShot(0, this, &ApplicationWindow::recoverDocuments);
 }
 
 ApplicationWindow::~ApplicationWindow()
@@ -971,10 +982,47 @@ bool ApplicationWindow::openDocument(const QUrl &url)
 
 bool ApplicationWindow::loadDocument(const QUrl &url)
 {
-    DocumentWidget *document = createDocument();
-    if (!true) {
+    QString errorString;
+    DocumentWidget *document = nullptr;
+    bool loaded = false;
+
+    if (WorkbookFile::isWorkbookFile(url.toLocalFile())) {
+        // Workbooks know their own layout
+        document = createDocument();
+        loaded = document->loadWorkbook(url, &errorString);
+    }
+    else {
+        // Files that are unchanged since they were last read are read the
+        // same way again; for all others the format is guessed from the
+        // start of the file and can be corrected before anything is read
+        CsvDialect dialect;
+        CsvIndex index;
+        if (index.load(url.toLocalFile())) {
+            dialect = index.dialect();
+        }
+        else {
+            if (!CsvDialect::sniffFile(url.toLocalFile(), &dialect, &errorString)) {
+                const QString title = tr("Could Not Open Document");
+                const QString text = tr("The document <em>%1</em> could not be opened.<br>%2").arg(url.toDisplayString(QUrl::PreferLocalFile), errorString);
+                QMessageBox::critical(this, title, text);
+                return false;
+            }
+
+            if (!ImportDialog::getDialect(this, url.toLocalFile(), &dialect))
+                return false;
+        }
+
+        document = createDocument();
+        loaded = document->load(url, dialect, &errorString);
+    }
+
+    if (!loaded) {
         // Given document could not be loaded
         document->close();
+
+        const QString title = tr("Could Not Open Document");
+        const QString text = tr("The document <em>%1</em> could not be opened.<br>%2").arg(url.toDisplayString(QUrl::PreferLocalFile), errorString);
+        QMessageBox::critical(this, title, text);
         return false;
     }
 
@@ -990,14 +1038,71 @@ bool ApplicationWindow::loadDocument(const QUrl &url)
 
 bool ApplicationWindow::saveDocument(DocumentWidget *document, const QUrl &altUrl)
 {
-    Q_UNUSED(altUrl)
+    // The file is written in the background; the document only counts as
+    // saved once it is complete on disk
+    const QUrl url = altUrl.isEmpty() ? document->url() : altUrl;
+
+    QString errorString;
+    if (!document->save(url, !altUrl.isEmpty(), &errorString)) {
 
-    document->resetModified();
+        const QString title = tr("Could Not Save Document");
+        const QString text = tr("The document <em>%1</em> could not be saved.<br>%2").arg(url.toDisplayString(QUrl::PreferLocalFile), errorString);
+        QMessageBox::critical(this, title, text);
+        return false;
+    }
 
     return true;
 }
 
 
+void ApplicationWindow::recoverDocuments()
+{
+    // Journals that no running session holds on to were left by one that
+    // did not close its documents
+    const QStringList journals = EditJournal::orphanedJournals();
+    if (journals.isEmpty())
+        return;
+
+    QMessageBox box(QMessageBox::Question, tr("Recover Documents"),
+                    tr("The application was not shut down properly. Unsaved changes to %n document(s) can be recovered.", nullptr, journals.size()),
+                    QMessageBox::NoButton, this);
+    QPushButton *recoverButton = box.addButton(tr("Recover"), QMessageBox::AcceptRole);
+    box.addButton(tr("Discard"), QMessageBox::DestructiveRole);
+    box.setDefaultButton(recoverButton);
+    box.exec();
+
+    QStringList failures;
+    for (const QString &journal : journals) {
+
+        if (box.clickedButton() == recoverButton) {
+            // Edits are replayed onto the file as it was last saved
+            const QString fileName = EditJournal::documentFileName(journal);
+            const QUrl url = QUrl::fromLocalFile(fileName);
+
+            QString errorString = tr("The document could not be opened.");
+            DocumentWidget *document = nullptr;
+            if (!fileName.isEmpty() && openDocument(url))
+                document = extractDocument(m_documentManager->findSubWindow(url));
+
+            // A journal is the only copy of its edits, so it is kept until
+            // they are recovered
+            if (!document || !document->recoverJournal(journal, &errorString)) {
+                failures.append(tr("<em>%1</em>: %2").arg(QDir::toNativeSeparators(fileName), errorString));
+                continue;
+            }
+        }
+
+        EditJournal::remove(journal);
+    }
+
+    if (!failures.isEmpty()) {
+        const QString title = tr("Could Not Recover Documents");
+        const QString text = tr("The changes to these documents could not be recovered:<br>%1<br><br>Their journals were kept and are offered again on the next start.").arg(failures.join(QStringLiteral("<br>")));
+        QMessageBox::warning(this, title, text);
+    }
+}
+
+
 //
 //
 //
@@ -1283,7 +1388,7 @@ void ApplicationWindow::slotProperties()
     if (!document)
         return;
 
-    auto *dialog = new PropertiesDialog(document->url(), this);
+    auto *dialog = new PropertiesDialog(document, this);
     dialog->open();
 }
 
@@ -90,6 +90,7 @@ private slots:
     void documentModifiedChanged(const bool modified);
     void documentUrlChanged(const QUrl &url);
     void documentClosed();
+    void recoverDocuments();
 
 private:
     DocumentWidget *extractDocument(const QMdiSubWindow *subWindow) const;
@@ -0,0 +1,122 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "arena.h"
+
+#include <QFile>
+#include <QMutexLocker>
+
+#include <cstdlib>
+#include <new>
+
+
+Arena::Arena(const qsizetype blockSize)
+    : m_blockSize{blockSize}
+    , m_current{nullptr}
+    , m_end{nullptr}
+    , m_bytes{0}
+    , m_used{0}
+{
+
+}
+
+
+Arena::~Arena()
+{
+    clear();
+}
+
+
+void *Arena::allocate(const qsizetype size, const qsizetype alignment)
+{
+    QMutexLocker locker(&m_mutex);
+
+    auto current = reinterpret_cast<quintptr>(m_current);
+    auto aligned = (current + quintptr(alignment - 1)) & ~quintptr(alignment - 1);
+
+    if (!m_current || aligned + quintptr(size) > reinterpret_cast<quintptr>(m_end)) {
+
+        // Oversized requests get a block of their own and leave the current block alone
+        const qsizetype blockSize = qMax(m_blockSize, size + alignment);
+        auto *block = static_cast<char *>(std::malloc(size_t(blockSize)));
+        if (!block)
+            throw std::bad_alloc();
+
+        m_blocks.append(block);
+        m_bytes += blockSize;
+
+        current = reinterpret_cast<quintptr>(block);
+        aligned = (current + quintptr(alignment - 1)) & ~quintptr(alignment - 1);
+
+        if (blockSize > m_blockSize) {
+            m_used += size;
+            return reinterpret_cast<void *>(aligned);
+        }
+
+        m_end = block + blockSize;
+    }
+
+    m_current = reinterpret_cast<char *>(aligned + quintptr(size));
+    m_used += size;
+
+    return reinterpret_cast<void *>(aligned);
+}
+
+
+void Arena::clear()
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (char *block : qAsConst(m_blocks))
+        std::free(block);
+
+    m_blocks.clear();
+    m_current = nullptr;
+    m_end = nullptr;
+    m_bytes = 0;
+    m_used = 0;
+}
+
+
+void Arena::addMappedFile(const QSharedPointer<QFile> &file)
+{
+    // Mappings last as long as the arena, clear() leaves them alone
+    QMutexLocker locker(&m_mutex);
+
+    m_mappedFiles.append(file);
+}
+
+
+qint64 Arena::byteSize() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    return m_bytes;
+}
+
+
+qint64 Arena::usedSize() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    return m_used;
+}
@@ -0,0 +1,71 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <QMutex>
+#include <QSharedPointer>
+#include <QVector>
+#include <QtGlobal>
+
+class QFile;
+
+
+class Arena
+{
+public:
+    explicit Arena(const qsizetype blockSize = 1 << 20);
+    ~Arena();
+
+    void *allocate(const qsizetype size, const qsizetype alignment = alignof(qint64));
+
+    template <typename T>
+    T *allocateArray(const qsizetype count)
+    {
+        return static_cast<T *>(allocate(count * qsizetype(sizeof(T)), qsizetype(alignof(T))));
+    }
+
+    void clear();
+
+    void addMappedFile(const QSharedPointer<QFile> &file);
+
+    qint64 byteSize() const;
+    qint64 usedSize() const;
+
+private:
+    Q_DISABLE_COPY(Arena)
+
+    mutable QMutex m_mutex;
+
+    qsizetype m_blockSize;
+    QVector<char *> m_blocks;
+    char *m_current;
+    char *m_end;
+    qint64 m_bytes;
+    qint64 m_used;
+
+    // Opened workbooks, whose mappings strings and chunks point into
+    QVector<QSharedPointer<QFile>> m_mappedFiles;
+};
+
+#endif // ARENA_H
@@ -0,0 +1,492 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cell_value.h"
+
+#include <QDateTime>
+#include <QHash>
+#include <QLocale>
+
+#include <cstring>
+
+#include "string_pool.h"
+
+
+static_assert(sizeof(CellValue) == 16, "CellValue must stay 16 bytes");
+
+
+CellValue::CellValue()
+    : m_data{}
+    , m_size{0}
+    , m_type{Empty}
+{
+
+}
+
+
+//
+// Construction
+//
+
+CellValue CellValue::fromInteger(const qint64 value)
+{
+    CellValue cell;
+    cell.m_type = Integer;
+    std::memcpy(cell.m_data, &value, sizeof(value));
+
+    return cell;
+}
+
+
+CellValue CellValue::fromReal(const double value)
+{
+    CellValue cell;
+    cell.m_type = Real;
+    std::memcpy(cell.m_data, &value, sizeof(value));
+
+    return cell;
+}
+
+
+CellValue CellValue::fromBoolean(const bool value)
+{
+    CellValue cell;
+    cell.m_type = Boolean;
+    cell.m_data[0] = value;
+
+    return cell;
+}
+
+
+// Milliseconds since the epoch; date and time values carry no time zone
+// and are kept as if they were UTC
+CellValue CellValue::fromDateTime(const qint64 msecs)
+{
+    CellValue cell;
+    cell.m_type = DateTime;
+    std::memcpy(cell.m_data, &msecs, sizeof(msecs));
+
+    return cell;
+}
+
+
+CellValue CellValue::fromError(const ErrorCode code)
+{
+    CellValue cell;
+    cell.m_type = Error;
+    cell.m_data[0] = char(code);
+
+    return cell;
+}
+
+
+CellValue CellValue::fromPooledText(const quint32 id)
+{
+    CellValue cell;
+    cell.m_type = PooledText;
+    std::memcpy(cell.m_data, &id, sizeof(id));
+
+    return cell;
+}
+
+
+CellValue CellValue::fromText(QStringView text, StringPool *pool)
+{
+    if (text.isEmpty())
+        return CellValue();
+
+    CellValue cell;
+    if (toInlineText(text, &cell))
+        return cell;
+
+    Q_ASSERT(pool);
+    return fromPooledText(pool->intern(text));
+}
+
+
+// Encodes text as UTF-8 into the cell itself; fails for text that does not
+// fit or does not survive the round trip
+bool CellValue::toInlineText(QStringView text, CellValue *value)
+{
+    // Every UTF-16 unit takes at least one UTF-8 byte
+    if (text.size() > InlineSize)
+        return false;
+
+    CellValue cell;
+    cell.m_type = InlineText;
+
+    int size = 0;
+    for (int index = 0; index < text.size(); ++index) {
+
+        uint code = text.at(index).unicode();
+        if (QChar::isSurrogate(code)) {
+            // Unpaired surrogates do not survive a UTF-8 round trip
+            if (!QChar::isHighSurrogate(code) || index + 1 >= text.size() || !text.at(index + 1).isLowSurrogate())
+                return false;
+            code = QChar::surrogateToUcs4(char16_t(code), text.at(++index).unicode());
+        }
+
+        const int length = code < 0x80 ? 1 : code < 0x800 ? 2 : code < 0x10000 ? 3 : 4;
+        if (size + length > InlineSize)
+            return false;
+
+        auto *bytes = reinterpret_cast<uchar *>(cell.m_data + size);
+        switch (length) {
+        case 1:
+            bytes[0] = uchar(code);
+            break;
+        case 2:
+            bytes[0] = uchar(0xc0 | (code >> 6));
+            bytes[1] = uchar(0x80 | (code & 0x3f));
+            break;
+        case 3:
+            bytes[0] = uchar(0xe0 | (code >> 12));
+            bytes[1] = uchar(0x80 | ((code >> 6) & 0x3f));
+            bytes[2] = uchar(0x80 | (code & 0x3f));
+            break;
+        default:
+            bytes[0] = uchar(0xf0 | (code >> 18));
+            bytes[1] = uchar(0x80 | ((code >> 12) & 0x3f));
+            bytes[2] = uchar(0x80 | ((code >> 6) & 0x3f));
+            bytes[3] = uchar(0x80 | (code & 0x3f));
+            break;
+        }
+        size += length;
+    }
+
+    cell.m_size = quint8(size);
+    *value = cell;
+    return true;
+}
+
+
+CellValue CellValue::fromUtf8(const char *data, const int size, StringPool *pool)
+{
+    if (size <= 0)
+        return CellValue();
+
+    // Already in the inline encoding; nothing to convert
+    if (size <= InlineSize) {
+        CellValue cell;
+        cell.m_type = InlineText;
+        cell.m_size = quint8(size);
+        std::memcpy(cell.m_data, data, size_t(size));
+        return cell;
+    }
+
+    Q_ASSERT(pool);
+    return fromPooledText(pool->internUtf8(data, size));
+}
+
+
+CellValue CellValue::fromVariant(const QVariant &value, StringPool *pool)
+{
+    if (value.isNull())
+        return CellValue();
+
+    switch (value.userType()) {
+    case QMetaType::Bool:
+        return fromBoolean(value.toBool());
+    case QMetaType::Int:
+    case QMetaType::UInt:
+    case QMetaType::Long:
+    case QMetaType::ULong:
+    case QMetaType::LongLong:
+    case QMetaType::ULongLong:
+    case QMetaType::Short:
+    case QMetaType::UShort:
+        return fromInteger(value.toLongLong());
+    case QMetaType::Double:
+    case QMetaType::Float:
+        return fromReal(value.toDouble());
+    case QMetaType::QDate:
+        return fromDateTime(QDateTime(value.toDate(), QTime(0, 0), Qt::UTC).toMSecsSinceEpoch());
+    case QMetaType::QDateTime:
+        return fromDateTime(value.toDateTime().toMSecsSinceEpoch());
+    default:
+        return fromText(value.toString(), pool);
+    }
+}
+
+
+//
+// Properties
+//
+
+CellValue::Type CellValue::type() const
+{
+    return m_type;
+}
+
+
+bool CellValue::isEmpty() const
+{
+    return m_type == Empty;
+}
+
+
+bool CellValue::isNumber() const
+{
+    return m_type == Integer || m_type == Real;
+}
+
+
+bool CellValue::isText() const
+{
+    return m_type == InlineText || m_type == PooledText;
+}
+
+
+// Values read from files as they are must be ones this class could have
+// made, with text in a pool of the given size
+bool CellValue::isValid(const int stringCount) const
+{
+    switch (m_type) {
+    case Empty:
+    case Integer:
+    case Real:
+    case Boolean:
+    case DateTime:
+        return true;
+    case Error:
+        return error() <= NotAvailable;
+    case InlineText:
+        return m_size <= InlineSize;
+    case PooledText:
+        return stringId() < quint32(stringCount);
+    default:
+        return false;
+    }
+}
+
+
+//
+// Values
+//
+
+qint64 CellValue::integer() const
+{
+    Q_ASSERT(m_type == Integer);
+
+    qint64 value;
+    std::memcpy(&value, m_data, sizeof(value));
+    return value;
+}
+
+
+double CellValue::real() const
+{
+    Q_ASSERT(m_type == Real);
+
+    double value;
+    std::memcpy(&value, m_data, sizeof(value));
+    return value;
+}
+
+
+bool CellValue::boolean() const
+{
+    Q_ASSERT(m_type == Boolean);
+    return m_data[0];
+}
+
+
+qint64 CellValue::dateTime() const
+{
+    Q_ASSERT(m_type == DateTime);
+
+    qint64 msecs;
+    std::memcpy(&msecs, m_data, sizeof(msecs));
+    return msecs;
+}
+
+
+CellValue::ErrorCode CellValue::error() const
+{
+    Q_ASSERT(m_type == Error);
+    return ErrorCode(m_data[0]);
+}
+
+
+quint32 CellValue::stringId() const
+{
+    Q_ASSERT(m_type == PooledText);
+
+    quint32 id;
+    std::memcpy(&id, m_data, sizeof(id));
+    return id;
+}
+
+
+const char *CellValue::inlineText() const
+{
+    return m_data;
+}
+
+
+int CellValue::inlineSize() const
+{
+    return m_type == InlineText ? m_size : 0;
+}
+
+
+//
+// Conversion
+//
+
+double CellValue::toReal() const
+{
+    switch (m_type) {
+    case Integer:
+        return double(integer());
+    case Real:
+        return real();
+    case Boolean:
+        return boolean() ? 1.0 : 0.0;
+    default:
+        return 0.0;
+    }
+}
+
+
+QString CellValue::toString(const StringPool *pool) const
+{
+    switch (m_type) {
+    case Integer:
+        return QString::number(integer());
+    case Real:
+        return QString::number(real(), 'g', QLocale::FloatingPointShortest);
+    case Boolean:
+        return boolean() ? QStringLiteral("TRUE") : QStringLiteral("FALSE");
+    case DateTime: {
+        // ISO 8601, leaving out whatever is zero at the end
+        const qint64 msecs = dateTime();
+        const QDateTime dateTime = QDateTime::fromMSecsSinceEpoch(msecs, Qt::UTC);
+        if (msecs % 86400000 == 0)
+            return dateTime.date().toString(Qt::ISODate);
+        return dateTime.toString(msecs % 1000 ? QStringLiteral("yyyy-MM-ddTHH:mm:ss.zzz") : QStringLiteral("yyyy-MM-ddTHH:mm:ss"));
+    }
+    case Error:
+        return errorName(error());
+    case InlineText:
+        return QString::fromUtf8(m_data, m_size);
+    case PooledText:
+        return pool ? pool->string(stringId()) : QString();
+    default:
+        return QString();
+    }
+}
+
+
+QVariant CellValue::toVariant(const StringPool *pool) const
+{
+    switch (m_type) {
+    case Integer:
+        return QVariant(integer());
+    case Real:
+        return QVariant(real());
+    case Boolean:
+        return QVariant(boolean());
+    case DateTime: {
+        // Whole days are dates, so that views do not show a time of midnight
+        const QDateTime dateTime = QDateTime::fromMSecsSinceEpoch(this->dateTime(), Qt::UTC);
+        if (this->dateTime() % 86400000 == 0)
+            return QVariant(dateTime.date());
+        return QVariant(dateTime);
+    }
+    case Empty:
+        return QVariant();
+    default:
+        return QVariant(toString(pool));
+    }
+}
+
+
+CellValue CellValue::toPooled(StringPool *pool) const
+{
+    if (m_type != InlineText)
+        return *this;
+
+    return fromPooledText(pool->internUtf8(m_data, m_size));
+}
+
+
+// The reverse of toPooled(): text short enough to be inline is inline, so
+// that equal text compares and hashes equal wherever it was stored
+CellValue CellValue::toInline(const StringPool *pool) const
+{
+    if (m_type != PooledText)
+        return *this;
+
+    const QStringView text = pool->view(stringId());
+    CellValue cell;
+    return toInlineText(text, &cell) ? cell : *this;
+}
+
+
+QString CellValue::errorName(const ErrorCode code)
+{
+    switch (code) {
+    case DivisionByZero:
+        return QStringLiteral("#DIV/0!");
+    case ValueError:
+        return QStringLiteral("#VALUE!");
+    case ReferenceError:
+        return QStringLiteral("#REF!");
+    case NameError:
+        return QStringLiteral("#NAME?");
+    case NumberError:
+        return QStringLiteral("#NUM!");
+    case NotAvailable:
+        return QStringLiteral("#N/A");
+    default:
+        return QStringLiteral("#NULL!");
+    }
+}
+
+
+//
+// Comparison
+//
+
+bool CellValue::operator==(const CellValue &other) const
+{
+    // Unused bytes are always zero and short text is always inline, so the
+    // raw bytes identify the value
+    return std::memcmp(this, &other, sizeof(CellValue)) == 0;
+}
+
+
+bool CellValue::operator!=(const CellValue &other) const
+{
+    return !(*this == other);
+}
+
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+size_t qHash(const CellValue &value, size_t seed)
+#else
+uint qHash(const CellValue &value, uint seed)
+#endif
+{
+    return qHashBits(&value, sizeof(CellValue), seed);
+}
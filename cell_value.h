@@ -0,0 +1,115 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CELL_VALUE_H
+#define CELL_VALUE_H
+
+#include <QString>
+#include <QStringView>
+#include <QVariant>
+#include <QtGlobal>
+
+class StringPool;
+
+
+class CellValue
+{
+public:
+    enum Type : quint8 {
+        Empty,
+        Integer,
+        Real,
+        Boolean,
+        DateTime,
+        Error,
+        InlineText,
+        PooledText
+    };
+
+    enum ErrorCode : quint8 {
+        NullError,
+        DivisionByZero,
+        ValueError,
+        ReferenceError,
+        NameError,
+        NumberError,
+        NotAvailable
+    };
+
+    // UTF-8 bytes kept in the value itself; longer text goes to the pool
+    static constexpr int InlineSize = 14;
+
+    CellValue();
+
+    static CellValue fromInteger(const qint64 value);
+    static CellValue fromReal(const double value);
+    static CellValue fromBoolean(const bool value);
+    static CellValue fromDateTime(const qint64 msecs);
+    static CellValue fromError(const ErrorCode code);
+    static CellValue fromPooledText(const quint32 id);
+    static CellValue fromText(QStringView text, StringPool *pool);
+    static CellValue fromUtf8(const char *data, const int size, StringPool *pool);
+    static CellValue fromVariant(const QVariant &value, StringPool *pool);
+
+    Type type() const;
+    bool isEmpty() const;
+    bool isNumber() const;
+    bool isText() const;
+    bool isValid(const int stringCount) const;
+
+    qint64 integer() const;
+    double real() const;
+    bool boolean() const;
+    qint64 dateTime() const;
+    ErrorCode error() const;
+    quint32 stringId() const;
+    const char *inlineText() const;
+    int inlineSize() const;
+
+    double toReal() const;
+    QString toString(const StringPool *pool) const;
+    QVariant toVariant(const StringPool *pool) const;
+    CellValue toPooled(StringPool *pool) const;
+    CellValue toInline(const StringPool *pool) const;
+
+    static QString errorName(const ErrorCode code);
+
+    bool operator==(const CellValue &other) const;
+    bool operator!=(const CellValue &other) const;
+
+private:
+    static bool toInlineText(QStringView text, CellValue *value);
+
+    alignas(8) char m_data[InlineSize];
+    quint8 m_size;
+    Type m_type;
+};
+
+Q_DECLARE_TYPEINFO(CellValue, Q_PRIMITIVE_TYPE);
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+size_t qHash(const CellValue &value, size_t seed = 0);
+#else
+uint qHash(const CellValue &value, uint seed = 0);
+#endif
+
+#endif // CELL_VALUE_H
@@ -0,0 +1,526 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "columnar_sheet.h"
+
+#include <algorithm>
+
+
+ColumnarSheet::ColumnarSheet(const QSharedPointer<StringPool> &pool)
+    : AbstractSheet(pool)
+    , m_cellCount{0}
+{
+
+}
+
+
+AbstractSheet *ColumnarSheet::clone() const
+{
+    // Storage is implicitly shared and only detaches once either side writes
+    return new ColumnarSheet(*this);
+}
+
+
+qint64 ColumnarSheet::cellCount() const
+{
+    return m_cellCount;
+}
+
+
+//
+// Cells
+//
+
+CellValue ColumnarSheet::storedCell(const int row, const int column) const
+{
+    if (column >= m_columns.size())
+        return CellValue();
+
+    const int index = row / SheetChunk::Rows;
+    const QVector<SheetChunk> &chunks = m_columns.at(column);
+    if (index >= chunks.size())
+        return CellValue();
+
+    // Chunks keep every text pooled; cells hand short text out inline
+    return chunks.at(index).value(row % SheetChunk::Rows).toInline(stringPool().data());
+}
+
+
+void ColumnarSheet::setStoredCell(const int row, const int column, const CellValue &value)
+{
+    const int index = row / SheetChunk::Rows;
+    const int offset = row % SheetChunk::Rows;
+
+    if (value.isEmpty()) {
+        // Clearing a cell never allocates storage
+        if (column < m_columns.size() && index < m_columns.at(column).size()) {
+            SheetChunk &chunk = m_columns[column][index];
+            if (chunk.hasValue(offset)) {
+                const qint64 size = chunk.byteSize();
+                chunk.clear(offset);
+                addStorageBytes(chunk.byteSize() - size);
+                --m_cellCount;
+            }
+        }
+        return;
+    }
+
+    SheetChunk &chunk = writableChunk(column, index);
+    const bool hadValue = chunk.hasValue(offset);
+    const qint64 size = chunk.byteSize();
+
+    // Pooled text keeps filters and value counts working on ids
+    chunk.setValue(offset, value.toPooled(stringPool().data()));
+
+    addStorageBytes(chunk.byteSize() - size);
+
+    if (!hadValue)
+        ++m_cellCount;
+}
+
+
+void ColumnarSheet::fetchStoredRange(const int row, const int column, const int rows, const int columns, CellValue *values, const int stride) const
+{
+    const StringPool *pool = stringPool().data();
+
+    // Column by column, so that every chunk is looked up once per range
+    for (int c = 0; c < columns && column + c < m_columns.size(); ++c) {
+
+        const QVector<SheetChunk> &chunks = m_columns.at(column + c);
+        for (int r = 0; r < rows; ) {
+
+            const int index = (row + r) / SheetChunk::Rows;
+            if (index >= chunks.size())
+                break;
+
+            const SheetChunk &chunk = chunks.at(index);
+            const int first = (row + r) % SheetChunk::Rows;
+            const int last = qMin(SheetChunk::Rows, first + rows - r);
+
+            if (!chunk.isEmpty()) {
+                for (int offset = first; offset < last; ++offset)
+                    values[(r + offset - first) * stride + c] = chunk.value(offset).toInline(pool);
+            }
+
+            r += last - first;
+        }
+    }
+}
+
+
+void ColumnarSheet::forEachStoredCell(const CellVisitor &visitor) const
+{
+    const StringPool *pool = stringPool().data();
+
+    for (int column = 0; column < m_columns.size(); ++column) {
+
+        const QVector<SheetChunk> &chunks = m_columns.at(column);
+        for (int index = 0; index < chunks.size(); ++index) {
+
+            const SheetChunk &chunk = chunks.at(index);
+            if (chunk.isEmpty())
+                continue;
+
+            // Walk the validity words so that empty stretches are skipped
+            const quint64 *validity = chunk.validity();
+            for (int word = 0; word < chunk.capacity() / 64; ++word) {
+
+                quint64 bits = validity[word];
+                while (bits) {
+                    const int row = index * SheetChunk::Rows + word * 64 + qCountTrailingZeroBits(bits);
+                    bits &= bits - 1;
+
+                    visitor(row, column, chunk.value(row % SheetChunk::Rows).toInline(pool));
+                }
+            }
+        }
+    }
+}
+
+
+//
+// Column operations
+//
+
+void ColumnarSheet::compact()
+{
+    // Picks dictionary or run-length encoding where it pays off and tightens
+    // statistics; chunks that were not edited since are skipped
+    for (int column = 0; column < m_columns.size(); ++column) {
+        for (int index = 0; index < m_columns.at(column).size(); ++index) {
+
+            const SheetChunk &stored = m_columns.at(column).at(index);
+            if (!stored.isEncodable() && stored.statistics().isExact())
+                continue;
+
+            SheetChunk &chunk = m_columns[column][index];
+            const qint64 size = chunk.byteSize();
+            chunk.updateStatistics();
+            chunk.encode();
+            addStorageBytes(chunk.byteSize() - size);
+        }
+    }
+}
+
+
+ChunkAggregate ColumnarSheet::aggregate(const int column) const
+{
+    ChunkAggregate aggregate;
+
+    const int stored = columnAxis().map(column);
+    if (stored < 0 || stored >= m_columns.size())
+        return aggregate;
+
+    // Removed rows are cleared in storage, so whole chunks can be folded
+    for (const SheetChunk &chunk : m_columns.at(stored))
+        chunk.aggregate(aggregate);
+
+    return aggregate;
+}
+
+
+QVector<int> ColumnarSheet::filter(const int column, const SheetChunk::RealPredicate &predicate) const
+{
+    return selectedRows(column, [&predicate](const SheetChunk &chunk, quint64 *selection) {
+        chunk.filter(predicate, selection);
+        return true;
+    });
+}
+
+
+QVector<int> ColumnarSheet::filter(const int column, const SheetChunk::StringPredicate &predicate) const
+{
+    return selectedRows(column, [&predicate](const SheetChunk &chunk, quint64 *selection) {
+        chunk.filter(predicate, selection);
+        return true;
+    });
+}
+
+
+// Numbers, booleans and dates from low to high; a lookup of a single value
+// passes it as both. Chunks whose statistics rule them out are not touched
+QVector<int> ColumnarSheet::filterRange(const int column, const double low, const double high) const
+{
+    return selectedRows(column, [low, high](const SheetChunk &chunk, quint64 *selection) {
+        if (!chunk.statistics().overlaps(low, high))
+            return false;
+
+        chunk.filterRange(low, high, selection);
+        return true;
+    });
+}
+
+
+// The filter returns false for chunks it skipped without selecting anything
+QVector<int> ColumnarSheet::selectedRows(const int column, const std::function<bool(const SheetChunk &chunk, quint64 *selection)> &filter) const
+{
+    QVector<int> rows;
+
+    const int stored = columnAxis().map(column);
+    if (stored < 0 || stored >= m_columns.size())
+        return rows;
+
+    const bool identity = rowAxis().isIdentity();
+    const SheetAxis::Inverse inverse(rowAxis());
+
+    QVector<quint64> selection(SheetChunk::Rows / 64);
+    const QVector<SheetChunk> &chunks = m_columns.at(stored);
+    for (int index = 0; index < chunks.size(); ++index) {
+
+        if (chunks.at(index).isEmpty())
+            continue;
+
+        selection.fill(0);
+        if (!filter(chunks.at(index), selection.data()))
+            continue;
+
+        for (int word = 0; word < selection.size(); ++word) {
+            quint64 bits = selection.at(word);
+            while (bits) {
+                const int row = index * SheetChunk::Rows + word * 64 + qCountTrailingZeroBits(bits);
+                bits &= bits - 1;
+                rows.append(identity ? row : inverse.map(row));
+            }
+        }
+    }
+
+    if (!identity)
+        std::sort(rows.begin(), rows.end());
+
+    return rows;
+}
+
+
+// Only chunks that were edited since their last compaction are scanned
+ColumnarSheet::ColumnSummary ColumnarSheet::summary(const int column) const
+{
+    ColumnSummary summary;
+    summary.emptyCount = rowCount();
+
+    const int stored = columnAxis().map(column);
+    if (stored < 0 || stored >= m_columns.size())
+        return summary;
+
+    const QVector<SheetChunk> &chunks = m_columns.at(stored);
+    QVector<ChunkStatistics> exact(chunks.size());
+
+    bool first = true;
+    for (int index = 0; index < chunks.size(); ++index) {
+        const SheetChunk &chunk = chunks.at(index);
+        if (chunk.isEmpty())
+            continue;
+
+        exact[index] = chunk.statistics().isExact() ? chunk.statistics() : chunk.exactStatistics();
+        if (first)
+            summary.statistics = exact.at(index);
+        else
+            summary.statistics.merge(exact.at(index));
+
+        // Integers widen to reals, any other mix is mixed
+        const SheetChunk::Type type = chunk.type();
+        if (first || summary.type == type)
+            summary.type = type;
+        else if ((summary.type == SheetChunk::Integer || summary.type == SheetChunk::Real) && (type == SheetChunk::Integer || type == SheetChunk::Real))
+            summary.type = SheetChunk::Real;
+        else
+            summary.type = SheetChunk::Mixed;
+
+        summary.count += chunk.count();
+        first = false;
+    }
+
+    // Chunks follow the stored rows, which may have been moved around, so the
+    // order is checked again along the rows as shown: each stretch of stored
+    // rows keeps the order of its chunk, and has to follow on the previous one
+    if (!rowAxis().isIdentity()) {
+        quint8 order = ChunkStatistics::Ascending | ChunkStatistics::Descending;
+        bool started = false;
+        double previous = 0.0;
+
+        rowAxis().forEachRun(0, rowCount(), [&](const SheetAxis::Run &run) {
+            int physical = run.physical;
+            const int end = run.physical + run.length;
+            while (physical < end && order) {
+                const int index = physical / SheetChunk::Rows;
+                const int offset = physical % SheetChunk::Rows;
+                const int length = qMin(end - physical, SheetChunk::Rows - offset);
+                physical += length;
+
+                double front;
+                double back;
+                if (index >= chunks.size() || !chunks.at(index).rangeEnds(offset, offset + length, &front, &back))
+                    continue;
+
+                order &= exact.at(index).flags;
+                if (started && !(previous <= front))
+                    order &= ~ChunkStatistics::Ascending;
+                if (started && !(previous >= front))
+                    order &= ~ChunkStatistics::Descending;
+
+                previous = back;
+                started = true;
+            }
+        });
+
+        summary.statistics.flags &= ~(ChunkStatistics::Ascending | ChunkStatistics::Descending);
+        summary.statistics.flags |= order;
+    }
+
+    summary.emptyCount -= summary.count;
+
+    return summary;
+}
+
+
+QHash<CellValue, qint64> ColumnarSheet::countValues(const int column) const
+{
+    QHash<CellValue, qint64> counts;
+
+    const int stored = columnAxis().map(column);
+    if (stored < 0 || stored >= m_columns.size())
+        return counts;
+
+    for (const SheetChunk &chunk : m_columns.at(stored))
+        chunk.countValues(counts);
+
+    // Keyed like the cells themselves, so short text is inline
+    QHash<CellValue, qint64> values;
+    for (auto it = counts.cbegin(); it != counts.cend(); ++it)
+        values.insert(it.key().toInline(stringPool().data()), it.value());
+
+    return values;
+}
+
+
+//
+// Rows and columns
+//
+
+void ColumnarSheet::clearStoredRows(const int row, const int count)
+{
+    for (int column = 0; column < m_columns.size(); ++column) {
+
+        for (int r = row; r < row + count; ) {
+
+            const int index = r / SheetChunk::Rows;
+            if (index >= m_columns.at(column).size())
+                break;
+
+            const int first = r % SheetChunk::Rows;
+            const int last = qMin(SheetChunk::Rows, first + row + count - r);
+
+            // Only detach chunks that actually hold something in the range
+            if (!m_columns.at(column).at(index).isEmpty()) {
+                SheetChunk &chunk = m_columns[column][index];
+                const qint64 size = chunk.byteSize();
+                m_cellCount -= chunk.clear(first, last - first);
+                addStorageBytes(chunk.byteSize() - size);
+            }
+
+            r += last - first;
+        }
+    }
+}
+
+
+void ColumnarSheet::clearStoredColumns(const int column, const int count)
+{
+    for (int c = column; c < column + count && c < m_columns.size(); ++c) {
+
+        for (const SheetChunk &chunk : m_columns.at(c)) {
+            m_cellCount -= chunk.count();
+            addStorageBytes(-chunk.byteSize());
+        }
+
+        addStorageBytes(-m_columns.at(c).size() * qint64(sizeof(SheetChunk)));
+        m_columns[c].clear();
+    }
+}
+
+
+//
+// Chunks
+//
+
+int ColumnarSheet::storedColumnCount() const
+{
+    return m_columns.size();
+}
+
+
+int ColumnarSheet::chunkCount(const int column) const
+{
+    if (column < 0 || column >= m_columns.size())
+        return 0;
+
+    return m_columns.at(column).size();
+}
+
+
+const SheetChunk &ColumnarSheet::chunk(const int column, const int index) const
+{
+    return m_columns.at(column).at(index);
+}
+
+
+void ColumnarSheet::setChunk(const int column, const int index, const SheetChunk &chunk)
+{
+    // Chunks are addressed by storage position, like the chunks of a fresh sheet
+    SheetChunk &target = writableChunk(column, index);
+
+    m_cellCount += chunk.count() - target.count();
+    addStorageBytes(chunk.byteSize() - target.byteSize());
+
+    target = chunk;
+}
+
+
+void ColumnarSheet::mergeChunk(const int column, const int index, const SheetChunk &chunk, const int firstRow)
+{
+    SheetChunk &target = writableChunk(column, index);
+    if (target.isEmpty()) {
+        setChunk(column, index, chunk);
+        return;
+    }
+
+    // The rows before the first one are already filled; at most one window
+    // of values is copied
+    const qint64 size = target.byteSize();
+    const int count = target.count();
+    for (int row = firstRow; row < SheetChunk::Rows; ++row) {
+        if (chunk.hasValue(row))
+            target.setValue(row, chunk.value(row));
+    }
+    target.encode();
+
+    m_cellCount += target.count() - count;
+    addStorageBytes(target.byteSize() - size);
+}
+
+
+void ColumnarSheet::appendChunks(const QVector<QVector<SheetChunk>> &windows, const int rows, const int columns, const int firstRow)
+{
+    // Whole windows of chunks go behind everything stored so far and the
+    // row axis lists their rows after the last row; windows whose rows
+    // start at the end of the last partly filled window continue it
+    const int stored = rowAxis().physicalCount();
+    const bool continued = firstRow > 0 && stored % SheetChunk::Rows == firstRow;
+    const int window = continued ? stored / SheetChunk::Rows : (stored + SheetChunk::Rows - 1) / SheetChunk::Rows;
+
+    extend(0, columns);
+
+    for (int index = 0; index < windows.size(); ++index) {
+        const QVector<SheetChunk> &chunks = windows.at(index);
+        for (int column = 0; column < chunks.size(); ++column) {
+            if (chunks.at(column).isEmpty())
+                continue;
+            if (index == 0 && continued)
+                mergeChunk(columnAxis().map(column), window, chunks.at(column), firstRow);
+            else
+                setChunk(columnAxis().map(column), window + index, chunks.at(column));
+        }
+    }
+
+    appendStoredRows(window * SheetChunk::Rows + firstRow, rows);
+}
+
+
+qint64 ColumnarSheet::indexBytes() const
+{
+    return m_columns.capacity() * qint64(sizeof(QVector<SheetChunk>));
+}
+
+
+SheetChunk &ColumnarSheet::writableChunk(const int column, const int index)
+{
+    if (column >= m_columns.size())
+        m_columns.resize(column + 1);
+
+    QVector<SheetChunk> &chunks = m_columns[column];
+    if (index >= chunks.size()) {
+        addStorageBytes((index + 1 - chunks.size()) * qint64(sizeof(SheetChunk)));
+        chunks.resize(index + 1);
+    }
+
+    return chunks[index];
+}
+
@@ -0,0 +1,86 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COLUMNAR_SHEET_H
+#define COLUMNAR_SHEET_H
+
+#include "abstract_sheet.h"
+
+#include <QHash>
+#include <QVector>
+
+#include "sheet_chunk.h"
+
+
+class ColumnarSheet : public AbstractSheet
+{
+public:
+    // What the chunk statistics tell about a column as a whole
+    struct ColumnSummary {
+        SheetChunk::Type type = SheetChunk::Empty;
+        qint64 count = 0;
+        qint64 emptyCount = 0;
+        ChunkStatistics statistics;
+    };
+
+    explicit ColumnarSheet(const QSharedPointer<StringPool> &pool);
+
+    AbstractSheet *clone() const override;
+
+    qint64 cellCount() const override;
+
+    void compact() override;
+
+    ChunkAggregate aggregate(const int column) const;
+    QVector<int> filter(const int column, const SheetChunk::RealPredicate &predicate) const;
+    QVector<int> filter(const int column, const SheetChunk::StringPredicate &predicate) const;
+    QVector<int> filterRange(const int column, const double low, const double high) const;
+    ColumnSummary summary(const int column) const;
+    QHash<CellValue, qint64> countValues(const int column) const;
+
+    int storedColumnCount() const;
+    int chunkCount(const int column) const;
+    const SheetChunk &chunk(const int column, const int index) const;
+    void setChunk(const int column, const int index, const SheetChunk &chunk);
+    void appendChunks(const QVector<QVector<SheetChunk>> &windows, const int rows, const int columns, const int firstRow = 0);
+
+protected:
+    CellValue storedCell(const int row, const int column) const override;
+    void setStoredCell(const int row, const int column, const CellValue &value) override;
+    void fetchStoredRange(const int row, const int column, const int rows, const int columns, CellValue *values, const int stride) const override;
+    void forEachStoredCell(const CellVisitor &visitor) const override;
+    void clearStoredRows(const int row, const int count) override;
+    void clearStoredColumns(const int column, const int count) override;
+    qint64 indexBytes() const override;
+
+private:
+    QVector<int> selectedRows(const int column, const std::function<bool(const SheetChunk &chunk, quint64 *selection)> &filter) const;
+
+    SheetChunk &writableChunk(const int column, const int index);
+    void mergeChunk(const int column, const int index, const SheetChunk &chunk, const int firstRow);
+
+    qint64 m_cellCount;
+
+    QVector<QVector<SheetChunk>> m_columns;
+};
+
+#endif // COLUMNAR_SHEET_H
@@ -0,0 +1,329 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "csv_dialect.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QVector>
+
+#include <memory>
+
+#include "decompressor.h"
+#include "field_parser.h"
+
+
+namespace {
+
+// Rows looked at per candidate; a sample rarely holds more
+constexpr int MaxRecords = 500;
+
+const char Delimiters[] = {',', ';', '\t', '|'};
+
+
+bool isBoundary(const char c)
+{
+    return c == ',' || c == ';' || c == '\t' || c == '|' || c == '\n' || c == '\r';
+}
+
+
+// Splits the sample into rows of unquoted fields much like the parser
+// does; the row cut off at the end of the sample is left out
+QVector<QVector<QByteArray>> splitRecords(const char *data, const qint64 size, const char delimiter, const char quote, const char escape, int *lineEndings = nullptr)
+{
+    QVector<QVector<QByteArray>> records;
+    QVector<QByteArray> record;
+    QByteArray field;
+    bool inQuotes = false;
+
+    for (qint64 index = 0; index < size && records.size() < MaxRecords; ++index) {
+        const char c = data[index];
+
+        if (escape && c == escape && index + 1 < size) {
+            field.append(data[++index]);
+            continue;
+        }
+
+        if (c == quote) {
+            if (inQuotes && !escape && index + 1 < size && data[index + 1] == quote) {
+                field.append(quote);
+                ++index;
+            }
+            else {
+                inQuotes = !inQuotes;
+            }
+            continue;
+        }
+
+        if (inQuotes) {
+            field.append(c);
+            continue;
+        }
+
+        if (c == delimiter) {
+            record.append(field);
+            field.clear();
+            continue;
+        }
+
+        if (c == '\n' || c == '\r') {
+            if (lineEndings) {
+                if (c == '\r' && index + 1 < size && data[index + 1] == '\n')
+                    ++lineEndings[CsvDialect::CRLF];
+                else
+                    ++lineEndings[c == '\n' ? CsvDialect::LF : CsvDialect::CR];
+            }
+            if (c == '\r' && index + 1 < size && data[index + 1] == '\n')
+                ++index;
+
+            record.append(field);
+            field.clear();
+            records.append(record);
+            record.clear();
+            continue;
+        }
+
+        field.append(c);
+    }
+
+    // A sample without any line break is a single row
+    if (records.isEmpty() && (!record.isEmpty() || !field.isEmpty())) {
+        record.append(field);
+        records.append(record);
+    }
+
+    return records;
+}
+
+
+char sniffQuote(const char *data, const qint64 size)
+{
+    // Quotes open and close fields; apostrophes within words do not count
+    int doubleQuotes = 0;
+    int singleQuotes = 0;
+    for (qint64 index = 0; index < size; ++index) {
+        const char c = data[index];
+        if (c != '"' && c != '\'')
+            continue;
+
+        const bool opens = index == 0 || isBoundary(data[index - 1]);
+        const bool closes = index + 1 == size || isBoundary(data[index + 1]);
+        if (opens || closes)
+            ++(c == '"' ? doubleQuotes : singleQuotes);
+    }
+
+    return singleQuotes > doubleQuotes ? '\'' : '"';
+}
+
+
+char sniffEscape(const char *data, const qint64 size, const char quote)
+{
+    // Backslashes before quotes within fields against doubled quotes that
+    // are not an empty field
+    int backslashes = 0;
+    int doubled = 0;
+    for (qint64 index = 1; index + 1 < size; ++index) {
+        if (data[index] != quote)
+            continue;
+
+        const char previous = data[index - 1];
+        const char next = data[index + 1];
+        if (previous == '\\' && (index < 2 || data[index - 2] != '\\') && !isBoundary(next))
+            ++backslashes;
+        else if (next == quote && previous != '\\' && !(isBoundary(previous) && (index + 2 == size || isBoundary(data[index + 2]))))
+            ++doubled;
+    }
+
+    return backslashes > doubled ? '\\' : 0;
+}
+
+
+bool sniffHeaderRow(const QVector<QVector<QByteArray>> &records)
+{
+    if (records.size() < 2)
+        return false;
+
+    // Each column votes: a title that does not fit the type of the values
+    // below it, or differs in length from values that all have one length,
+    // speaks for a header row
+    const QVector<QByteArray> &titles = records.first();
+    int votes = 0;
+
+    for (int column = 0; column < titles.size(); ++column) {
+
+        FieldParser::Sample sample;
+        int length = -1;
+        bool sameLength = true;
+        for (int row = 1; row < records.size(); ++row) {
+            if (column >= records.at(row).size() || records.at(row).at(column).isEmpty())
+                continue;
+
+            const QByteArray &value = records.at(row).at(column);
+            sample.add(value.constData(), value.size());
+            if (length >= 0 && value.size() != length)
+                sameLength = false;
+            length = value.size();
+        }
+
+        const QByteArray &title = titles.at(column);
+        if (!sample.count || title.isEmpty())
+            continue;
+
+        const FieldParser::Type type = sample.type();
+        if (type != FieldParser::Text)
+            votes += (FieldParser::matchingTypes(title.constData(), title.size()) & type) ? -1 : 1;
+        else if (sameLength && sample.count > 1)
+            votes += title.size() != length ? 1 : -1;
+    }
+
+    return votes > 0;
+}
+
+} // namespace
+
+
+bool CsvDialect::operator==(const CsvDialect &other) const
+{
+    return delimiter == other.delimiter && quote == other.quote && escape == other.escape
+            && lineEnding == other.lineEnding && headerRow == other.headerRow && encoding == other.encoding;
+}
+
+
+bool CsvDialect::operator!=(const CsvDialect &other) const
+{
+    return !(*this == other);
+}
+
+
+CsvDialect CsvDialect::sniff(const char *data, const qint64 size)
+{
+    CsvDialect dialect;
+
+    int bomSize = 0;
+    dialect.encoding = TextEncoding::detect(data, size, &bomSize);
+
+    const char *text = data + bomSize;
+    qint64 length = size - bomSize;
+
+    std::unique_ptr<char[]> converted;
+    if (dialect.encoding == TextEncoding::Utf16LE || dialect.encoding == TextEncoding::Utf16BE) {
+        converted.reset(new char[size_t(length / 2 * 3 + 1)]);
+        length = TextEncoding::utf16ToUtf8(text, length, dialect.encoding == TextEncoding::Utf16BE, converted.get());
+        text = converted.get();
+    }
+
+    dialect.quote = sniffQuote(text, length);
+    dialect.escape = sniffEscape(text, length, dialect.quote);
+
+    // The delimiter splits the most rows into the same number of fields
+    double bestConsistency = 0;
+    int bestFields = 1;
+    for (const char delimiter : Delimiters) {
+
+        const QVector<QVector<QByteArray>> records = splitRecords(text, length, delimiter, dialect.quote, dialect.escape);
+
+        QVector<int> counts;
+        for (const QVector<QByteArray> &record : records) {
+            // Empty lines say nothing about the delimiter
+            if (record.size() == 1 && record.first().isEmpty())
+                continue;
+            if (record.size() >= counts.size())
+                counts.resize(record.size() + 1);
+            ++counts[record.size()];
+        }
+
+        int fields = 1;
+        int rows = 0;
+        for (int count = 2; count < counts.size(); ++count) {
+            rows += counts.at(count);
+            if (counts.at(count) > counts.value(fields))
+                fields = count;
+        }
+        if (fields < 2)
+            continue;
+
+        const double consistency = double(counts.at(fields)) / (rows + counts.value(1));
+        if (consistency > bestConsistency || (consistency == bestConsistency && fields > bestFields)) {
+            bestConsistency = consistency;
+            bestFields = fields;
+            dialect.delimiter = delimiter;
+        }
+    }
+
+    int lineEndings[3] = {};
+    const QVector<QVector<QByteArray>> records = splitRecords(text, length, dialect.delimiter, dialect.quote, dialect.escape, lineEndings);
+    if (lineEndings[CRLF] >= lineEndings[LF] && lineEndings[CRLF] >= lineEndings[CR] && lineEndings[CRLF])
+        dialect.lineEnding = CRLF;
+    else if (lineEndings[CR] > lineEndings[LF])
+        dialect.lineEnding = CR;
+
+    dialect.headerRow = sniffHeaderRow(records);
+
+    return dialect;
+}
+
+
+bool CsvDialect::sniffFile(const QString &fileName, CsvDialect *dialect, QString *errorString)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorString)
+            *errorString = file.errorString();
+        return false;
+    }
+
+    // Only the start of the file is read, however large it is
+    QByteArray sample = file.read(SampleSize);
+
+    // Compressed files are sniffed from the start of what they hold; the
+    // decompressor reads only as far as it needs to for that
+    const Decompressor::Format format = Decompressor::detect(sample.constData(), sample.size());
+    if (format != Decompressor::Uncompressed) {
+        uchar *data = file.map(0, file.size());
+        if (!data) {
+            if (errorString)
+                *errorString = file.errorString();
+            return false;
+        }
+
+        Decompressor decompressor(format);
+        decompressor.setThreadCount(1);
+        decompressor.setBlockSize(int(SampleSize));
+
+        sample.clear();
+        decompressor.decompress(reinterpret_cast<const char *>(data), file.size(), [&sample](const QByteArray &block, const qint64) {
+            sample = block;
+            return false;
+        });
+        file.unmap(data);
+
+        if (sample.isEmpty() && !decompressor.errorString().isEmpty()) {
+            if (errorString)
+                *errorString = decompressor.errorString();
+            return false;
+        }
+    }
+
+    *dialect = sniff(sample.constData(), sample.size());
+
+    return true;
+}
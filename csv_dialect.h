@@ -0,0 +1,58 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CSV_DIALECT_H
+#define CSV_DIALECT_H
+
+#include <QString>
+#include <QtGlobal>
+
+#include "text_encoding.h"
+
+
+struct CsvDialect
+{
+    enum LineEnding {
+        LF,
+        CRLF,
+        CR
+    };
+
+    // Sniffing never reads more than this from the start of a file
+    static constexpr qint64 SampleSize = 64 * 1024;
+
+    char delimiter = ',';
+    char quote = '"';
+    // Quotes within quoted fields are doubled unless an escape is set
+    char escape = 0;
+    LineEnding lineEnding = LF;
+    bool headerRow = false;
+    TextEncoding::Encoding encoding = TextEncoding::Utf8;
+
+    bool operator==(const CsvDialect &other) const;
+    bool operator!=(const CsvDialect &other) const;
+
+    static CsvDialect sniff(const char *data, const qint64 size);
+    static bool sniffFile(const QString &fileName, CsvDialect *dialect, QString *errorString = nullptr);
+};
+
+#endif // CSV_DIALECT_H
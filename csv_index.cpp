@@ -0,0 +1,250 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "csv_index.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+
+namespace {
+
+constexpr quint32 Magic = 0x51544958; // "QTIX"
+constexpr quint16 Version = 1;
+
+} // namespace
+
+
+CsvIndex::CsvIndex()
+    : m_valid{false}
+    , m_fileSize{0}
+    , m_lastModified{0}
+    , m_rowCount{0}
+{
+
+}
+
+
+bool CsvIndex::isValid() const
+{
+    return m_valid;
+}
+
+
+qint64 CsvIndex::fileSize() const
+{
+    return m_fileSize;
+}
+
+
+qint64 CsvIndex::lastModified() const
+{
+    return m_lastModified;
+}
+
+
+void CsvIndex::setFile(const qint64 size, const qint64 lastModified)
+{
+    m_fileSize = size;
+    m_lastModified = lastModified;
+    m_valid = true;
+}
+
+
+CsvDialect CsvIndex::dialect() const
+{
+    return m_dialect;
+}
+
+
+void CsvIndex::setDialect(const CsvDialect &dialect)
+{
+    m_dialect = dialect;
+}
+
+
+QVector<FieldParser::Type> CsvIndex::columnTypes() const
+{
+    return m_columnTypes;
+}
+
+
+void CsvIndex::setColumnTypes(const QVector<FieldParser::Type> &types)
+{
+    m_columnTypes = types;
+}
+
+
+qint64 CsvIndex::rowCount() const
+{
+    return m_rowCount;
+}
+
+
+void CsvIndex::setRowCount(const qint64 count)
+{
+    m_rowCount = count;
+}
+
+
+QVector<CsvIndex::Checkpoint> CsvIndex::checkpoints() const
+{
+    return m_checkpoints;
+}
+
+
+void CsvIndex::setCheckpoints(const QVector<Checkpoint> &checkpoints)
+{
+    m_checkpoints = checkpoints;
+}
+
+
+bool CsvIndex::matches(const QString &fileName) const
+{
+    // Any change to the file, even one that keeps its size, changes its
+    // modification time
+    const QFileInfo fileInfo(fileName);
+    return m_valid && fileInfo.exists() && fileInfo.size() == m_fileSize && fileInfo.lastModified().toMSecsSinceEpoch() == m_lastModified;
+}
+
+
+//
+// Storage
+//
+
+bool CsvIndex::load(const QString &fileName)
+{
+    *this = CsvIndex();
+
+    const QString indexName = indexFileName(fileName);
+    QFile file(indexName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_12);
+
+    quint32 magic;
+    quint16 version;
+    stream >> magic >> version;
+    if (magic != Magic || version != Version)
+        return false;
+
+    qint8 delimiter, quote, escape;
+    quint8 lineEnding, encoding;
+    bool headerRow;
+    stream >> m_fileSize >> m_lastModified >> delimiter >> quote >> escape >> lineEnding >> headerRow >> encoding;
+    m_dialect.delimiter = char(delimiter);
+    m_dialect.quote = char(quote);
+    m_dialect.escape = char(escape);
+    m_dialect.lineEnding = CsvDialect::LineEnding(lineEnding);
+    m_dialect.headerRow = headerRow;
+    m_dialect.encoding = TextEncoding::Encoding(encoding);
+
+    qint32 columns;
+    stream >> columns;
+    for (qint32 column = 0; column < columns && stream.status() == QDataStream::Ok; ++column) {
+        quint8 type;
+        stream >> type;
+        m_columnTypes.append(FieldParser::Type(type));
+    }
+
+    qint32 count;
+    stream >> m_rowCount >> count;
+    for (qint32 index = 0; index < count && stream.status() == QDataStream::Ok; ++index) {
+        Checkpoint checkpoint;
+        stream >> checkpoint.row >> checkpoint.offset;
+        m_checkpoints.append(checkpoint);
+    }
+
+    bool ordered = true;
+    for (int index = 1; index < m_checkpoints.size(); ++index)
+        ordered = ordered && m_checkpoints.at(index).row > m_checkpoints.at(index - 1).row && m_checkpoints.at(index).offset > m_checkpoints.at(index - 1).offset;
+    if (stream.status() != QDataStream::Ok || !ordered || (!m_checkpoints.isEmpty() && m_checkpoints.last().offset > m_fileSize)) {
+        *this = CsvIndex();
+        return false;
+    }
+
+    // An index of an older version of the file is of no use any more
+    m_valid = true;
+    if (!matches(fileName)) {
+        file.remove();
+        *this = CsvIndex();
+        return false;
+    }
+
+    return true;
+}
+
+
+bool CsvIndex::save(const QString &fileName) const
+{
+    if (!m_valid)
+        return false;
+
+    const QString indexName = indexFileName(fileName);
+    if (!QDir().mkpath(QFileInfo(indexName).path()))
+        return false;
+
+    QSaveFile file(indexName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_12);
+
+    stream << Magic << Version;
+    stream << m_fileSize << m_lastModified << qint8(m_dialect.delimiter) << qint8(m_dialect.quote) << qint8(m_dialect.escape)
+           << quint8(m_dialect.lineEnding) << m_dialect.headerRow << quint8(m_dialect.encoding);
+
+    stream << qint32(m_columnTypes.size());
+    for (const FieldParser::Type type : m_columnTypes)
+        stream << quint8(type);
+
+    stream << m_rowCount << qint32(m_checkpoints.size());
+    for (const Checkpoint &checkpoint : m_checkpoints)
+        stream << checkpoint.row << checkpoint.offset;
+
+    if (stream.status() != QDataStream::Ok) {
+        file.cancelWriting();
+        return false;
+    }
+
+    return file.commit();
+}
+
+
+QString CsvIndex::indexFileName(const QString &fileName)
+{
+    // Named after the path of the file, so that the file itself can stay
+    // on read-only media
+    const QString path = QFileInfo(fileName).absoluteFilePath();
+    const QByteArray hash = QCryptographicHash::hash(path.toUtf8(), QCryptographicHash::Sha1).toHex();
+
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/index/") + QString::fromLatin1(hash) + QStringLiteral(".idx");
+}
@@ -0,0 +1,86 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CSV_INDEX_H
+#define CSV_INDEX_H
+
+#include <QString>
+#include <QVector>
+
+#include "csv_dialect.h"
+#include "field_parser.h"
+
+
+// What the first full read of a file found out about it, kept in the cache
+// so that the file can be read again without sniffing or searching for
+// row boundaries
+class CsvIndex
+{
+public:
+    // Rows between two checkpoints at most
+    static constexpr int CheckpointRows = 4096;
+
+    struct Checkpoint {
+        qint64 row = 0;
+        qint64 offset = 0;
+    };
+
+    CsvIndex();
+
+    bool isValid() const;
+
+    qint64 fileSize() const;
+    qint64 lastModified() const;
+    void setFile(const qint64 size, const qint64 lastModified);
+
+    CsvDialect dialect() const;
+    void setDialect(const CsvDialect &dialect);
+
+    QVector<FieldParser::Type> columnTypes() const;
+    void setColumnTypes(const QVector<FieldParser::Type> &types);
+
+    qint64 rowCount() const;
+    void setRowCount(const qint64 count);
+
+    QVector<Checkpoint> checkpoints() const;
+    void setCheckpoints(const QVector<Checkpoint> &checkpoints);
+
+    bool matches(const QString &fileName) const;
+
+    bool load(const QString &fileName);
+    bool save(const QString &fileName) const;
+
+    static QString indexFileName(const QString &fileName);
+
+private:
+    bool m_valid;
+    qint64 m_fileSize;
+    qint64 m_lastModified;
+    CsvDialect m_dialect;
+    QVector<FieldParser::Type> m_columnTypes;
+    qint64 m_rowCount;
+
+    // In row order, the first one at the first row
+    QVector<Checkpoint> m_checkpoints;
+};
+
+#endif // CSV_INDEX_H
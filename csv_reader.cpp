@@ -0,0 +1,1299 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "csv_reader.h"
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QVarLengthArray>
+#include <QWaitCondition>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "columnar_sheet.h"
+#include "csv_scanner.h"
+#include "field_parser.h"
+#include "string_pool.h"
+#include "text_encoding.h"
+
+
+namespace {
+
+// Segments smaller than this are not worth a thread of their own
+constexpr qint64 MinimumSegmentSize = 4 * 1024 * 1024;
+
+// The first segment is kept small so that its rows are ready almost at once
+constexpr qint64 HeadSegmentSize = 64 * 1024;
+
+// Decompressed blocks waiting to be parsed; enough to keep both sides busy
+constexpr int MaximumQueuedBlocks = 4;
+
+
+class Task : public QRunnable
+{
+public:
+    explicit Task(const std::function<void()> &function)
+        : m_function{function}
+    {
+
+    }
+
+    void run() override
+    {
+        m_function();
+    }
+
+private:
+    std::function<void()> m_function;
+};
+
+
+void runTasks(const int threads, const int count, const std::function<void(const int index)> &function)
+{
+    if (threads <= 1 || count <= 1) {
+        for (int index = 0; index < count; ++index)
+            function(index);
+        return;
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    for (int index = 0; index < count; ++index)
+        pool.start(new Task([&function, index]() { function(index); }));
+    pool.waitForDone();
+}
+
+
+//
+// Segment parser
+//
+
+class SegmentParser
+{
+public:
+    SegmentParser(StringPool *pool, const char delimiter, const char quote, const char escape, const bool release, const QAtomicInt *cancelled, QAtomicInteger<qint64> *bytesParsed)
+        : m_pool{pool}
+        , m_delimiter{delimiter}
+        , m_quote{quote}
+        , m_escape{escape}
+        , m_release{release}
+        , m_released{nullptr}
+        , m_encoding{TextEncoding::Utf8}
+        , m_cancelled{cancelled}
+        , m_stopped{nullptr}
+        , m_bytesParsed{bytesParsed}
+        , m_reported{nullptr}
+        , m_limit{nullptr}
+        , m_columnTypes{nullptr}
+        , m_firstSamples{nullptr}
+        , m_samples{nullptr}
+        , m_titles{nullptr}
+        , m_checkpoints{nullptr}
+        , m_data{nullptr}
+        , m_end{nullptr}
+        , m_firstRow{0}
+        , m_column{0}
+    {
+
+    }
+
+    void setColumnTypes(const QVector<FieldParser::Type> *types);
+    void setEncoding(const TextEncoding::Encoding encoding);
+    void setSamples(QVector<FieldParser::Sample> *firstRow, QVector<FieldParser::Sample> *otherRows);
+    void setTitles(QStringList *titles);
+    void setCheckpoints(QVector<qint64> *offsets);
+    void setFirstRow(const int row);
+    void setStopFlag(const QAtomicInt *stopped);
+
+    bool parse(const char *data, const qint64 size, const char *first, const char *limit, int &rows, int &columns, QVector<QVector<SheetChunk>> &windows);
+
+private:
+    void appendField(const char *first, const char *last);
+    void appendValue(const char *data, const int size);
+    bool isUtf8(const char *data, const int size) const;
+    quint32 internText(const char *data, const int size);
+    bool endRow(const char *position);
+    void addCheckpoint(const char *position);
+    void flushWindow();
+    void releasePages(const char *position);
+    void reportProgress(const char *position);
+
+    StringPool *m_pool;
+    char m_delimiter;
+    char m_quote;
+    char m_escape;
+    bool m_release;
+    const char *m_released;
+    TextEncoding::Encoding m_encoding;
+
+    const QAtomicInt *m_cancelled;
+    const QAtomicInt *m_stopped;
+    QAtomicInteger<qint64> *m_bytesParsed;
+    const char *m_reported;
+    const char *m_limit;
+
+    // Fields are either converted to the type of their column or only sampled
+    const QVector<FieldParser::Type> *m_columnTypes;
+    QVector<FieldParser::Sample> *m_firstSamples;
+    QVector<FieldParser::Sample> *m_samples;
+
+    // Set until the header row is done; its fields become column titles
+    QStringList *m_titles;
+
+    // Offsets of every few rows from the start of the data
+    QVector<qint64> *m_checkpoints;
+    const char *m_data;
+    const char *m_end;
+
+    // Row of the first window at which the first row goes
+    int m_firstRow;
+
+    int m_column;
+    int m_rows;
+    int m_columns;
+    QVector<SheetChunk> m_chunks;
+    QVector<QVector<SheetChunk>> m_windows;
+
+    // Scratch for quoted fields with doubled quotes, reused for every field
+    QByteArray m_field;
+};
+
+
+void SegmentParser::setColumnTypes(const QVector<FieldParser::Type> *types)
+{
+    m_columnTypes = types;
+}
+
+
+void SegmentParser::setEncoding(const TextEncoding::Encoding encoding)
+{
+    m_encoding = encoding;
+}
+
+
+void SegmentParser::setTitles(QStringList *titles)
+{
+    m_titles = titles;
+}
+
+
+void SegmentParser::setCheckpoints(QVector<qint64> *offsets)
+{
+    m_checkpoints = offsets;
+}
+
+
+void SegmentParser::setFirstRow(const int row)
+{
+    m_firstRow = row;
+}
+
+
+void SegmentParser::setStopFlag(const QAtomicInt *stopped)
+{
+    m_stopped = stopped;
+}
+
+
+void SegmentParser::setSamples(QVector<FieldParser::Sample> *firstRow, QVector<FieldParser::Sample> *otherRows)
+{
+    m_firstSamples = firstRow;
+    m_samples = otherRows;
+}
+
+
+bool SegmentParser::parse(const char *data, const qint64 size, const char *first, const char *limit, int &rows, int &columns, QVector<QVector<SheetChunk>> &windows)
+{
+    const char *end = data + size;
+    const char *field = first;
+    m_released = first;
+    m_reported = first;
+    m_limit = limit;
+    m_data = data;
+    m_end = end;
+    m_rows = 0;
+    m_columns = 0;
+
+    if (m_checkpoints) {
+        m_checkpoints->clear();
+        addCheckpoint(first);
+    }
+
+    CsvScanner scanner(m_delimiter, m_quote, m_escape);
+    bool ok = true;
+    bool done = field >= limit;
+
+    for (const char *block = first; block < end && !done; block += CsvScanner::BlockSize) {
+
+        if (m_cancelled->loadRelaxed() || (m_stopped && m_stopped->loadRelaxed())) {
+            ok = false;
+            break;
+        }
+
+        // The last partial block is padded with bytes that are never separators
+        const char *bytes = block;
+        char padded[CsvScanner::BlockSize];
+        if (end - block < CsvScanner::BlockSize) {
+            std::memset(padded, 0, sizeof(padded));
+            std::memcpy(padded, block, size_t(end - block));
+            bytes = padded;
+        }
+
+        // Only separators outside of quotes are set; fields are cut between them
+        quint64 separators = scanner.scan(bytes);
+        while (separators) {
+            const char *separator = block + qCountTrailingZeroBits(separators);
+            separators &= separators - 1;
+
+            // The line feed of a CR LF pair ends nothing
+            const bool lineFeed = *separator == '\n' && separator == field && separator > data && separator[-1] == '\r';
+            if (!lineFeed) {
+                appendField(field, separator);
+                if (*separator == m_delimiter) {
+                    field = separator + 1;
+                    continue;
+                }
+
+                if (!endRow(separator + 1)) {
+                    ok = false;
+                    done = true;
+                    break;
+                }
+            }
+            field = separator + 1;
+
+            // Rows that start past the limit belong to the next segment
+            if (field >= limit) {
+                done = true;
+                break;
+            }
+        }
+    }
+
+    // Anything after the last line break is a row of its own
+    if (!done && (field < end || m_column)) {
+        appendField(field, end);
+        ok = endRow(end);
+    }
+
+    flushWindow();
+    reportProgress(limit);
+
+    rows = m_rows;
+    columns = m_columns;
+    windows = m_windows;
+
+    return ok;
+}
+
+
+void SegmentParser::appendField(const char *first, const char *last)
+{
+    const bool quoted = first < last && *first == m_quote;
+    if (quoted) {
+        // Drop the quotes; anything between the closing quote and the separator goes too
+        const char *closing = last - 1;
+        while (closing > first && *closing != m_quote)
+            --closing;
+        if (closing == first)
+            closing = last;
+
+        ++first;
+        last = closing;
+    }
+
+    // Quotes are doubled within quoted fields, unless the dialect escapes
+    // them, in which case escapes may appear anywhere
+    const char special = m_escape ? m_escape : m_quote;
+    if ((quoted || m_escape) && std::memchr(first, special, size_t(last - first))) {
+        m_field.resize(0);
+        for (const char *position = first; position < last; ++position) {
+            if (m_escape && *position == m_escape && position + 1 < last)
+                ++position;
+            m_field.append(*position);
+            if (!m_escape && *position == m_quote)
+                ++position;
+        }
+        appendValue(m_field.constData(), m_field.size());
+    }
+    else {
+        appendValue(first, int(last - first));
+    }
+
+    ++m_column;
+}
+
+
+void SegmentParser::appendValue(const char *data, const int size)
+{
+    if (size <= 0)
+        return;
+
+    if (m_titles) {
+        while (m_titles->size() <= m_column)
+            m_titles->append(QString());
+        (*m_titles)[m_column] = m_pool->string(internText(data, size));
+        return;
+    }
+
+    if (m_samples) {
+        QVector<FieldParser::Sample> &samples = m_rows ? *m_samples : *m_firstSamples;
+        if (m_column >= samples.size())
+            samples.resize(m_column + 1);
+        samples[m_column].add(data, size);
+        return;
+    }
+
+    if (m_column >= m_chunks.size())
+        m_chunks.resize(m_column + 1);
+
+    SheetChunk &chunk = m_chunks[m_column];
+    const int row = (m_firstRow + m_rows) % SheetChunk::Rows;
+    const FieldParser::Type type = (m_columnTypes && m_column < m_columnTypes->size()) ? m_columnTypes->at(m_column) : FieldParser::Text;
+
+    // Fields that fit their column go straight into a chunk of its type
+    qint64 integer;
+    double real;
+    bool boolean;
+    switch (type) {
+    case FieldParser::Text:
+        chunk.setString(row, internText(data, size));
+        return;
+    case FieldParser::Integer:
+        if ((chunk.type() == SheetChunk::Empty || chunk.type() == SheetChunk::Integer) && FieldParser::toInteger(data, size, &integer)) {
+            chunk.setInteger(row, integer);
+            return;
+        }
+        break;
+    case FieldParser::Real:
+        if ((chunk.type() == SheetChunk::Empty || chunk.type() == SheetChunk::Real) && FieldParser::toReal(data, size, &real)) {
+            chunk.setReal(row, real);
+            return;
+        }
+        break;
+    case FieldParser::Boolean:
+        if ((chunk.type() == SheetChunk::Empty || chunk.type() == SheetChunk::Boolean) && FieldParser::toBoolean(data, size, &boolean)) {
+            chunk.setBoolean(row, boolean);
+            return;
+        }
+        break;
+    case FieldParser::DateTime:
+        if ((chunk.type() == SheetChunk::Empty || chunk.type() == SheetChunk::DateTime) && FieldParser::toDateTime(data, size, &integer)) {
+            chunk.setDateTime(row, integer);
+            return;
+        }
+        break;
+    }
+
+    // Everything else falls back one cell at a time; bytes that are not
+    // UTF-8 cannot be anything but text
+    if (!isUtf8(data, size)) {
+        chunk.setValue(row, CellValue::fromPooledText(internText(data, size)));
+        return;
+    }
+    chunk.setValue(row, FieldParser::toValue(type, data, size, m_pool).toPooled(m_pool));
+}
+
+
+bool SegmentParser::isUtf8(const char *data, const int size) const
+{
+    return m_encoding != TextEncoding::Windows1252 && TextEncoding::isValidUtf8(data, size);
+}
+
+
+quint32 SegmentParser::internText(const char *data, const int size)
+{
+    if (isUtf8(data, size))
+        return m_pool->internUtf8(data, size);
+
+    // Fields that are not valid UTF-8 are read as Windows-1252, also in
+    // files that are UTF-8 otherwise
+    QVarLengthArray<QChar, 256> buffer(qMax(size, 1));
+    const int length = TextEncoding::decodeWindows1252(data, size, buffer.data());
+
+    return m_pool->intern(QStringView(buffer.constData(), length));
+}
+
+
+bool SegmentParser::endRow(const char *position)
+{
+    if (m_rows == std::numeric_limits<int>::max() - m_firstRow)
+        return false;
+
+    m_columns = qMax(m_columns, m_column);
+    m_column = 0;
+
+    if (m_titles) {
+        m_titles = nullptr;
+        if (m_checkpoints) {
+            m_checkpoints->clear();
+            addCheckpoint(position);
+        }
+        return true;
+    }
+    ++m_rows;
+
+    if (m_checkpoints && m_rows % CsvIndex::CheckpointRows == 0)
+        addCheckpoint(position);
+
+    if ((m_firstRow + m_rows) % SheetChunk::Rows == 0) {
+        flushWindow();
+        releasePages(position);
+        reportProgress(position);
+    }
+
+    return true;
+}
+
+
+void SegmentParser::addCheckpoint(const char *position)
+{
+    // Rows start after the line feed of a CR LF pair
+    if (position < m_end && position > m_data && *position == '\n' && position[-1] == '\r')
+        ++position;
+
+    m_checkpoints->append(position - m_data);
+}
+
+
+void SegmentParser::flushWindow()
+{
+    if (!m_rows || m_firstRow + m_rows <= m_windows.size() * SheetChunk::Rows)
+        return;
+
+    // Finished chunks are encoded right away, which keeps the peak at one
+    // window of plain chunks per worker
+    for (SheetChunk &chunk : m_chunks)
+        chunk.encode();
+
+    m_windows.append(m_chunks);
+    m_chunks.clear();
+}
+
+
+void SegmentParser::releasePages(const char *position)
+{
+#ifdef Q_OS_UNIX
+    if (!m_release)
+        return;
+
+    // Parsed pages are clean and can be read again, so they need not count
+    // towards the resident set while the rest of the file is parsed
+    const quintptr page = quintptr(sysconf(_SC_PAGESIZE));
+    const quintptr first = (quintptr(m_released) + page - 1) / page * page;
+    const quintptr last = quintptr(position) / page * page;
+    if (last > first) {
+        madvise(reinterpret_cast<void *>(first), size_t(last - first), MADV_DONTNEED);
+        m_released = position;
+    }
+#else
+    Q_UNUSED(position)
+#endif
+}
+
+
+void SegmentParser::reportProgress(const char *position)
+{
+    if (!m_bytesParsed)
+        return;
+
+    // Only bytes within the segment count, so that the segments add up to the file
+    const char *last = qMin(position, m_limit);
+    if (last > m_reported) {
+        m_bytesParsed->fetchAndAddRelaxed(last - m_reported);
+        m_reported = last;
+    }
+}
+
+} // namespace
+
+
+//
+// Reader
+//
+
+CsvReader::CsvReader(const QSharedPointer<StringPool> &pool)
+    : m_stringPool{pool}
+    , m_delimiter{','}
+    , m_quote{'"'}
+    , m_escape{0}
+    , m_headerRow{false}
+    , m_threadCount{QThread::idealThreadCount()}
+    , m_typeInference{true}
+    , m_encoding{TextEncoding::Utf8}
+    , m_mapped{false}
+    , m_indexed{false}
+    , m_textOffset{-1}
+    , m_bytesParsed{0}
+    , m_cancelled{0}
+    , m_size{0}
+    , m_stopped{0}
+    , m_compressed{false}
+    , m_bytesRead{0}
+    , m_rowCount{0}
+    , m_storedRows{0}
+{
+
+}
+
+
+char CsvReader::delimiter() const
+{
+    return m_delimiter;
+}
+
+
+void CsvReader::setDelimiter(const char delimiter)
+{
+    m_delimiter = delimiter;
+}
+
+
+char CsvReader::quote() const
+{
+    return m_quote;
+}
+
+
+void CsvReader::setQuote(const char quote)
+{
+    m_quote = quote;
+}
+
+
+char CsvReader::escape() const
+{
+    return m_escape;
+}
+
+
+void CsvReader::setEscape(const char escape)
+{
+    m_escape = escape;
+}
+
+
+bool CsvReader::hasHeaderRow() const
+{
+    return m_headerRow;
+}
+
+
+void CsvReader::setHeaderRow(const bool headerRow)
+{
+    m_headerRow = headerRow;
+}
+
+
+void CsvReader::setDialect(const CsvDialect &dialect)
+{
+    // Line breaks of any kind end rows, and the encoding is detected anew
+    m_delimiter = dialect.delimiter;
+    m_quote = dialect.quote;
+    m_escape = dialect.escape;
+    m_headerRow = dialect.headerRow;
+}
+
+
+int CsvReader::threadCount() const
+{
+    return m_threadCount;
+}
+
+
+void CsvReader::setThreadCount(const int count)
+{
+    m_threadCount = count > 0 ? count : QThread::idealThreadCount();
+}
+
+
+bool CsvReader::typeInference() const
+{
+    return m_typeInference;
+}
+
+
+void CsvReader::setTypeInference(const bool enabled)
+{
+    m_typeInference = enabled;
+}
+
+
+void CsvReader::setChunkHandler(const ChunkHandler &handler)
+{
+    m_chunkHandler = handler;
+}
+
+
+CsvIndex CsvReader::index() const
+{
+    return m_index;
+}
+
+
+void CsvReader::setIndex(const CsvIndex &index)
+{
+    m_knownIndex = index;
+}
+
+
+TextEncoding::Encoding CsvReader::encoding() const
+{
+    return m_encoding;
+}
+
+
+int CsvReader::progress() const
+{
+    if (m_size <= 0)
+        return 0;
+
+    const qint64 done = m_compressed ? m_bytesRead.loadRelaxed() : m_bytesParsed.loadRelaxed();
+    return int(qMin(done, m_size) * 100 / m_size);
+}
+
+
+void CsvReader::cancel()
+{
+    m_cancelled.storeRelaxed(1);
+}
+
+
+bool CsvReader::isCancelled() const
+{
+    return m_cancelled.loadRelaxed();
+}
+
+
+QSharedPointer<AbstractSheet> CsvReader::sheet() const
+{
+    return m_sheet;
+}
+
+
+QStringList CsvReader::columnTitles() const
+{
+    return m_columnTitles;
+}
+
+
+QString CsvReader::errorString() const
+{
+    return m_errorString;
+}
+
+
+//
+// Reading
+//
+
+bool CsvReader::read(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        m_errorString = file.errorString();
+        return false;
+    }
+
+    const qint64 size = file.size();
+    if (!size)
+        return parse(nullptr, 0);
+
+    // Fields are parsed straight from the page cache; the file is never
+    // copied into a buffer of its own
+    uchar *data = file.map(0, size);
+    if (!data) {
+        m_errorString = file.errorString();
+        return false;
+    }
+
+    // A file that is unchanged since it was indexed is cut into segments
+    // at indexed rows, and the column types found then are used again
+    m_mapped = true;
+    m_indexed = m_knownIndex.matches(fileName);
+    const bool ok = parse(reinterpret_cast<const char *>(data), size);
+    m_indexed = false;
+    m_mapped = false;
+
+    file.unmap(data);
+
+    // Only text read straight from the file has offsets worth keeping
+    m_index = CsvIndex();
+    if (ok && m_textOffset >= 0) {
+        m_index.setFile(size, QFileInfo(file).lastModified().toMSecsSinceEpoch());
+        m_index.setColumnTypes(m_columnTypes);
+        m_index.setRowCount(m_rowCount);
+        m_index.setCheckpoints(m_checkpoints);
+    }
+
+    return ok;
+}
+
+
+bool CsvReader::parse(const char *data, const qint64 size)
+{
+    // Compressed data is parsed from decompressed copies, never from the
+    // file itself
+    const Decompressor::Format format = Decompressor::detect(data, size);
+    if (format != Decompressor::Uncompressed) {
+        m_textOffset = -1;
+        const bool mapped = m_mapped;
+        m_mapped = false;
+        const bool ok = parseCompressed(data, size, format);
+        m_mapped = mapped;
+
+        return ok;
+    }
+
+    int bomSize = 0;
+    m_encoding = TextEncoding::detect(data, size, &bomSize);
+
+    if (m_encoding != TextEncoding::Utf16LE && m_encoding != TextEncoding::Utf16BE) {
+        m_textOffset = bomSize;
+        return parseText(data + bomSize, size - bomSize);
+    }
+    m_textOffset = -1;
+
+    // UTF-16 has to become UTF-8 before rows can be found in it; this is
+    // the one encoding that costs a pass of its own
+    std::unique_ptr<char[]> text;
+    const qint64 length = convertUtf16(data + bomSize, size - bomSize, m_encoding == TextEncoding::Utf16BE, text);
+
+    const bool mapped = m_mapped;
+    m_mapped = false;
+    const bool ok = parseText(text.get(), length);
+    m_mapped = mapped;
+
+    return ok;
+}
+
+
+qint64 CsvReader::convertUtf16(const char *data, const qint64 size, const bool bigEndian, std::unique_ptr<char[]> &text) const
+{
+    const auto *bytes = reinterpret_cast<const uchar *>(data);
+    const qint64 even = size & ~qint64(1);
+
+    // Blocks end on whole code units, never between the halves of a
+    // surrogate pair
+    QVector<qint64> bounds{0};
+    const qint64 blockSize = qMax(MinimumSegmentSize, even / m_threadCount) & ~qint64(1);
+    for (qint64 bound = blockSize; bound < even; bound += blockSize) {
+        const uchar *unit = bytes + bound - 2;
+        const uint value = bigEndian ? uint(unit[0] << 8 | unit[1]) : uint(unit[1] << 8 | unit[0]);
+        bounds.append(QChar::isHighSurrogate(value) ? bound + 2 : bound);
+    }
+    bounds.append(even);
+
+    // Every block gets room for three bytes per code unit; the gaps are
+    // closed once all blocks are done
+    text.reset(new char[size_t(even / 2 * 3 + 1)]);
+    QVector<qint64> lengths(bounds.size() - 1);
+    runTasks(m_threadCount, lengths.size(), [&](const int index) {
+        lengths[index] = TextEncoding::utf16ToUtf8(data + bounds.at(index), bounds.at(index + 1) - bounds.at(index), bigEndian, text.get() + bounds.at(index) / 2 * 3);
+    });
+
+    qint64 length = 0;
+    for (int index = 0; index < lengths.size(); ++index) {
+        std::memmove(text.get() + length, text.get() + bounds.at(index) / 2 * 3, size_t(lengths.at(index)));
+        length += lengths.at(index);
+    }
+
+    return length;
+}
+
+
+bool CsvReader::parseText(const char *data, const qint64 size)
+{
+    beginSheet(size);
+
+    return parseRows(data, size, true);
+}
+
+
+bool CsvReader::parseCompressed(const char *data, const qint64 size, const Decompressor::Format format)
+{
+    beginSheet(size);
+    m_compressed = true;
+
+    struct Block {
+        QByteArray data;
+        qint64 position;
+    };
+
+    // The decompressor runs ahead on a thread of its own while the rows of
+    // earlier blocks are parsed; only a few blocks are held at any time
+    Decompressor decompressor(format);
+    decompressor.setThreadCount(m_threadCount);
+
+    QMutex mutex;
+    QWaitCondition changed;
+    QVector<Block> queue;
+    bool finished = false;
+    bool stopped = false;
+    bool decompressed = true;
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(1);
+    pool.start(new Task([&]() {
+        const bool ok = decompressor.decompress(data, size, [&](const QByteArray &block, const qint64 position) {
+            QMutexLocker locker(&mutex);
+            while (queue.size() >= MaximumQueuedBlocks && !stopped)
+                changed.wait(&mutex);
+
+            queue.append({block, position});
+            changed.wakeAll();
+            return !stopped;
+        });
+
+        QMutexLocker locker(&mutex);
+        decompressed = ok;
+        finished = true;
+        changed.wakeAll();
+    }));
+
+    // Text not parsed yet, always starting at a row, and UTF-16 code units
+    // not converted yet
+    QByteArray pending;
+    QByteArray units;
+    bool head = true;
+    bool detected = false;
+    bool ok = true;
+
+    const auto convertUnits = [&](const bool last) {
+        qint64 usable = units.size() & ~1;
+        if (!last && usable >= 2) {
+            const uchar *unit = reinterpret_cast<const uchar *>(units.constData()) + usable - 2;
+            const uint value = m_encoding == TextEncoding::Utf16BE ? uint(unit[0] << 8 | unit[1]) : uint(unit[1] << 8 | unit[0]);
+            if (QChar::isHighSurrogate(value))
+                usable -= 2;
+        }
+
+        std::unique_ptr<char[]> text;
+        const qint64 length = convertUtf16(units.constData(), usable, m_encoding == TextEncoding::Utf16BE, text);
+        pending.append(text.get(), int(length));
+        units.remove(0, int(usable));
+    };
+
+    while (true) {
+        mutex.lock();
+        while (queue.isEmpty() && !finished)
+            changed.wait(&mutex);
+        if (queue.isEmpty()) {
+            mutex.unlock();
+            break;
+        }
+        Block block = queue.takeFirst();
+        changed.wakeAll();
+        mutex.unlock();
+
+        // The encoding is told by the start of the decompressed data
+        if (!detected) {
+            int bomSize = 0;
+            m_encoding = TextEncoding::detect(block.data.constData(), block.data.size(), &bomSize);
+            block.data.remove(0, bomSize);
+            detected = true;
+        }
+
+        if (m_encoding == TextEncoding::Utf16LE || m_encoding == TextEncoding::Utf16BE) {
+            units.append(block.data);
+            convertUnits(false);
+        }
+        else if (pending.isEmpty()) {
+            pending = block.data;
+        }
+        else {
+            pending.append(block.data);
+        }
+
+        // Rows cut off at the end of a block wait for the next one
+        const qint64 rows = completeRows(pending.constData(), pending.size());
+        if (rows) {
+            ok = parseRows(pending.constData(), rows, head);
+            head = false;
+            pending = pending.mid(int(rows));
+        }
+
+        m_bytesRead.storeRelaxed(block.position);
+
+        if (!ok || isCancelled())
+            break;
+    }
+
+    mutex.lock();
+    const bool complete = finished && queue.isEmpty();
+    stopped = true;
+    changed.wakeAll();
+    mutex.unlock();
+
+    pool.waitForDone();
+
+    // Whatever is left is the last row, which has no line break
+    if (ok && complete && !isCancelled()) {
+        if (!units.isEmpty())
+            convertUnits(true);
+        if (!pending.isEmpty())
+            ok = parseRows(pending.constData(), pending.size(), head);
+    }
+
+    if (ok && isCancelled()) {
+        m_errorString = QCoreApplication::translate("CsvReader", "Reading the file was canceled.");
+        return false;
+    }
+
+    if (ok && !decompressed) {
+        m_errorString = decompressor.errorString();
+        return false;
+    }
+
+    return ok;
+}
+
+
+void CsvReader::beginSheet(const qint64 size)
+{
+    m_sheet.reset(new ColumnarSheet(m_stringPool));
+    m_errorString.clear();
+    m_bytesParsed.storeRelaxed(0);
+    m_bytesRead.storeRelaxed(0);
+    m_size = size;
+    m_compressed = false;
+    m_rowCount = 0;
+    m_storedRows = 0;
+    m_stopped.storeRelaxed(0);
+    m_columnTypes.clear();
+    m_columnTitles.clear();
+    m_checkpoints.clear();
+}
+
+
+bool CsvReader::parseRows(const char *data, const qint64 size, const bool head)
+{
+    QVector<Segment> segments = splitSegments(size, head);
+    Segment *segment = segments.data();
+
+    // The first rows of the file are passed on before the rest is touched
+    int next = 0;
+    if (head) {
+        if (m_typeInference && m_indexed && m_textOffset >= 0)
+            m_columnTypes = m_knownIndex.columnTypes();
+        else if (m_typeInference)
+            inferTypes(data, size, segment[0]);
+
+        segment[0].head = true;
+        parseSegment(data, size, segment[0]);
+        m_sheet->setColumnTitles(m_columnTitles);
+        if (!appendSegment(segment[0]))
+            return false;
+
+        next = 1;
+    }
+
+    if (segments.size() == next)
+        return true;
+
+    // The next segment continues the last partly filled window; those
+    // after it start windows of their own while they are parsed in parallel
+    segment[next].firstRow = int(m_storedRows % SheetChunk::Rows);
+
+    // Segments cut at indexed rows are known to start outside of quotes
+    if (!m_indexed || m_textOffset < 0)
+        resolveQuotes(data, segments);
+
+    QMutex mutex;
+    QWaitCondition parsed;
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(m_threadCount);
+    for (int index = next; index < segments.size(); ++index) {
+        pool.start(new Task([&, index]() {
+            // Segments that would not be appended anymore are left alone
+            if (m_stopped.loadRelaxed())
+                segment[index].ok = false;
+            else
+                parseSegment(data, size, segment[index]);
+
+            QMutexLocker locker(&mutex);
+            segment[index].done = true;
+            parsed.wakeAll();
+        }));
+    }
+
+    // Segments finish in any order but are appended in file order
+    bool ok = true;
+    for (int index = next; index < segments.size() && ok; ++index) {
+        mutex.lock();
+        while (!segment[index].done)
+            parsed.wait(&mutex);
+        mutex.unlock();
+
+        ok = appendSegment(segment[index]);
+    }
+
+    // Once a segment fails the others are not needed anymore
+    if (!ok)
+        m_stopped.storeRelaxed(1);
+    pool.waitForDone();
+
+    return ok;
+}
+
+
+qint64 CsvReader::completeRows(const char *data, const qint64 size) const
+{
+    // The data starts at a row, so whether its end lies within a quoted
+    // field follows from the number of quotes; from there the last line
+    // break outside quotes is searched backwards
+    const CsvScanner scanner(m_delimiter, m_quote, m_escape);
+    bool inQuotes = scanner.countQuotes(data, size) % 2;
+
+    for (const char *position = data + size - 1; position >= data; --position) {
+        if (*position == m_quote) {
+            if (!scanner.isEscaped(data, position))
+                inQuotes = !inQuotes;
+        }
+        else if (!inQuotes && (*position == '\n' || (*position == '\r' && position + 1 < data + size))) {
+            if (!scanner.isEscaped(data, position))
+                return position + 1 - data;
+        }
+    }
+
+    return 0;
+}
+
+
+QVector<CsvReader::Segment> CsvReader::splitSegments(const qint64 size, const bool head) const
+{
+    // Only the start of the file gets a small segment of its own
+    const qint64 headSize = head ? qMin(size, HeadSegmentSize) : 0;
+    QVector<Segment> segments;
+    if (head) {
+        segments.append(Segment());
+        segments[0].last = headSize;
+    }
+
+    // A few segments per thread even out rows of different lengths
+    const qint64 rest = size - headSize;
+    const qint64 count = m_threadCount > 1 ? qBound(qint64(1), rest / MinimumSegmentSize, qint64(m_threadCount) * 4) : 1;
+    if (head && rest <= 0)
+        return segments;
+
+    for (qint64 index = 0; index < count; ++index) {
+        Segment segment;
+        segment.first = headSize + rest * index / count;
+        segment.last = headSize + rest * (index + 1) / count;
+        segments.append(segment);
+    }
+
+    if (!m_indexed || m_textOffset < 0)
+        return segments;
+
+    // Segments of an indexed file move on to the next indexed row, so that
+    // none of them has to search for its first row
+    const QVector<CsvIndex::Checkpoint> checkpoints = m_knownIndex.checkpoints();
+    QVector<Segment> indexed{segments.at(0)};
+    for (int index = 1; index < segments.size(); ++index) {
+        const auto checkpoint = std::lower_bound(checkpoints.cbegin(), checkpoints.cend(), segments.at(index).first + m_textOffset, [](const CsvIndex::Checkpoint &checkpoint, const qint64 offset) {
+            return checkpoint.offset < offset;
+        });
+        if (checkpoint == checkpoints.cend())
+            break;
+
+        const qint64 first = checkpoint->offset - m_textOffset;
+        if (first <= indexed.last().first || first >= size)
+            continue;
+
+        Segment segment;
+        segment.first = first;
+        segment.rowStart = true;
+        indexed.last().last = first;
+        indexed.append(segment);
+    }
+    indexed.last().last = size;
+
+    return indexed;
+}
+
+
+void CsvReader::inferTypes(const char *data, const qint64 size, const Segment &segment)
+{
+    // The head segment is sampled once before it is parsed for real
+    QVector<FieldParser::Sample> firstRow;
+    QVector<FieldParser::Sample> otherRows;
+
+    SegmentParser parser(m_stringPool.data(), m_delimiter, m_quote, m_escape, false, &m_cancelled, nullptr);
+    parser.setSamples(&firstRow, &otherRows);
+
+    int rows;
+    int columns;
+    QVector<QVector<SheetChunk>> windows;
+    parser.parse(data, size, data + segment.first, data + segment.last, rows, columns, windows);
+
+    // The first row is often a header, so it only decides columns that
+    // have nothing below it in the sample, and none once it is known to be one
+    m_columnTypes.resize(qMax(firstRow.size(), otherRows.size()));
+    for (int column = 0; column < m_columnTypes.size(); ++column) {
+        if (column < otherRows.size() && otherRows.at(column).count)
+            m_columnTypes[column] = otherRows.at(column).type();
+        else if (column < firstRow.size() && !m_headerRow)
+            m_columnTypes[column] = firstRow.at(column).type();
+        else
+            m_columnTypes[column] = FieldParser::Text;
+    }
+}
+
+
+void CsvReader::resolveQuotes(const char *data, QVector<Segment> &segments) const
+{
+    // Whether a segment starts inside a quoted field only depends on the
+    // number of quotes before it; counting them is cheap and parallel
+    QVector<qint64> quotes(segments.size());
+    runTasks(m_threadCount, segments.size(), [&](const int index) {
+        const CsvScanner scanner(m_delimiter, m_quote, m_escape);
+        const char *first = data + segments.at(index).first;
+        quotes[index] = scanner.countQuotes(first, segments.at(index).last - segments.at(index).first, scanner.isEscaped(data, first));
+    });
+
+    qint64 total = 0;
+    for (int index = 0; index < segments.size(); ++index) {
+        segments[index].inQuotes = total % 2;
+        total += quotes.at(index);
+    }
+}
+
+
+void CsvReader::parseSegment(const char *data, const qint64 size, Segment &segment)
+{
+    const char *end = data + size;
+    const char *first = data + segment.first;
+
+    // Move to the first row that starts within the segment
+    if (segment.first > 0) {
+
+        CsvScanner scanner(m_delimiter, m_quote, m_escape);
+        const bool rowStart = segment.rowStart || (!segment.inQuotes && (first[-1] == '\n' || (first[-1] == '\r' && *first != '\n')) && !scanner.isEscaped(data, first - 1));
+        if (!rowStart) {
+            scanner.reset(segment.inQuotes, scanner.isEscaped(data, first));
+
+            const char *start = end;
+            for (const char *block = first; block < end && start == end; block += CsvScanner::BlockSize) {
+
+                const char *bytes = block;
+                char padded[CsvScanner::BlockSize];
+                if (end - block < CsvScanner::BlockSize) {
+                    std::memset(padded, 0, sizeof(padded));
+                    std::memcpy(padded, block, size_t(end - block));
+                    bytes = padded;
+                }
+
+                quint64 separators = scanner.scan(bytes);
+                while (separators) {
+                    const char *separator = block + qCountTrailingZeroBits(separators);
+                    separators &= separators - 1;
+
+                    if (*separator == m_delimiter)
+                        continue;
+
+                    start = separator + 1;
+                    if (*separator == '\r' && start < end && *start == '\n')
+                        ++start;
+                    break;
+                }
+            }
+            first = start;
+        }
+    }
+
+    // Bytes skipped up to the first row are done with too
+    m_bytesParsed.fetchAndAddRelaxed(qMin(first, data + segment.last) - (data + segment.first));
+
+    SegmentParser parser(m_stringPool.data(), m_delimiter, m_quote, m_escape, m_mapped, &m_cancelled, &m_bytesParsed);
+    parser.setColumnTypes(&m_columnTypes);
+    parser.setEncoding(m_encoding);
+    parser.setCheckpoints(&segment.checkpoints);
+    parser.setFirstRow(segment.firstRow);
+    parser.setStopFlag(&m_stopped);
+    if (segment.head && m_headerRow)
+        parser.setTitles(&m_columnTitles);
+    segment.ok = parser.parse(data, size, first, data + segment.last, segment.rows, segment.columns, segment.windows);
+}
+
+
+bool CsvReader::appendSegment(Segment &segment)
+{
+    if (isCancelled()) {
+        m_errorString = QCoreApplication::translate("CsvReader", "Reading the file was canceled.");
+        return false;
+    }
+
+    // A segment continues the last window or starts a new one, like in the sheet
+    const qint64 first = segment.firstRow ? m_storedRows : (m_storedRows + SheetChunk::Rows - 1) / SheetChunk::Rows * SheetChunk::Rows;
+    const qint64 storedRows = segment.rows ? first + segment.rows : m_storedRows;
+
+    if (!segment.ok) {
+        m_sheet.reset(new ColumnarSheet(m_stringPool));
+        m_errorString = QCoreApplication::translate("CsvReader", "A part of the file could not be parsed.");
+        return false;
+    }
+
+    if (m_rowCount + segment.rows > std::numeric_limits<int>::max() || storedRows > std::numeric_limits<int>::max()) {
+        m_sheet.reset(new ColumnarSheet(m_stringPool));
+        m_errorString = QCoreApplication::translate("CsvReader", "The file has more rows than a sheet can hold.");
+        return false;
+    }
+
+    // Every segment keeps its own chunk windows; the row axis stitches the
+    // segments together in order, so at most the first window is copied
+    if (m_chunkHandler) {
+        if (segment.rows)
+            m_chunkHandler(segment.windows, segment.rows, segment.columns, segment.firstRow);
+    }
+    else {
+        m_sheet->appendChunks(segment.windows, segment.rows, segment.columns, segment.firstRow);
+    }
+
+    // Checkpoints are kept for rows the segment actually has
+    for (int index = 0; index < segment.checkpoints.size() && qint64(index) * CsvIndex::CheckpointRows < segment.rows; ++index)
+        m_checkpoints.append({m_rowCount + qint64(index) * CsvIndex::CheckpointRows, m_textOffset + segment.checkpoints.at(index)});
+
+    m_rowCount += segment.rows;
+    m_storedRows = storedRows;
+
+    segment.windows.clear();
+
+    return true;
+}
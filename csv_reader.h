@@ -0,0 +1,173 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CSV_READER_H
+#define CSV_READER_H
+
+#include <QAtomicInteger>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <functional>
+#include <memory>
+
+#include "csv_dialect.h"
+#include "csv_index.h"
+#include "decompressor.h"
+#include "field_parser.h"
+#include "sheet_chunk.h"
+#include "text_encoding.h"
+
+class AbstractSheet;
+class ColumnarSheet;
+class StringPool;
+
+
+class CsvReader
+{
+public:
+    using ChunkHandler = std::function<void(const QVector<QVector<SheetChunk>> &windows, const int rows, const int columns, const int firstRow)>;
+
+    explicit CsvReader(const QSharedPointer<StringPool> &pool);
+
+    char delimiter() const;
+    void setDelimiter(const char delimiter);
+
+    char quote() const;
+    void setQuote(const char quote);
+
+    char escape() const;
+    void setEscape(const char escape);
+
+    bool hasHeaderRow() const;
+    void setHeaderRow(const bool headerRow);
+
+    void setDialect(const CsvDialect &dialect);
+
+    int threadCount() const;
+    void setThreadCount(const int count);
+
+    bool typeInference() const;
+    void setTypeInference(const bool enabled);
+
+    void setChunkHandler(const ChunkHandler &handler);
+
+    CsvIndex index() const;
+    void setIndex(const CsvIndex &index);
+
+    bool read(const QString &fileName);
+    bool parse(const char *data, const qint64 size);
+
+    TextEncoding::Encoding encoding() const;
+
+    int progress() const;
+    void cancel();
+    bool isCancelled() const;
+
+    QSharedPointer<AbstractSheet> sheet() const;
+    QStringList columnTitles() const;
+    QString errorString() const;
+
+private:
+    // A byte range parsed by one worker; rows belong to the segment their
+    // first byte falls into
+    struct Segment {
+        qint64 first = 0;
+        qint64 last = 0;
+        bool head = false;
+        bool rowStart = false;
+        bool inQuotes = false;
+        bool ok = true;
+        bool done = false;
+        int firstRow = 0;
+        int rows = 0;
+        int columns = 0;
+        QVector<QVector<SheetChunk>> windows;
+        QVector<qint64> checkpoints;
+    };
+
+    bool parseText(const char *data, const qint64 size);
+    bool parseCompressed(const char *data, const qint64 size, const Decompressor::Format format);
+    qint64 convertUtf16(const char *data, const qint64 size, const bool bigEndian, std::unique_ptr<char[]> &text) const;
+
+    void beginSheet(const qint64 size);
+    bool parseRows(const char *data, const qint64 size, const bool head);
+    qint64 completeRows(const char *data, const qint64 size) const;
+
+    QVector<Segment> splitSegments(const qint64 size, const bool head) const;
+    void inferTypes(const char *data, const qint64 size, const Segment &segment);
+    void resolveQuotes(const char *data, QVector<Segment> &segments) const;
+    void parseSegment(const char *data, const qint64 size, Segment &segment);
+    bool appendSegment(Segment &segment);
+
+    QSharedPointer<StringPool> m_stringPool;
+    char m_delimiter;
+    char m_quote;
+    char m_escape;
+    bool m_headerRow;
+    int m_threadCount;
+    bool m_typeInference;
+    ChunkHandler m_chunkHandler;
+
+    // Detected for every file; UTF-16 is converted before parsing
+    TextEncoding::Encoding m_encoding;
+
+    // Inferred from the head segment and read by all workers
+    QVector<FieldParser::Type> m_columnTypes;
+
+    // Fields of the header row, taken from the head segment
+    QStringList m_columnTitles;
+
+    // Set while parsing a mapped file, whose parsed pages can be released
+    bool m_mapped;
+
+    // An index of an earlier read is used while the file is unchanged; the
+    // offset of the text in the file is unknown for converted text
+    CsvIndex m_knownIndex;
+    bool m_indexed;
+    qint64 m_textOffset;
+    QVector<CsvIndex::Checkpoint> m_checkpoints;
+    CsvIndex m_index;
+
+    // Read from other threads while parsing
+    QAtomicInteger<qint64> m_bytesParsed;
+    QAtomicInt m_cancelled;
+    qint64 m_size;
+
+    // Set when a segment fails, so that the others stop parsing
+    QAtomicInt m_stopped;
+
+    // Compressed files count progress by the compressed bytes used up
+    bool m_compressed;
+    QAtomicInteger<qint64> m_bytesRead;
+
+    // Rows read so far and the storage rows they take up in the sheet
+    qint64 m_rowCount;
+    qint64 m_storedRows;
+
+    QSharedPointer<ColumnarSheet> m_sheet;
+    QString m_errorString;
+};
+
+#endif // CSV_READER_H
@@ -0,0 +1,363 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "csv_scanner.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define CSV_SCANNER_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CSV_SCANNER_AVX2
+#include <immintrin.h>
+#endif
+
+
+//
+// Kernels
+//
+// Every kernel returns one bit per byte of a 64 byte block: quote
+// characters in one mask, delimiters and line breaks in the other.
+
+namespace {
+
+void classifyScalar(const char *block, const char delimiter, const char quote, quint64 *quotes, quint64 *separators)
+{
+    quint64 quoteBits = 0;
+    quint64 separatorBits = 0;
+
+    for (int index = 0; index < CsvScanner::BlockSize; ++index) {
+        const char byte = block[index];
+        if (byte == quote)
+            quoteBits |= Q_UINT64_C(1) << index;
+        else if (byte == delimiter || byte == '\n' || byte == '\r')
+            separatorBits |= Q_UINT64_C(1) << index;
+    }
+
+    *quotes = quoteBits;
+    *separators = separatorBits;
+}
+
+
+#ifdef CSV_SCANNER_SSE2
+void classifySse2(const char *block, const char delimiter, const char quote, quint64 *quotes, quint64 *separators)
+{
+    const __m128i quoteVector = _mm_set1_epi8(quote);
+    const __m128i delimiterVector = _mm_set1_epi8(delimiter);
+    const __m128i lineFeed = _mm_set1_epi8('\n');
+    const __m128i carriageReturn = _mm_set1_epi8('\r');
+
+    quint64 quoteBits = 0;
+    quint64 separatorBits = 0;
+
+    for (int offset = 0; offset < CsvScanner::BlockSize; offset += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + offset));
+
+        const __m128i isQuote = _mm_cmpeq_epi8(bytes, quoteVector);
+        const __m128i isSeparator = _mm_or_si128(_mm_cmpeq_epi8(bytes, delimiterVector),
+                                                 _mm_or_si128(_mm_cmpeq_epi8(bytes, lineFeed), _mm_cmpeq_epi8(bytes, carriageReturn)));
+
+        quoteBits |= quint64(quint16(_mm_movemask_epi8(isQuote))) << offset;
+        separatorBits |= quint64(quint16(_mm_movemask_epi8(isSeparator))) << offset;
+    }
+
+    // A delimiter equal to the quote character is a quote
+    *quotes = quoteBits;
+    *separators = separatorBits & ~quoteBits;
+}
+#endif
+
+
+#ifdef CSV_SCANNER_AVX2
+__attribute__((target("avx2")))
+quint64 matchAvx2(const __m256i bytes, const __m256i first, const __m256i second, const __m256i third)
+{
+    const __m256i matches = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, first),
+                                            _mm256_or_si256(_mm256_cmpeq_epi8(bytes, second), _mm256_cmpeq_epi8(bytes, third)));
+    return quint64(quint32(_mm256_movemask_epi8(matches)));
+}
+
+
+__attribute__((target("avx2")))
+void classifyAvx2(const char *block, const char delimiter, const char quote, quint64 *quotes, quint64 *separators)
+{
+    const __m256i quoteVector = _mm256_set1_epi8(quote);
+    const __m256i delimiterVector = _mm256_set1_epi8(delimiter);
+    const __m256i lineFeed = _mm256_set1_epi8('\n');
+    const __m256i carriageReturn = _mm256_set1_epi8('\r');
+
+    const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block));
+    const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + 32));
+
+    const quint64 quoteBits = matchAvx2(low, quoteVector, quoteVector, quoteVector) | (matchAvx2(high, quoteVector, quoteVector, quoteVector) << 32);
+    const quint64 separatorBits = matchAvx2(low, delimiterVector, lineFeed, carriageReturn) | (matchAvx2(high, delimiterVector, lineFeed, carriageReturn) << 32);
+
+    *quotes = quoteBits;
+    *separators = separatorBits & ~quoteBits;
+}
+#endif
+
+
+quint64 matchScalar(const char *block, const char byte)
+{
+    quint64 bits = 0;
+    for (int index = 0; index < CsvScanner::BlockSize; ++index) {
+        if (block[index] == byte)
+            bits |= Q_UINT64_C(1) << index;
+    }
+
+    return bits;
+}
+
+
+#ifdef CSV_SCANNER_SSE2
+quint64 matchSse2(const char *block, const char byte)
+{
+    const __m128i byteVector = _mm_set1_epi8(byte);
+
+    quint64 bits = 0;
+    for (int offset = 0; offset < CsvScanner::BlockSize; offset += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + offset));
+        bits |= quint64(quint16(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, byteVector)))) << offset;
+    }
+
+    return bits;
+}
+#endif
+
+
+quint64 prefixXor(quint64 bits)
+{
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+
+    return bits;
+}
+
+} // namespace
+
+
+//
+// Scanner
+//
+
+CsvScanner::CsvScanner(const char delimiter, const char quote, const char escape)
+    : m_delimiter{delimiter}
+    , m_quote{quote}
+    , m_escape{escape}
+    , m_kernel{kernel()}
+    , m_inQuotes{0}
+    , m_escaped{0}
+{
+
+}
+
+
+void CsvScanner::setKernel(const Kernel kernel)
+{
+    if (isKernelSupported(kernel))
+        m_kernel = kernel;
+}
+
+
+CsvScanner::Kernel CsvScanner::kernel()
+{
+    if (isKernelSupported(Avx2))
+        return Avx2;
+    if (isKernelSupported(Sse2))
+        return Sse2;
+    return Scalar;
+}
+
+
+bool CsvScanner::isKernelSupported(const Kernel kernel)
+{
+#ifdef CSV_SCANNER_AVX2
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+#else
+    const bool avx2 = false;
+#endif
+
+#ifdef CSV_SCANNER_SSE2
+    const bool sse2 = true;
+#else
+    const bool sse2 = false;
+#endif
+
+    switch (kernel) {
+    case Avx2:
+        return avx2;
+    case Sse2:
+        return sse2;
+    default:
+        return true;
+    }
+}
+
+
+QString CsvScanner::kernelName(const Kernel kernel)
+{
+    switch (kernel) {
+    case Avx2:
+        return QStringLiteral("AVX2");
+    case Sse2:
+        return QStringLiteral("SSE2");
+    default:
+        return QStringLiteral("Scalar");
+    }
+}
+
+
+void CsvScanner::classify(const Kernel kernel, const char *block, const char delimiter, const char quote, quint64 *quotes, quint64 *separators)
+{
+    switch (kernel) {
+#ifdef CSV_SCANNER_AVX2
+    case Avx2:
+        classifyAvx2(block, delimiter, quote, quotes, separators);
+        break;
+#endif
+#ifdef CSV_SCANNER_SSE2
+    case Sse2:
+        classifySse2(block, delimiter, quote, quotes, separators);
+        break;
+#endif
+    default:
+        classifyScalar(block, delimiter, quote, quotes, separators);
+        break;
+    }
+}
+
+
+quint64 CsvScanner::scan(const char *block)
+{
+    quint64 quotes;
+    quint64 separators;
+    classify(m_kernel, block, m_delimiter, m_quote, &quotes, &separators);
+
+    // Escaped quotes and separators are plain bytes
+    if (m_escape) {
+        const quint64 escaped = escapedBytes(block, &m_escaped);
+        quotes &= ~escaped;
+        separators &= ~escaped;
+    }
+
+    // Every quote toggles the state; the prefix XOR marks the bytes that
+    // follow an odd number of quotes. Doubled quotes toggle twice.
+    const quint64 inside = prefixXor(quotes) ^ m_inQuotes;
+    m_inQuotes = quint64(qint64(inside) >> 63);
+
+    return separators & ~inside;
+}
+
+
+bool CsvScanner::isInQuotes() const
+{
+    return m_inQuotes;
+}
+
+
+void CsvScanner::reset(const bool inQuotes, const bool escaped)
+{
+    m_inQuotes = inQuotes ? ~Q_UINT64_C(0) : 0;
+    m_escaped = escaped ? 1 : 0;
+}
+
+
+qint64 CsvScanner::countQuotes(const char *data, const qint64 size, const bool escaped) const
+{
+    qint64 count = 0;
+    quint64 carry = escaped ? 1 : 0;
+    quint64 quotes;
+    quint64 separators;
+
+    for (qint64 offset = 0; offset < size; offset += BlockSize) {
+
+        const char *block = data + offset;
+        char padded[BlockSize];
+        if (size - offset < BlockSize) {
+            std::memset(padded, 0, sizeof(padded));
+            std::memcpy(padded, block, size_t(size - offset));
+            block = padded;
+        }
+
+        classify(m_kernel, block, m_delimiter, m_quote, &quotes, &separators);
+        if (m_escape)
+            quotes &= ~escapedBytes(block, &carry);
+        count += qPopulationCount(quotes);
+    }
+
+    return count;
+}
+
+
+bool CsvScanner::isEscaped(const char *data, const char *position) const
+{
+    // Escape characters escape each other, so only an odd run counts
+    if (!m_escape)
+        return false;
+
+    const char *first = position;
+    while (first > data && first[-1] == m_escape)
+        --first;
+
+    return (position - first) % 2;
+}
+
+
+quint64 CsvScanner::escapedBytes(const char *block, quint64 *carry) const
+{
+#ifdef CSV_SCANNER_SSE2
+    const quint64 escapes = m_kernel == Scalar ? matchScalar(block, m_escape) : matchSse2(block, m_escape);
+#else
+    const quint64 escapes = matchScalar(block, m_escape);
+#endif
+
+    // Bytes that follow an odd run of escape characters, found with the
+    // carries of an addition as in simdjson; a run left open at the end
+    // of the block carries over into the next one
+    const quint64 evenBits = Q_UINT64_C(0x5555555555555555);
+    const quint64 oddBits = ~evenBits;
+
+    const quint64 starts = escapes & ~(escapes << 1);
+    const quint64 evenStartMask = evenBits ^ *carry;
+    const quint64 evenStarts = starts & evenStartMask;
+    const quint64 oddStarts = starts & ~evenStartMask;
+
+    const quint64 evenCarries = escapes + evenStarts;
+    quint64 oddCarries = escapes + oddStarts;
+    const bool overflow = oddCarries < escapes;
+
+    oddCarries |= *carry;
+    *carry = overflow ? 1 : 0;
+
+    const quint64 evenCarryEnds = evenCarries & ~escapes;
+    const quint64 oddCarryEnds = oddCarries & ~escapes;
+
+    return (evenCarryEnds & oddBits) | (oddCarryEnds & evenBits);
+}
@@ -0,0 +1,73 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CSV_SCANNER_H
+#define CSV_SCANNER_H
+
+#include <QString>
+#include <QtGlobal>
+
+
+class CsvScanner
+{
+public:
+    static constexpr int BlockSize = 64;
+
+    enum Kernel {
+        Scalar,
+        Sse2,
+        Avx2
+    };
+
+    CsvScanner(const char delimiter, const char quote, const char escape = 0);
+
+    void setKernel(const Kernel kernel);
+
+    quint64 scan(const char *block);
+    bool isInQuotes() const;
+    void reset(const bool inQuotes = false, const bool escaped = false);
+
+    qint64 countQuotes(const char *data, const qint64 size, const bool escaped = false) const;
+    bool isEscaped(const char *data, const char *position) const;
+
+    static Kernel kernel();
+    static bool isKernelSupported(const Kernel kernel);
+    static QString kernelName(const Kernel kernel);
+
+    static void classify(const Kernel kernel, const char *block, const char delimiter, const char quote, quint64 *quotes, quint64 *separators);
+
+private:
+    quint64 escapedBytes(const char *block, quint64 *carry) const;
+
+    char m_delimiter;
+    char m_quote;
+    char m_escape;
+    Kernel m_kernel;
+
+    // All ones while the previous block ended inside a quoted field
+    quint64 m_inQuotes;
+
+    // One while the previous block ended in an odd run of escape characters
+    quint64 m_escaped;
+};
+
+#endif // CSV_SCANNER_H
@@ -0,0 +1,602 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "csv_writer.h"
+
+#include <QCoreApplication>
+#include <QIODevice>
+#include <QLocale>
+#include <QMutex>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+#include <charconv>
+#include <cstring>
+#include <functional>
+
+#include "abstract_sheet.h"
+#include "cell_value.h"
+#include "string_pool.h"
+
+
+namespace {
+
+// Cells fetched and formatted at a time by one worker
+constexpr int BlockCells = 256 * 1024;
+
+// Narrow sheets are cut into blocks of this many rows at most
+constexpr int BlockRows = 16 * 1024;
+
+constexpr qint64 MillisecondsPerDay = 86400000;
+
+
+class Task : public QRunnable
+{
+public:
+    explicit Task(const std::function<void()> &function)
+        : m_function{function}
+    {
+
+    }
+
+    void run() override
+    {
+        m_function();
+    }
+
+private:
+    std::function<void()> m_function;
+};
+
+
+// Formatted output of one block; grows by doubling and is handed over
+// without a copy once the block is done
+class Buffer
+{
+public:
+    explicit Buffer(const int capacity)
+        : m_data(qMax(capacity, 64), Qt::Uninitialized)
+        , m_size{0}
+    {
+
+    }
+
+    char *reserve(const int size)
+    {
+        if (m_size + size > m_data.size())
+            m_data.resize(qMax(m_data.size() * 2, m_size + size));
+        return m_data.data() + m_size;
+    }
+
+    void commit(const char *end)
+    {
+        m_size = int(end - m_data.constData());
+    }
+
+    void append(const char c)
+    {
+        *reserve(1) = c;
+        ++m_size;
+    }
+
+    QByteArray take()
+    {
+        m_data.truncate(m_size);
+        return std::move(m_data);
+    }
+
+private:
+    QByteArray m_data;
+    int m_size;
+};
+
+
+// Bytes that make a field quoted, and how quotes within it are written
+struct Quoting {
+    char delimiter;
+    char quote;
+    char escape;
+
+    bool isSpecial(const uint c) const
+    {
+        return c == uint(uchar(delimiter)) || c == uint(uchar(quote)) || c == '\n' || c == '\r' || (escape && c == uint(uchar(escape)));
+    }
+
+    bool needsEscape(const uint c) const
+    {
+        return c == uint(uchar(quote)) || (escape && c == uint(uchar(escape)));
+    }
+
+    char escapeCharacter() const
+    {
+        return escape ? escape : quote;
+    }
+};
+
+
+void appendUtf8(Buffer &buffer, const char *data, const int size, const Quoting &quoting)
+{
+    bool quoted = false;
+    for (int i = 0; i < size && !quoted; ++i)
+        quoted = quoting.isSpecial(uchar(data[i]));
+
+    if (!quoted) {
+        char *out = buffer.reserve(size);
+        std::memcpy(out, data, size_t(size));
+        buffer.commit(out + size);
+        return;
+    }
+
+    char *out = buffer.reserve(size * 2 + 2);
+    *out++ = quoting.quote;
+    for (int i = 0; i < size; ++i) {
+        if (quoting.needsEscape(uchar(data[i])))
+            *out++ = quoting.escapeCharacter();
+        *out++ = data[i];
+    }
+    *out++ = quoting.quote;
+    buffer.commit(out);
+}
+
+
+void appendUtf16(Buffer &buffer, QStringView text, const Quoting &quoting)
+{
+    const QChar *data = text.data();
+    const int size = int(text.size());
+
+    bool quoted = false;
+    for (int i = 0; i < size && !quoted; ++i)
+        quoted = quoting.isSpecial(data[i].unicode());
+
+    // Three bytes per code unit at most, which also covers escaped quotes
+    char *out = buffer.reserve(size * 3 + 2);
+    if (quoted)
+        *out++ = quoting.quote;
+
+    for (int i = 0; i < size; ++i) {
+        uint c = data[i].unicode();
+
+        if (c < 0x80) {
+            if (quoted && quoting.needsEscape(c))
+                *out++ = quoting.escapeCharacter();
+            *out++ = char(c);
+            continue;
+        }
+
+        if (c < 0x800) {
+            *out++ = char(0xc0 | (c >> 6));
+            *out++ = char(0x80 | (c & 0x3f));
+            continue;
+        }
+
+        if (QChar::isHighSurrogate(c) && i + 1 < size && data[i + 1].isLowSurrogate()) {
+            c = QChar::surrogateToUcs4(ushort(c), data[++i].unicode());
+            *out++ = char(0xf0 | (c >> 18));
+            *out++ = char(0x80 | ((c >> 12) & 0x3f));
+            *out++ = char(0x80 | ((c >> 6) & 0x3f));
+            *out++ = char(0x80 | (c & 0x3f));
+            continue;
+        }
+
+        // Unpaired surrogates cannot be encoded
+        if (QChar::isSurrogate(c))
+            c = QChar::ReplacementCharacter;
+
+        *out++ = char(0xe0 | (c >> 12));
+        *out++ = char(0x80 | ((c >> 6) & 0x3f));
+        *out++ = char(0x80 | (c & 0x3f));
+    }
+
+    if (quoted)
+        *out++ = quoting.quote;
+    buffer.commit(out);
+}
+
+
+char *appendDigits(char *out, int value, const int width)
+{
+    for (int i = width - 1; i >= 0; --i, value /= 10)
+        out[i] = char('0' + value % 10);
+    return out + width;
+}
+
+
+bool appendDateTime(Buffer &buffer, const qint64 msecs)
+{
+    qint64 days = msecs / MillisecondsPerDay;
+    qint64 time = msecs % MillisecondsPerDay;
+    if (time < 0) {
+        --days;
+        time += MillisecondsPerDay;
+    }
+
+    // Civil date from days since 1970-01-01, after Howard Hinnant
+    const qint64 z = days + 719468;
+    const qint64 era = (z >= 0 ? z : z - 146096) / 146097;
+    const qint64 doe = z - era * 146097;
+    const qint64 yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const qint64 doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const qint64 mp = (5 * doy + 2) / 153;
+    const int day = int(doy - (153 * mp + 2) / 5 + 1);
+    const int month = int(mp < 10 ? mp + 3 : mp - 9);
+    const qint64 year = yoe + era * 400 + (month <= 2);
+
+    // Years that ISO 8601 cannot write in four digits go the slow way
+    if (year < 0 || year > 9999)
+        return false;
+
+    char *out = buffer.reserve(24);
+    out = appendDigits(out, int(year), 4);
+    *out++ = '-';
+    out = appendDigits(out, month, 2);
+    *out++ = '-';
+    out = appendDigits(out, day, 2);
+
+    if (time) {
+        *out++ = 'T';
+        out = appendDigits(out, int(time / 3600000), 2);
+        *out++ = ':';
+        out = appendDigits(out, int(time / 60000 % 60), 2);
+        *out++ = ':';
+        out = appendDigits(out, int(time / 1000 % 60), 2);
+        if (time % 1000) {
+            *out++ = '.';
+            out = appendDigits(out, int(time % 1000), 3);
+        }
+    }
+
+    buffer.commit(out);
+    return true;
+}
+
+
+void appendReal(Buffer &buffer, const double value)
+{
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    // Shortest text that reads back as the same double
+    char *out = buffer.reserve(32);
+    buffer.commit(std::to_chars(out, out + 32, value).ptr);
+#else
+    // Standard libraries without floating point std::to_chars
+    const QByteArray text = QByteArray::number(value, 'g', QLocale::FloatingPointShortest);
+    char *out = buffer.reserve(text.size());
+    std::memcpy(out, text.constData(), size_t(text.size()));
+    buffer.commit(out + text.size());
+#endif
+}
+
+
+void appendValue(Buffer &buffer, const CellValue &value, const StringPool *pool, const Quoting &quoting)
+{
+    switch (value.type()) {
+    case CellValue::Integer: {
+        char *out = buffer.reserve(24);
+        buffer.commit(std::to_chars(out, out + 24, value.integer()).ptr);
+        break;
+    }
+    case CellValue::Real:
+        appendReal(buffer, value.real());
+        break;
+    case CellValue::Boolean:
+        if (value.boolean())
+            appendUtf8(buffer, "TRUE", 4, quoting);
+        else
+            appendUtf8(buffer, "FALSE", 5, quoting);
+        break;
+    case CellValue::DateTime:
+        if (!appendDateTime(buffer, value.dateTime()))
+            appendUtf16(buffer, value.toString(pool), quoting);
+        break;
+    case CellValue::Error:
+        appendUtf16(buffer, CellValue::errorName(value.error()), quoting);
+        break;
+    case CellValue::InlineText:
+        appendUtf8(buffer, value.inlineText(), value.inlineSize(), quoting);
+        break;
+    case CellValue::PooledText:
+        appendUtf16(buffer, pool->view(value.stringId()), quoting);
+        break;
+    default:
+        break;
+    }
+}
+
+
+void appendLineEnding(Buffer &buffer, const CsvDialect::LineEnding lineEnding)
+{
+    if (lineEnding != CsvDialect::LF)
+        buffer.append('\r');
+    if (lineEnding != CsvDialect::CR)
+        buffer.append('\n');
+}
+
+} // namespace
+
+
+CsvWriter::CsvWriter()
+    : m_delimiter{','}
+    , m_quote{'"'}
+    , m_escape{0}
+    , m_lineEnding{CsvDialect::LF}
+    , m_threadCount{QThread::idealThreadCount()}
+    , m_rowsWritten{0}
+    , m_cancelled{0}
+    , m_rowCount{0}
+{
+
+}
+
+
+char CsvWriter::delimiter() const
+{
+    return m_delimiter;
+}
+
+
+void CsvWriter::setDelimiter(const char delimiter)
+{
+    m_delimiter = delimiter;
+}
+
+
+char CsvWriter::quote() const
+{
+    return m_quote;
+}
+
+
+void CsvWriter::setQuote(const char quote)
+{
+    m_quote = quote;
+}
+
+
+char CsvWriter::escape() const
+{
+    return m_escape;
+}
+
+
+void CsvWriter::setEscape(const char escape)
+{
+    m_escape = escape;
+}
+
+
+CsvDialect::LineEnding CsvWriter::lineEnding() const
+{
+    return m_lineEnding;
+}
+
+
+void CsvWriter::setLineEnding(const CsvDialect::LineEnding lineEnding)
+{
+    m_lineEnding = lineEnding;
+}
+
+
+void CsvWriter::setDialect(const CsvDialect &dialect)
+{
+    m_delimiter = dialect.delimiter;
+    m_quote = dialect.quote;
+    m_escape = dialect.escape;
+    m_lineEnding = dialect.lineEnding;
+}
+
+
+int CsvWriter::threadCount() const
+{
+    return m_threadCount;
+}
+
+
+void CsvWriter::setThreadCount(const int count)
+{
+    m_threadCount = count > 0 ? count : QThread::idealThreadCount();
+}
+
+
+int CsvWriter::progress() const
+{
+    if (m_rowCount <= 0)
+        return 0;
+
+    return int(m_rowsWritten.loadRelaxed() * 100 / m_rowCount);
+}
+
+
+void CsvWriter::cancel()
+{
+    m_cancelled.storeRelaxed(1);
+}
+
+
+bool CsvWriter::isCancelled() const
+{
+    return m_cancelled.loadRelaxed();
+}
+
+
+QString CsvWriter::errorString() const
+{
+    return m_errorString;
+}
+
+
+bool CsvWriter::write(const AbstractSheet *sheet, const QString &fileName)
+{
+    // The previous file stays in place until every row is on disk
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        m_errorString = file.errorString();
+        return false;
+    }
+
+    if (!write(sheet, &file)) {
+        file.cancelWriting();
+        return false;
+    }
+
+    if (!file.commit()) {
+        m_errorString = file.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+
+bool CsvWriter::write(const AbstractSheet *sheet, QIODevice *device)
+{
+    m_errorString.clear();
+    m_rowsWritten.storeRelaxed(0);
+    m_rowCount = sheet->rowCount();
+
+    const int rowsPerBlock = qBound(1, BlockCells / qMax(1, sheet->columnCount()), BlockRows);
+
+    QVector<Block> blocks;
+    for (int first = 0; first < m_rowCount; first += rowsPerBlock) {
+        Block block;
+        block.first = first;
+        block.rows = int(qMin<qint64>(rowsPerBlock, m_rowCount - first));
+        blocks.append(block);
+    }
+
+    // Column titles go first, as the header row they were read from
+    if (!sheet->columnTitles().isEmpty()) {
+        const QByteArray titles = formatTitles(sheet);
+        if (device->write(titles) != titles.size()) {
+            m_errorString = device->errorString();
+            return false;
+        }
+    }
+
+    Block *block = blocks.data();
+    const int count = blocks.size();
+    const int threads = qMin(m_threadCount, count);
+
+    QMutex mutex;
+    QWaitCondition blockDone;
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, threads));
+
+    const auto format = [&](const int index) {
+        formatBlock(sheet, block[index]);
+
+        QMutexLocker locker(&mutex);
+        block[index].done = true;
+        blockDone.wakeAll();
+    };
+
+    // Only a few blocks are formatted ahead of the one being written, so
+    // that memory stays bounded however large the sheet is
+    int started = 0;
+    if (threads > 1) {
+        for (; started < qMin(threads * 2, count); ++started)
+            pool.start(new Task([&format, started]() { format(started); }));
+    }
+
+    bool ok = true;
+    for (int index = 0; index < count; ++index) {
+
+        if (threads > 1) {
+            QMutexLocker locker(&mutex);
+            while (!block[index].done)
+                blockDone.wait(&mutex);
+        }
+        else {
+            formatBlock(sheet, block[index]);
+        }
+
+        if (isCancelled()) {
+            m_errorString = QCoreApplication::translate("CsvWriter", "Writing the file was canceled.");
+            ok = false;
+            break;
+        }
+
+        if (device->write(block[index].data) != block[index].data.size()) {
+            m_errorString = device->errorString();
+            ok = false;
+            break;
+        }
+
+        block[index].data = QByteArray();
+        m_rowsWritten.fetchAndAddRelaxed(block[index].rows);
+
+        if (threads > 1 && started < count) {
+            pool.start(new Task([&format, started]() { format(started); }));
+            ++started;
+        }
+    }
+
+    pool.waitForDone();
+
+    return ok;
+}
+
+
+void CsvWriter::formatBlock(const AbstractSheet *sheet, Block &block) const
+{
+    const int columns = sheet->columnCount();
+    const StringPool *pool = sheet->stringPool().data();
+
+    QVector<CellValue> values;
+    sheet->fetchRange(block.first, 0, block.rows, columns, values);
+
+    const Quoting quoting{m_delimiter, m_quote, m_escape};
+
+    Buffer buffer(block.rows * (columns + 1) * 8);
+    const CellValue *value = values.constData();
+    for (int row = 0; row < block.rows; ++row) {
+
+        if (isCancelled())
+            return;
+
+        for (int column = 0; column < columns; ++column, ++value) {
+            if (column)
+                buffer.append(m_delimiter);
+            appendValue(buffer, *value, pool, quoting);
+        }
+        appendLineEnding(buffer, m_lineEnding);
+    }
+
+    block.data = buffer.take();
+}
+
+
+QByteArray CsvWriter::formatTitles(const AbstractSheet *sheet) const
+{
+    const Quoting quoting{m_delimiter, m_quote, m_escape};
+
+    Buffer buffer(256);
+    for (int column = 0; column < sheet->columnCount(); ++column) {
+        if (column)
+            buffer.append(m_delimiter);
+        appendUtf16(buffer, sheet->columnTitle(column), quoting);
+    }
+    appendLineEnding(buffer, m_lineEnding);
+
+    return buffer.take();
+}
@@ -0,0 +1,94 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CSV_WRITER_H
+#define CSV_WRITER_H
+
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+#include "csv_dialect.h"
+
+class AbstractSheet;
+class QIODevice;
+
+
+class CsvWriter
+{
+public:
+    CsvWriter();
+
+    char delimiter() const;
+    void setDelimiter(const char delimiter);
+
+    char quote() const;
+    void setQuote(const char quote);
+
+    char escape() const;
+    void setEscape(const char escape);
+
+    CsvDialect::LineEnding lineEnding() const;
+    void setLineEnding(const CsvDialect::LineEnding lineEnding);
+
+    void setDialect(const CsvDialect &dialect);
+
+    int threadCount() const;
+    void setThreadCount(const int count);
+
+    bool write(const AbstractSheet *sheet, const QString &fileName);
+    bool write(const AbstractSheet *sheet, QIODevice *device);
+
+    int progress() const;
+    void cancel();
+    bool isCancelled() const;
+
+    QString errorString() const;
+
+private:
+    // Rows formatted by one worker; blocks are written in sheet order
+    struct Block {
+        int first = 0;
+        int rows = 0;
+        bool done = false;
+        QByteArray data;
+    };
+
+    void formatBlock(const AbstractSheet *sheet, Block &block) const;
+    QByteArray formatTitles(const AbstractSheet *sheet) const;
+
+    char m_delimiter;
+    char m_quote;
+    char m_escape;
+    CsvDialect::LineEnding m_lineEnding;
+    int m_threadCount;
+
+    // Read from other threads while writing
+    QAtomicInteger<qint64> m_rowsWritten;
+    QAtomicInt m_cancelled;
+    qint64 m_rowCount;
+
+    QString m_errorString;
+};
+
+#endif // CSV_WRITER_H
@@ -0,0 +1,483 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "decompressor.h"
+
+#include <QCoreApplication>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+
+#ifdef HAVE_BZIP2
+#include <bzlib.h>
+#endif
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+
+namespace {
+
+// Decompressed data handed on at a time
+constexpr int DefaultBlockSize = 4 * 1024 * 1024;
+
+#ifdef HAVE_ZSTD
+// Frames larger than this are streamed rather than decompressed whole
+constexpr qint64 MaximumFrameSize = 64 * 1024 * 1024;
+#endif
+
+#if defined(HAVE_ZLIB) || defined(HAVE_BZIP2)
+// zlib and libbz2 take their input in pieces that fit into an unsigned int
+constexpr qint64 MaximumInputSize = 1024 * 1024 * 1024;
+#endif
+
+
+class Task : public QRunnable
+{
+public:
+    explicit Task(const std::function<void()> &function)
+        : m_function{function}
+    {
+
+    }
+
+    void run() override
+    {
+        m_function();
+    }
+
+private:
+    std::function<void()> m_function;
+};
+
+
+// Collects the output of a streaming decoder and hands it on one full
+// block at a time
+class BlockOutput
+{
+public:
+    BlockOutput(const int blockSize, const Decompressor::BlockHandler &handler)
+        : m_block(blockSize, Qt::Uninitialized)
+        , m_blockSize{blockSize}
+        , m_filled{0}
+        , m_handler{handler}
+    {
+
+    }
+
+    char *next()
+    {
+        return m_block.data() + m_filled;
+    }
+
+    int available() const
+    {
+        return m_blockSize - m_filled;
+    }
+
+    // False once the handler wants no more
+    bool advance(const int bytes, const qint64 position)
+    {
+        m_filled += bytes;
+        if (m_filled < m_blockSize)
+            return true;
+
+        const bool more = m_handler(m_block, position);
+        m_block = QByteArray(m_blockSize, Qt::Uninitialized);
+        m_filled = 0;
+
+        return more;
+    }
+
+    bool finish(const qint64 position)
+    {
+        if (!m_filled)
+            return true;
+
+        m_block.truncate(m_filled);
+        m_filled = 0;
+
+        return m_handler(m_block, position);
+    }
+
+private:
+    QByteArray m_block;
+    int m_blockSize;
+    int m_filled;
+    const Decompressor::BlockHandler &m_handler;
+};
+
+
+QString truncatedError()
+{
+    return QCoreApplication::translate("Decompressor", "The compressed file is incomplete.");
+}
+} // namespace
+
+
+Decompressor::Decompressor(const Format format)
+    : m_format{format}
+    , m_threadCount{QThread::idealThreadCount()}
+    , m_blockSize{DefaultBlockSize}
+{
+
+}
+
+
+Decompressor::Format Decompressor::detect(const char *data, const qint64 size)
+{
+    const auto *bytes = reinterpret_cast<const uchar *>(data);
+
+    if (size >= 2 && bytes[0] == 0x1f && bytes[1] == 0x8b)
+        return Gzip;
+
+    if (size >= 4 && bytes[0] == 'B' && bytes[1] == 'Z' && bytes[2] == 'h' && bytes[3] >= '1' && bytes[3] <= '9')
+        return Bzip2;
+
+    // Regular and skippable frames
+    if (size >= 4 && ((bytes[0] == 0x28 && bytes[1] == 0xb5 && bytes[2] == 0x2f && bytes[3] == 0xfd)
+            || ((bytes[0] & 0xf0) == 0x50 && bytes[1] == 0x2a && bytes[2] == 0x4d && bytes[3] == 0x18)))
+        return Zstd;
+
+    return Uncompressed;
+}
+
+
+Decompressor::Format Decompressor::format() const
+{
+    return m_format;
+}
+
+
+int Decompressor::threadCount() const
+{
+    return m_threadCount;
+}
+
+
+void Decompressor::setThreadCount(const int count)
+{
+    m_threadCount = count > 0 ? count : QThread::idealThreadCount();
+}
+
+
+int Decompressor::blockSize() const
+{
+    return m_blockSize;
+}
+
+
+void Decompressor::setBlockSize(const int size)
+{
+    m_blockSize = size > 0 ? size : DefaultBlockSize;
+}
+
+
+bool Decompressor::decompress(const char *data, const qint64 size, const BlockHandler &handler)
+{
+    m_errorString.clear();
+
+    // Formats whose library was left out of the build are still detected,
+    // so that they are refused rather than read as text
+    switch (m_format) {
+    case Gzip:
+#ifdef HAVE_ZLIB
+        return inflateGzip(data, size, handler);
+#else
+        m_errorString = QCoreApplication::translate("Decompressor", "This build cannot read files compressed with %1.").arg(QStringLiteral("gzip"));
+        return false;
+#endif
+    case Bzip2:
+#ifdef HAVE_BZIP2
+        return decompressBzip2(data, size, handler);
+#else
+        m_errorString = QCoreApplication::translate("Decompressor", "This build cannot read files compressed with %1.").arg(QStringLiteral("bzip2"));
+        return false;
+#endif
+    case Zstd:
+#ifdef HAVE_ZSTD
+        return decompressZstdFrames(data, size, handler);
+#else
+        m_errorString = QCoreApplication::translate("Decompressor", "This build cannot read files compressed with %1.").arg(QStringLiteral("zstd"));
+        return false;
+#endif
+    default:
+        break;
+    }
+
+    // Uncompressed data is only cut into blocks
+    for (qint64 position = 0; position < size; position += m_blockSize) {
+        const int length = int(qMin(qint64(m_blockSize), size - position));
+        if (!handler(QByteArray(data + position, length), position + length))
+            break;
+    }
+
+    return true;
+}
+
+
+QString Decompressor::errorString() const
+{
+    return m_errorString;
+}
+
+
+//
+// Formats
+//
+
+#ifdef HAVE_ZLIB
+bool Decompressor::inflateGzip(const char *data, const qint64 size, const BlockHandler &handler)
+{
+    z_stream stream = {};
+    // Gzip and zlib headers are both accepted
+    if (inflateInit2(&stream, MAX_WBITS + 32) != Z_OK) {
+        m_errorString = QCoreApplication::translate("Decompressor", "The gzip decompressor could not be started.");
+        return false;
+    }
+
+    BlockOutput output(m_blockSize, handler);
+    const auto *input = reinterpret_cast<const Bytef *>(data);
+    qint64 left = size;
+    bool ok = true;
+
+    while (true) {
+        if (!stream.avail_in && left) {
+            stream.next_in = const_cast<Bytef *>(input + (size - left));
+            stream.avail_in = uInt(qMin(left, MaximumInputSize));
+            left -= stream.avail_in;
+        }
+
+        stream.next_out = reinterpret_cast<Bytef *>(output.next());
+        stream.avail_out = uInt(output.available());
+        const int result = inflate(&stream, Z_NO_FLUSH);
+        const int produced = output.available() - int(stream.avail_out);
+        const qint64 position = size - left - stream.avail_in;
+
+        if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+            m_errorString = stream.msg ? QString::fromLatin1(stream.msg) : QCoreApplication::translate("Decompressor", "The gzip data is corrupt.");
+            ok = false;
+            break;
+        }
+
+        // What came before the end of a cut off file is still handed on
+        if (result == Z_BUF_ERROR && !stream.avail_in && !left) {
+            output.finish(size);
+            m_errorString = truncatedError();
+            ok = false;
+            break;
+        }
+
+        if (!output.advance(produced, position))
+            break;
+
+        // Parallel compressors write several members one after another;
+        // anything else after the last member is ignored, like gzip does
+        if (result == Z_STREAM_END) {
+            const auto *rest = reinterpret_cast<const char *>(stream.next_in);
+            if (detect(rest, stream.avail_in + left) != Gzip) {
+                output.finish(size);
+                break;
+            }
+            inflateReset(&stream);
+        }
+    }
+
+    inflateEnd(&stream);
+
+    return ok;
+}
+#endif // HAVE_ZLIB
+
+
+#ifdef HAVE_BZIP2
+bool Decompressor::decompressBzip2(const char *data, const qint64 size, const BlockHandler &handler)
+{
+    bz_stream stream = {};
+    if (BZ2_bzDecompressInit(&stream, 0, 0) != BZ_OK) {
+        m_errorString = QCoreApplication::translate("Decompressor", "The bzip2 decompressor could not be started.");
+        return false;
+    }
+
+    BlockOutput output(m_blockSize, handler);
+    qint64 left = size;
+    bool ok = true;
+
+    while (true) {
+        if (!stream.avail_in && left) {
+            stream.next_in = const_cast<char *>(data + (size - left));
+            stream.avail_in = uint(qMin(left, MaximumInputSize));
+            left -= stream.avail_in;
+        }
+
+        stream.next_out = output.next();
+        stream.avail_out = uint(output.available());
+        const int result = BZ2_bzDecompress(&stream);
+        const int produced = output.available() - int(stream.avail_out);
+        const qint64 position = size - left - stream.avail_in;
+
+        if (result != BZ_OK && result != BZ_STREAM_END) {
+            m_errorString = QCoreApplication::translate("Decompressor", "The bzip2 data is corrupt.");
+            ok = false;
+            break;
+        }
+
+        if (result == BZ_OK && !produced && !stream.avail_in && !left) {
+            output.finish(size);
+            m_errorString = truncatedError();
+            ok = false;
+            break;
+        }
+
+        if (!output.advance(produced, position))
+            break;
+
+        // Streams written one after another, as by parallel compressors
+        if (result == BZ_STREAM_END) {
+            const char *rest = stream.next_in;
+            const qint64 restSize = stream.avail_in + left;
+            if (detect(rest, restSize) != Bzip2) {
+                output.finish(size);
+                break;
+            }
+
+            BZ2_bzDecompressEnd(&stream);
+            stream = {};
+            BZ2_bzDecompressInit(&stream, 0, 0);
+            stream.next_in = const_cast<char *>(rest);
+            stream.avail_in = uint(qMin(restSize, MaximumInputSize));
+            left = restSize - stream.avail_in;
+        }
+    }
+
+    BZ2_bzDecompressEnd(&stream);
+
+    return ok;
+}
+#endif // HAVE_BZIP2
+
+
+#ifdef HAVE_ZSTD
+bool Decompressor::decompressZstd(const char *data, const qint64 size, const BlockHandler &handler)
+{
+    ZSTD_DStream *stream = ZSTD_createDStream();
+    ZSTD_initDStream(stream);
+
+    BlockOutput output(m_blockSize, handler);
+    ZSTD_inBuffer input = {data, size_t(size), 0};
+    bool ok = true;
+
+    while (true) {
+        ZSTD_outBuffer buffer = {output.next(), size_t(output.available()), 0};
+        const size_t result = ZSTD_decompressStream(stream, &buffer, &input);
+
+        if (ZSTD_isError(result)) {
+            m_errorString = QString::fromLatin1(ZSTD_getErrorName(result));
+            ok = false;
+            break;
+        }
+
+        const bool flushed = input.pos == input.size && buffer.pos < buffer.size;
+        if (!output.advance(int(buffer.pos), qint64(input.pos)))
+            break;
+
+        // All input is used up and all output written; a frame that has
+        // not ended by then was cut off
+        if (flushed) {
+            if (result) {
+                m_errorString = truncatedError();
+                ok = false;
+            }
+            output.finish(size);
+            break;
+        }
+    }
+
+    ZSTD_freeDStream(stream);
+
+    return ok;
+}
+
+
+bool Decompressor::decompressZstdFrames(const char *data, const qint64 size, const BlockHandler &handler)
+{
+    struct Frame {
+        qint64 offset;
+        qint64 size;
+        qint64 contentSize;
+    };
+
+    // Frames are independent of each other, so those of a known, bounded
+    // size are decompressed in parallel; everything else is streamed
+    QVector<Frame> frames;
+    for (qint64 offset = 0; offset < size && m_threadCount > 1; ) {
+        const size_t frameSize = ZSTD_findFrameCompressedSize(data + offset, size_t(size - offset));
+        if (ZSTD_isError(frameSize))
+            return decompressZstd(data, size, handler);
+
+        const unsigned long long contentSize = ZSTD_getFrameContentSize(data + offset, frameSize);
+        if (contentSize == ZSTD_CONTENTSIZE_UNKNOWN || contentSize == ZSTD_CONTENTSIZE_ERROR || contentSize > quint64(MaximumFrameSize))
+            return decompressZstd(data, size, handler);
+
+        frames.append({offset, qint64(frameSize), qint64(contentSize)});
+        offset += qint64(frameSize);
+    }
+
+    if (frames.size() < 2)
+        return decompressZstd(data, size, handler);
+
+    // One frame per thread at a time keeps memory bounded
+    for (int first = 0; first < frames.size(); first += m_threadCount) {
+        const int count = qMin(m_threadCount, frames.size() - first);
+
+        QVector<QByteArray> blocks(count);
+        QVector<size_t> results(count);
+        QThreadPool pool;
+        pool.setMaxThreadCount(m_threadCount);
+        for (int index = 0; index < count; ++index) {
+            pool.start(new Task([&, index]() {
+                const Frame &frame = frames.at(first + index);
+                blocks[index] = QByteArray(int(frame.contentSize), Qt::Uninitialized);
+                results[index] = ZSTD_decompress(blocks[index].data(), size_t(frame.contentSize), data + frame.offset, size_t(frame.size));
+            }));
+        }
+        pool.waitForDone();
+
+        for (int index = 0; index < count; ++index) {
+            const Frame &frame = frames.at(first + index);
+            if (ZSTD_isError(results.at(index)) || qint64(results.at(index)) != frame.contentSize) {
+                m_errorString = ZSTD_isError(results.at(index)) ? QString::fromLatin1(ZSTD_getErrorName(results.at(index))) : truncatedError();
+                return false;
+            }
+
+            if (frame.contentSize && !handler(blocks.at(index), frame.offset + frame.size))
+                return true;
+        }
+    }
+
+    return true;
+}
+#endif // HAVE_ZSTD
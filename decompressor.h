@@ -0,0 +1,75 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef DECOMPRESSOR_H
+#define DECOMPRESSOR_H
+
+#include <QByteArray>
+#include <QString>
+
+#include <functional>
+
+
+class Decompressor
+{
+public:
+    enum Format {
+        Uncompressed,
+        Gzip,
+        Bzip2,
+        Zstd
+    };
+
+    // Receives the decompressed data in order, along with the number of
+    // compressed bytes used up so far; returning false stops decompression
+    using BlockHandler = std::function<bool(const QByteArray &block, const qint64 position)>;
+
+    explicit Decompressor(const Format format);
+
+    static Format detect(const char *data, const qint64 size);
+
+    Format format() const;
+
+    int threadCount() const;
+    void setThreadCount(const int count);
+
+    int blockSize() const;
+    void setBlockSize(const int size);
+
+    bool decompress(const char *data, const qint64 size, const BlockHandler &handler);
+
+    QString errorString() const;
+
+private:
+    bool inflateGzip(const char *data, const qint64 size, const BlockHandler &handler);
+    bool decompressBzip2(const char *data, const qint64 size, const BlockHandler &handler);
+    bool decompressZstd(const char *data, const qint64 size, const BlockHandler &handler);
+    bool decompressZstdFrames(const char *data, const qint64 size, const BlockHandler &handler);
+
+    Format m_format;
+    int m_threadCount;
+    int m_blockSize;
+
+    QString m_errorString;
+};
+
+#endif // DECOMPRESSOR_H
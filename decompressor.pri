@@ -0,0 +1,44 @@
+#
+# Copyright 2022 naracanto <https://naracanto.github.io>.
+#
+# This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+#
+# QTabelo is an open source table editor written in C++ using the
+# Qt framework.
+#
+# QTabelo is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# QTabelo is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+#
+
+# Decompressors for compressed imports. Each library is optional; files in
+# a format built without are detected and refused with an error.
+CONFIG += link_pkgconfig
+
+packagesExist(zlib) {
+    PKGCONFIG += zlib
+    DEFINES += HAVE_ZLIB
+}
+
+# Not every bzip2 installation ships a pkg-config file
+packagesExist(bzip2) {
+    PKGCONFIG += bzip2
+    DEFINES += HAVE_BZIP2
+} else: unix: exists(/usr/include/bzlib.h) {
+    LIBS += -lbz2
+    DEFINES += HAVE_BZIP2
+}
+
+packagesExist(libzstd) {
+    PKGCONFIG += libzstd
+    DEFINES += HAVE_ZSTD
+}
@@ -27,19 +27,53 @@
 #include <QCloseEvent>
 #include <QDebug>
 #include <QFile>
+#include <QFileInfo>
 #include <QInputDialog>
 #include <QMessageBox>
+#include <QSettings>
 #include <QWidget>
 
 #include "rename_dialog.h"
+#include "sheet_loader.h"
+#include "sheet_saver.h"
+#include "workbook_file.h"
+#include "workbook_saver.h"
+
+
+namespace {
+
+// Compressed files are read through a decompressor but never written
+bool isCompressed(const QFileInfo &fileInfo)
+{
+    const QString suffix = fileInfo.suffix().toLower();
+    return suffix == QLatin1String("gz") || suffix == QLatin1String("bz2") || suffix == QLatin1String("zst");
+}
+
+
+// Workbook files hold all sheets; every other file a single sheet as CSV
+bool isWorkbook(const QFileInfo &fileInfo)
+{
+    return fileInfo.suffix().toLower() == QLatin1String("qtab");
+}
+
+} // namespace
 
 
 DocumentWidget::DocumentWidget(QWidget *parent)
     : TableDocument(parent)
     , m_modified{false}
     , m_url{QUrl()}
+    , m_dialect{CsvDialect()}
+    , m_journal{nullptr}
+    , m_editSequence{0}
+    , m_savedSequence{0}
 {
     setAttribute(Qt::WA_DeleteOnClose);
+
+    connect(this, &TableDocument::sheetEdited, this, &DocumentWidget::slotSheetEdited);
+    connect(this, &TableDocument::sheetMoved, this, &DocumentWidget::slotSheetMoved);
+    connect(this, &TableDocument::sheetClosed, this, &DocumentWidget::slotSheetClosed);
+    connect(this, &TableDocument::sheetLoaded, this, &DocumentWidget::slotReplayJournal);
 }
 
 
@@ -118,6 +152,306 @@ void DocumentWidget::initUrl()
 // Document
 //
 
+bool DocumentWidget::load(const QUrl &url, const CsvDialect &dialect, QString *errorString)
+{
+    const QFileInfo fileInfo(url.toLocalFile());
+
+    // Files that cannot be read at all fail right away; the rows of all
+    // others are loaded in the background
+    QFile file(fileInfo.filePath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorString)
+            *errorString = file.errorString();
+        return false;
+    }
+    file.close();
+
+    auto *loader = new SheetLoader(fileInfo.filePath(), stringPool());
+    loader->setThreadCount(QSettings().value(QStringLiteral("Import/Threads"), 0).toInt());
+    loader->setDialect(dialect);
+    m_dialect = dialect;
+
+    // The sheet of "data.csv.gz" is called "data"
+    const QString name = isCompressed(fileInfo) ? QFileInfo(fileInfo.completeBaseName()).completeBaseName() : fileInfo.completeBaseName();
+    loadSheet(loader, name);
+
+    journalSaved(fileInfo.filePath(), m_editSequence);
+
+    return true;
+}
+
+
+bool DocumentWidget::loadWorkbook(const QUrl &url, QString *errorString)
+{
+    // Nothing is parsed; sheets are decoded once their tab is shown and
+    // then point into the mapped file
+    QSharedPointer<WorkbookFile> file(new WorkbookFile);
+    if (!file->load(url.toLocalFile(), arena(), stringPool())) {
+        if (errorString)
+            *errorString = file->errorString();
+        return false;
+    }
+
+    for (int index = 0; index < file->sheetCount(); ++index)
+        addPendingSheet([file, index]() { return file->sheet(index); }, file->sheetName(index));
+
+    setDocumentSettings(file->documentSettings());
+    m_workbook = file;
+
+    journalSaved(url.toLocalFile(), m_editSequence);
+
+    return true;
+}
+
+
+bool DocumentWidget::save(const QUrl &url, const bool copy, QString *errorString)
+{
+    if (isWorkbook(QFileInfo(url.toLocalFile())))
+        return saveWorkbook(url, copy, errorString);
+
+    // A CSV file holds a single sheet, the one being shown; other sheets
+    // would count as saved without being written anywhere, so only a
+    // copy can leave them out
+    if (!copy && sheetCount() > 1) {
+        if (errorString)
+            *errorString = tr("A CSV file holds a single sheet. Save the document as a workbook (.qtab) to keep all of its sheets.");
+        return false;
+    }
+
+    const int index = currentSheetIndex();
+    if (isSheetBusy(index)) {
+        if (errorString)
+            *errorString = tr("The sheet is still being loaded or saved.");
+        return false;
+    }
+
+    const QSharedPointer<const AbstractSheet> sheet = snapshotSheet(index);
+    if (!sheet) {
+        if (errorString)
+            *errorString = tr("There is no sheet to save.");
+        return false;
+    }
+
+    const QFileInfo fileInfo(url.toLocalFile());
+    if (isCompressed(fileInfo)) {
+        if (errorString)
+            *errorString = tr("Compressed files can only be opened; save the document under another name.");
+        return false;
+    }
+
+    auto *saver = new SheetSaver(sheet, fileInfo.filePath());
+    saver->setThreadCount(QSettings().value(QStringLiteral("Import/Threads"), 0).toInt());
+    // Files are written the way they were read, unless the suffix asks
+    // for tabs or no longer does
+    CsvDialect dialect = m_dialect;
+    const QString suffix = fileInfo.suffix().toLower();
+    if (suffix == QLatin1String("tsv") || suffix == QLatin1String("tab"))
+        dialect.delimiter = '\t';
+    else if (dialect.delimiter == '\t')
+        dialect.delimiter = ',';
+    saver->setDialect(dialect);
+
+    // Only a file that is complete on disk counts as saved, and only with
+    // the edits made up to now
+    if (!copy) {
+        const quint64 sequence = m_editSequence;
+        connect(saver, &QThread::finished, this, [this, saver, sequence]() {
+            if (!saver->hasFailed() && !saver->isCancelled()) {
+                journalSaved(saver->fileName(), sequence);
+                setModified(m_editSequence != sequence);
+            }
+        });
+    }
+
+    saveSheet(saver, index);
+
+    return true;
+}
+
+
+bool DocumentWidget::saveWorkbook(const QUrl &url, const bool copy, QString *errorString)
+{
+    for (int index = 0; index < sheetCount(); ++index) {
+        if (isSheetBusy(index)) {
+            if (errorString)
+                *errorString = tr("A sheet is still being loaded or saved.");
+            return false;
+        }
+    }
+
+    WorkbookSnapshot sheets;
+    if (!snapshot(&sheets, errorString))
+        return false;
+
+    // A rewrite that is still running would replace the file under the
+    // changes; it is dropped, unless it is only left to rename the file
+    if (m_compactor) {
+        if (m_compactor->cancel()) {
+            WorkbookSaver *compactor = m_compactor;
+            m_compactor.clear();
+
+            disconnect(compactor, &QThread::finished, this, &DocumentWidget::finishCompaction);
+            connect(compactor, &QThread::finished, compactor, &QObject::deleteLater);
+            if (compactor->isFinished())
+                compactor->deleteLater();
+        }
+        else {
+            m_compactor->wait();
+            finishCompaction();
+        }
+    }
+
+    const QString fileName = url.toLocalFile();
+
+    // Saving to the file as it was left appends what changed since;
+    // anywhere else, chunks are written as they are held, so that takes
+    // about as long as copying them
+    QSharedPointer<WorkbookFile> file = m_workbook;
+    const bool append = !copy && file && file->canSaveChanges(fileName);
+    if (!append)
+        file.reset(new WorkbookFile);
+    file->setDocumentSettings(documentSettings());
+
+    if (append ? !file->saveChanges(sheets, stringPool()) : !file->save(fileName, sheets, stringPool())) {
+        if (errorString)
+            *errorString = file->errorString();
+        return false;
+    }
+
+    if (copy)
+        return true;
+
+    m_workbook = file;
+    journalSaved(fileName, m_editSequence);
+    setModified(false);
+
+    // Once enough of the file is dead it is rewritten in the background
+    if (file->needsCompaction()) {
+        m_compactor = new WorkbookSaver(sheets, stringPool(), fileName, this);
+        m_compactor->setDocumentSettings(documentSettings());
+        connect(m_compactor, &QThread::finished, this, &DocumentWidget::finishCompaction);
+        m_compactor->start(QThread::LowPriority);
+    }
+
+    return true;
+}
+
+
+void DocumentWidget::finishCompaction()
+{
+    if (!m_compactor || m_compactor->isRunning())
+        return;
+
+    // A failed rewrite leaves the file as it was, and it is tried again
+    // with the next save
+    if (!m_compactor->hasFailed()) {
+        m_workbook = m_compactor->workbookFile();
+        journalSaved(m_compactor->fileName(), m_savedSequence);
+    }
+
+    m_compactor->deleteLater();
+    m_compactor.clear();
+}
+
+
+bool DocumentWidget::recoverJournal(const QString &fileName, QString *errorString)
+{
+    if (!EditJournal::read(fileName, stringPool(), &m_replayRecords, errorString))
+        return false;
+
+    // Replayed edits count as edits of their own and go to the journal of
+    // this session
+    slotReplayJournal();
+
+    return true;
+}
+
+
+void DocumentWidget::slotReplayJournal()
+{
+    // Sheets that are still being loaded take no edits yet
+    for (int index = 0; index < sheetCount(); ++index) {
+        if (isSheetBusy(index))
+            return;
+    }
+
+    const QVector<EditJournal::Record> records = m_replayRecords;
+    m_replayRecords.clear();
+
+    for (const EditJournal::Record &record : records) {
+        switch (record.kind) {
+        case EditJournal::Record::SheetEdited:
+            if (SheetModel *model = sheetModel(record.sheet))
+                model->apply(record.edit);
+            break;
+        case EditJournal::Record::SheetMoved:
+            moveSheet(record.sheet, record.target);
+            break;
+        case EditJournal::Record::SheetClosed:
+            closeSheet(record.sheet);
+            break;
+        }
+    }
+}
+
+
+void DocumentWidget::slotSheetEdited(const int index, const SheetModel::Edit &edit)
+{
+    EditJournal::Record record;
+    record.sheet = index;
+    record.edit = edit;
+    journalEdit(record);
+}
+
+
+void DocumentWidget::slotSheetMoved(const int from, const int to)
+{
+    EditJournal::Record record;
+    record.kind = EditJournal::Record::SheetMoved;
+    record.sheet = from;
+    record.target = to;
+    journalEdit(record);
+}
+
+
+void DocumentWidget::slotSheetClosed(const int index)
+{
+    EditJournal::Record record;
+    record.kind = EditJournal::Record::SheetClosed;
+    record.sheet = index;
+    journalEdit(record);
+}
+
+
+void DocumentWidget::journalEdit(const EditJournal::Record &record)
+{
+    // An append is all an edit costs; the journal syncs in the background
+    ++m_editSequence;
+    if (m_journal)
+        m_journal->append(m_editSequence, record);
+
+    setModified(true);
+}
+
+
+void DocumentWidget::journalSaved(const QString &fileName, const quint64 sequence)
+{
+    m_savedSequence = sequence;
+
+    // Documents are journaled from the moment they have a file
+    if (!m_journal) {
+        m_journal = new EditJournal(stringPool(), this);
+        if (!m_journal->open(fileName)) {
+            delete m_journal;
+            m_journal = nullptr;
+        }
+        return;
+    }
+
+    m_journal->rebase(fileName, sequence);
+}
+
+
 void DocumentWidget::documentCountChanged(const int count)
 {
     slotAddTab(count);
@@ -164,5 +498,8 @@ void DocumentWidget::renameFilename()
         return;
     }
 
+    if (m_journal)
+        m_journal->rebase(newUrl.toLocalFile(), m_savedSequence);
+
     setUrl(newUrl);
 }
@@ -25,10 +25,17 @@
 
 #include "table_document.h"
 
+#include <QPointer>
+#include <QSharedPointer>
 #include <QUrl>
 
+#include "csv_dialect.h"
+#include "edit_journal.h"
+
 class QCloseEvent;
 class QWidget;
+class WorkbookFile;
+class WorkbookSaver;
 
 
 class DocumentWidget : public TableDocument
@@ -47,6 +54,11 @@ public:
     QUrl url() const;
     void initUrl();
 
+    bool load(const QUrl &url, const CsvDialect &dialect, QString *errorString = nullptr);
+    bool loadWorkbook(const QUrl &url, QString *errorString = nullptr);
+    bool save(const QUrl &url, const bool copy, QString *errorString = nullptr);
+    bool recoverJournal(const QString &fileName, QString *errorString = nullptr);
+
 signals:
     void modifiedChanged(const bool modified);
     void urlChanged(const QUrl &url);
@@ -68,8 +80,35 @@ protected:
     void closeEvent(QCloseEvent *event) override;
 
 private:
+    bool saveWorkbook(const QUrl &url, const bool copy, QString *errorString);
+    void finishCompaction();
+
+    void journalEdit(const EditJournal::Record &record);
+    void journalSaved(const QString &fileName, const quint64 sequence);
+
+private slots:
+    void slotSheetEdited(const int index, const SheetModel::Edit &edit);
+    void slotSheetMoved(const int from, const int to);
+    void slotSheetClosed(const int index);
+    void slotReplayJournal();
+
+private:
+
     bool m_modified;
     QUrl m_url;
+    CsvDialect m_dialect;
+
+    // The workbook file as last loaded or saved, and its rewrite if one
+    // is running
+    QSharedPointer<WorkbookFile> m_workbook;
+    QPointer<WorkbookSaver> m_compactor;
+
+    // Edits since the file was opened; those up to the saved sequence are
+    // in the file, all later ones only in the journal
+    EditJournal *m_journal;
+    quint64 m_editSequence;
+    quint64 m_savedSequence;
+    QVector<EditJournal::Record> m_replayRecords;
 };
 
 #endif // DOCUMENT_WIDGET_H
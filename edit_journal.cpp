@@ -0,0 +1,440 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "edit_journal.h"
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLockFile>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QUuid>
+#include <QVariantList>
+
+#include "file_sync.h"
+#include "string_pool.h"
+
+
+namespace {
+
+constexpr quint32 Magic = 0x5154454a; // "QTEJ"
+constexpr quint16 Version = 1;
+
+// Records are framed by their size and a checksum, so that one that was
+// cut short by a crash ends the journal instead of corrupting it
+constexpr int FrameSize = 4 + 2;
+
+
+quint16 recordChecksum(const QByteArray &payload)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    return qChecksum(QByteArrayView(payload));
+#else
+    return qChecksum(payload.constData(), uint(payload.size()));
+#endif
+}
+
+
+QString journalDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + QStringLiteral("/journals");
+}
+
+
+QString lockFileName(const QString &fileName)
+{
+    return fileName + QStringLiteral(".lock");
+}
+
+
+// The state of the saved file that the edits apply to; read where the
+// file was saved, not later on the journal's thread
+QByteArray header(const QString &documentFileName)
+{
+    const QFileInfo fileInfo(documentFileName);
+
+    QByteArray bytes;
+    QDataStream stream(&bytes, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_12);
+    stream << Magic << Version << fileInfo.absoluteFilePath() << fileInfo.size() << fileInfo.lastModified().toMSecsSinceEpoch();
+
+    return bytes;
+}
+
+
+bool readHeader(QDataStream &stream, QString *documentFileName, qint64 *size, qint64 *lastModified)
+{
+    quint32 magic;
+    quint16 version;
+    stream >> magic >> version;
+    if (stream.status() != QDataStream::Ok || magic != Magic || version != Version)
+        return false;
+
+    stream >> *documentFileName >> *size >> *lastModified;
+    return stream.status() == QDataStream::Ok;
+}
+
+
+// Splits off the next complete record; false at the end or at a torn one
+bool nextRecord(const QByteArray &data, int *position, QByteArray *payload, quint64 *sequence)
+{
+    if (data.size() - *position < FrameSize)
+        return false;
+
+    QDataStream frame(data.mid(*position, 4));
+    quint32 size;
+    frame >> size;
+    if (size < sizeof(quint64) || size > quint32(data.size() - *position - FrameSize))
+        return false;
+
+    *payload = data.mid(*position + 4, int(size));
+
+    QDataStream checksum(data.mid(*position + 4 + int(size), 2));
+    quint16 expected;
+    checksum >> expected;
+    if (recordChecksum(*payload) != expected)
+        return false;
+
+    QDataStream stream(*payload);
+    stream >> *sequence;
+
+    *position += int(size) + FrameSize;
+    return true;
+}
+
+
+// A journal with a sound header and no complete record after it has
+// nothing to recover; one that cannot be read is left for recovery to report
+bool isEmpty(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    const QByteArray data = file.readAll();
+
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_5_12);
+    QString documentFileName;
+    qint64 size, lastModified;
+    if (!readHeader(stream, &documentFileName, &size, &lastModified))
+        return false;
+
+    int position = int(stream.device()->pos());
+    QByteArray payload;
+    quint64 sequence;
+    return !nextRecord(data, &position, &payload, &sequence);
+}
+
+
+} // namespace
+
+
+EditJournal::EditJournal(const QSharedPointer<StringPool> &pool, QObject *parent)
+    : QThread(parent)
+    , m_pool{pool}
+    , m_rebaseSequence{0}
+    , m_rebasing{false}
+    , m_stopping{false}
+{
+
+}
+
+
+EditJournal::~EditJournal()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        m_changed.wakeAll();
+    }
+    wait();
+
+    // A document that is closed leaves nothing to recover
+    if (!m_fileName.isEmpty())
+        QFile::remove(m_fileName);
+}
+
+
+QString EditJournal::fileName() const
+{
+    return m_fileName;
+}
+
+
+bool EditJournal::open(const QString &documentFileName)
+{
+    if (!QDir().mkpath(journalDirectory()))
+        return false;
+
+    // Held for as long as the document is open, so that only journals of
+    // sessions that are gone count as orphaned
+    const QString fileName = journalDirectory() + QLatin1Char('/') + QUuid::createUuid().toString(QUuid::WithoutBraces) + QStringLiteral(".journal");
+    m_lock.reset(new QLockFile(lockFileName(fileName)));
+    if (!m_lock->tryLock(0))
+        return false;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly) || file.write(header(documentFileName)) < 0 || !FileSync::sync(file)) {
+        file.remove();
+        m_lock.reset();
+        return false;
+    }
+
+    m_fileName = fileName;
+    start(QThread::LowPriority);
+
+    return true;
+}
+
+
+void EditJournal::append(const quint64 sequence, const Record &record)
+{
+    if (m_fileName.isEmpty())
+        return;
+
+    // Texts are kept as such, since the pool is rebuilt on the next load
+    QVariantList values;
+    values.reserve(record.edit.values.size());
+    for (const CellValue &value : record.edit.values)
+        values.append(value.toVariant(m_pool.data()));
+
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_12);
+    stream << sequence << quint8(record.kind) << qint32(record.sheet) << qint32(record.target)
+           << quint8(record.edit.operation) << qint32(record.edit.row) << qint32(record.edit.column)
+           << qint32(record.edit.rows) << qint32(record.edit.columns) << values;
+
+    QByteArray frame;
+    QDataStream framing(&frame, QIODevice::WriteOnly);
+    framing << quint32(payload.size());
+    framing.writeRawData(payload.constData(), payload.size());
+    framing << recordChecksum(payload);
+
+    QMutexLocker locker(&m_mutex);
+    m_pending.append(frame);
+    m_changed.wakeAll();
+}
+
+
+void EditJournal::rebase(const QString &documentFileName, const quint64 sequence)
+{
+    if (m_fileName.isEmpty())
+        return;
+
+    // Edits up to the sequence are in the saved file now; the rest apply
+    // on top of it
+    const QByteArray rebaseHeader = header(documentFileName);
+
+    QMutexLocker locker(&m_mutex);
+    m_rebaseHeader = rebaseHeader;
+    m_rebaseSequence = sequence;
+    m_rebasing = true;
+    m_changed.wakeAll();
+}
+
+
+void EditJournal::run()
+{
+    // A journal that cannot be written to any more still takes edits, it
+    // just no longer keeps them
+    QFile file(m_fileName);
+    file.open(QIODevice::WriteOnly | QIODevice::Append);
+
+    QMutexLocker locker(&m_mutex);
+    while (true) {
+
+        while (m_pending.isEmpty() && !m_rebasing && !m_stopping)
+            m_changed.wait(&m_mutex);
+        if (m_pending.isEmpty() && !m_rebasing)
+            break;
+
+        // Everything queued so far goes out with a single sync
+        QByteArray pending;
+        pending.swap(m_pending);
+        const bool rebasing = m_rebasing;
+        const QByteArray rebaseHeader = m_rebaseHeader;
+        const quint64 rebaseSequence = m_rebaseSequence;
+        m_rebasing = false;
+        locker.unlock();
+
+        if (!pending.isEmpty() && file.isOpen()) {
+            if (file.write(pending) != pending.size() || !FileSync::sync(file))
+                file.close();
+        }
+
+        if (rebasing) {
+            file.close();
+            if (writeRebased(rebaseHeader, rebaseSequence))
+                file.open(QIODevice::WriteOnly | QIODevice::Append);
+        }
+
+        locker.relock();
+    }
+}
+
+
+bool EditJournal::writeRebased(const QByteArray &documentHeader, const quint64 sequence)
+{
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    const QByteArray data = file.readAll();
+    file.close();
+
+    // Replaced as a whole, so that a crash meanwhile leaves the old one
+    QSaveFile rebased(m_fileName);
+    if (!rebased.open(QIODevice::WriteOnly))
+        return false;
+    rebased.write(documentHeader);
+
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_5_12);
+    QString fileName;
+    qint64 size, lastModified;
+    if (readHeader(stream, &fileName, &size, &lastModified)) {
+
+        int position = int(stream.device()->pos());
+        int start = position;
+        QByteArray payload;
+        quint64 recordSequence;
+        while (nextRecord(data, &position, &payload, &recordSequence)) {
+            if (recordSequence <= sequence)
+                start = position;
+        }
+        rebased.write(data.constData() + start, position - start);
+    }
+
+    return rebased.commit();
+}
+
+
+QStringList EditJournal::orphanedJournals()
+{
+    // A lock that can be taken belongs to a session that is gone; journals
+    // of documents that were not edited since they were saved are dropped
+    QStringList journals;
+
+    const QDir directory(journalDirectory());
+    const QStringList fileNames = directory.entryList({QStringLiteral("*.journal")}, QDir::Files, QDir::Time | QDir::Reversed);
+    for (const QString &fileName : fileNames) {
+        QLockFile lock(lockFileName(directory.filePath(fileName)));
+        if (lock.tryLock(0)) {
+            lock.unlock();
+            if (isEmpty(directory.filePath(fileName)))
+                remove(directory.filePath(fileName));
+            else
+                journals.append(directory.filePath(fileName));
+        }
+    }
+
+    return journals;
+}
+
+
+QString EditJournal::documentFileName(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return QString();
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_12);
+    QString documentFileName;
+    qint64 size, lastModified;
+    if (!readHeader(stream, &documentFileName, &size, &lastModified))
+        return QString();
+
+    return documentFileName;
+}
+
+
+bool EditJournal::read(const QString &fileName, const QSharedPointer<StringPool> &pool, QVector<Record> *records, QString *errorString)
+{
+    const auto fail = [errorString](const QString &error) {
+        if (errorString)
+            *errorString = error;
+        return false;
+    };
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return fail(file.errorString());
+    const QByteArray data = file.readAll();
+
+    QDataStream stream(data);
+    stream.setVersion(QDataStream::Qt_5_12);
+    QString documentFileName;
+    qint64 size, lastModified;
+    if (!readHeader(stream, &documentFileName, &size, &lastModified))
+        return fail(QCoreApplication::translate("EditJournal", "The journal is damaged."));
+
+    // Edits only make sense on the file they were made to
+    const QFileInfo fileInfo(documentFileName);
+    if (!fileInfo.exists() || fileInfo.size() != size || fileInfo.lastModified().toMSecsSinceEpoch() != lastModified)
+        return fail(QCoreApplication::translate("EditJournal", "The document was changed since the journal was written."));
+
+    int position = int(stream.device()->pos());
+    QByteArray payload;
+    quint64 sequence;
+    while (nextRecord(data, &position, &payload, &sequence)) {
+
+        QDataStream record(payload);
+        record.setVersion(QDataStream::Qt_5_12);
+
+        quint8 kind, operation;
+        qint32 sheet, target, row, column, rows, columns;
+        QVariantList values;
+        record >> sequence >> kind >> sheet >> target >> operation >> row >> column >> rows >> columns >> values;
+        if (record.status() != QDataStream::Ok || kind > Record::SheetClosed || operation > SheetModel::Edit::RemoveColumns)
+            break;
+
+        Record entry;
+        entry.kind = Record::Kind(kind);
+        entry.sheet = sheet;
+        entry.target = target;
+        entry.edit.operation = SheetModel::Edit::Operation(operation);
+        entry.edit.row = row;
+        entry.edit.column = column;
+        entry.edit.rows = rows;
+        entry.edit.columns = columns;
+        entry.edit.values.reserve(values.size());
+        for (const QVariant &value : qAsConst(values))
+            entry.edit.values.append(CellValue::fromVariant(value, pool.data()));
+
+        records->append(entry);
+    }
+
+    return true;
+}
+
+
+bool EditJournal::remove(const QString &fileName)
+{
+    QFile::remove(lockFileName(fileName));
+    return QFile::remove(fileName);
+}
@@ -0,0 +1,100 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef EDIT_JOURNAL_H
+#define EDIT_JOURNAL_H
+
+#include <QThread>
+
+#include <QByteArray>
+#include <QMutex>
+#include <QScopedPointer>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVector>
+#include <QWaitCondition>
+
+#include "sheet_model.h"
+
+class QLockFile;
+
+class StringPool;
+
+
+// Every edit of a document, appended to a file of its own as it is made,
+// so that a session that ends without closing its documents can be
+// replayed onto the files they were last saved to. Edits are queued and
+// written by a thread of its own; whatever queues up while the file is
+// being synced goes out with the next sync.
+class EditJournal : public QThread
+{
+    Q_OBJECT
+
+public:
+    struct Record {
+        enum Kind : quint8 {
+            SheetEdited,
+            SheetMoved,
+            SheetClosed
+        };
+
+        Kind kind = SheetEdited;
+        int sheet = 0;
+        int target = 0;
+        SheetModel::Edit edit;
+    };
+
+    explicit EditJournal(const QSharedPointer<StringPool> &pool, QObject *parent = nullptr);
+    ~EditJournal() override;
+
+    QString fileName() const;
+
+    bool open(const QString &documentFileName);
+    void append(const quint64 sequence, const Record &record);
+    void rebase(const QString &documentFileName, const quint64 sequence);
+
+    static QStringList orphanedJournals();
+    static QString documentFileName(const QString &fileName);
+    static bool read(const QString &fileName, const QSharedPointer<StringPool> &pool, QVector<Record> *records, QString *errorString = nullptr);
+    static bool remove(const QString &fileName);
+
+protected:
+    void run() override;
+
+private:
+    bool writeRebased(const QByteArray &documentHeader, const quint64 sequence);
+
+    QSharedPointer<StringPool> m_pool;
+    QString m_fileName;
+    QScopedPointer<QLockFile> m_lock;
+
+    // Shared with the thread
+    QMutex m_mutex;
+    QWaitCondition m_changed;
+    QByteArray m_pending;
+    QByteArray m_rebaseHeader;
+    quint64 m_rebaseSequence;
+    bool m_rebasing;
+    bool m_stopping;
+};
+
+#endif // EDIT_JOURNAL_H
@@ -0,0 +1,340 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "field_parser.h"
+
+#include <QByteArray>
+
+#include <charconv>
+
+#include "string_pool.h"
+
+
+namespace {
+
+bool isDigit(const char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+
+// Reads exactly count digits
+bool readNumber(const char *&position, const char *end, const int count, int *value)
+{
+    if (end - position < count)
+        return false;
+
+    int number = 0;
+    for (int index = 0; index < count; ++index) {
+        if (!isDigit(position[index]))
+            return false;
+        number = number * 10 + (position[index] - '0');
+    }
+
+    position += count;
+    *value = number;
+    return true;
+}
+
+
+// Days since 1970-01-01 in the proleptic Gregorian calendar
+qint64 daysFromCivil(int year, const int month, const int day)
+{
+    year -= month <= 2;
+    const int era = (year >= 0 ? year : year - 399) / 400;
+    const int yearOfEra = year - era * 400;
+    const int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+
+    return qint64(era) * 146097 + dayOfEra - 719468;
+}
+
+
+int daysInMonth(const int year, const int month)
+{
+    static const int days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    if (month == 2 && year % 4 == 0 && (year % 100 != 0 || year % 400 == 0))
+        return 29;
+
+    return days[month - 1];
+}
+
+
+// Numbers with leading zeros are codes rather than quantities, think of
+// postal codes or article numbers, and stay text
+bool hasLeadingZero(const char *data, const int size)
+{
+    const int start = (size && (data[0] == '-' || data[0] == '+')) ? 1 : 0;
+    return size - start > 1 && data[start] == '0' && isDigit(data[start + 1]);
+}
+
+} // namespace
+
+
+//
+// Sampling
+//
+
+void FieldParser::Sample::add(const char *data, const int size)
+{
+    if (size <= 0)
+        return;
+
+    types &= matchingTypes(data, size);
+    ++count;
+}
+
+
+FieldParser::Type FieldParser::Sample::type() const
+{
+    if (!count)
+        return Text;
+
+    // The narrowest type that holds every sampled field
+    for (const Type type : {Integer, Real, Boolean, DateTime}) {
+        if (types & type)
+            return type;
+    }
+
+    return Text;
+}
+
+
+int FieldParser::matchingTypes(const char *data, const int size)
+{
+    int types = Text;
+
+    qint64 integer;
+    double real;
+    bool boolean;
+    qint64 msecs;
+
+    if (toInteger(data, size, &integer))
+        types |= Integer | Real;
+    else if (toReal(data, size, &real))
+        types |= Real;
+    else if (toBoolean(data, size, &boolean))
+        types |= Boolean;
+    else if (toDateTime(data, size, &msecs))
+        types |= DateTime;
+
+    return types;
+}
+
+
+//
+// Conversion
+//
+
+bool FieldParser::toInteger(const char *data, const int size, qint64 *value)
+{
+    if (size <= 0 || hasLeadingZero(data, size))
+        return false;
+
+    // std::from_chars takes no plus sign
+    const char *first = data[0] == '+' ? data + 1 : data;
+    const char *last = data + size;
+    if (first == last || (*first == '-' && first + 1 == last))
+        return false;
+
+    const std::from_chars_result result = std::from_chars(first, last, *value);
+    return result.ec == std::errc() && result.ptr == last;
+}
+
+
+bool FieldParser::toReal(const char *data, const int size, double *value)
+{
+    if (size <= 0 || hasLeadingZero(data, size))
+        return false;
+
+    // Only plain decimal notation; no infinities, NaNs or hexadecimal
+    const char *first = data[0] == '+' ? data + 1 : data;
+    const char *last = data + size;
+    const char *digits = (first < last && *first == '-') ? first + 1 : first;
+    if (digits == last || !(isDigit(*digits) || (*digits == '.' && digits + 1 < last && isDigit(digits[1]))))
+        return false;
+
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    const std::from_chars_result result = std::from_chars(first, last, *value);
+    return result.ec == std::errc() && result.ptr == last;
+#else
+    // Standard libraries without floating point std::from_chars
+    for (const char *position = digits; position < last; ++position) {
+        if (!isDigit(*position) && *position != '.' && *position != 'e' && *position != 'E' && *position != '-' && *position != '+')
+            return false;
+    }
+
+    bool ok;
+    *value = QByteArray::fromRawData(first, int(last - first)).toDouble(&ok);
+    return ok;
+#endif
+}
+
+
+bool FieldParser::toBoolean(const char *data, const int size, bool *value)
+{
+    if (size == 4 && qstrnicmp(data, "true", 4) == 0) {
+        *value = true;
+        return true;
+    }
+    if (size == 5 && qstrnicmp(data, "false", 5) == 0) {
+        *value = false;
+        return true;
+    }
+
+    return false;
+}
+
+
+// ISO 8601 dates, optionally followed by a time after 'T' or a space and
+// a time zone designator; times without a zone are taken as UTC
+bool FieldParser::toDateTime(const char *data, const int size, qint64 *msecs)
+{
+    const char *position = data;
+    const char *end = data + size;
+
+    int year, month, day;
+    if (!readNumber(position, end, 4, &year) || position == end || *position++ != '-'
+            || !readNumber(position, end, 2, &month) || position == end || *position++ != '-'
+            || !readNumber(position, end, 2, &day))
+        return false;
+
+    if (month < 1 || month > 12 || day < 1 || day > daysInMonth(year, month))
+        return false;
+
+    qint64 result = daysFromCivil(year, month, day) * 86400000;
+
+    if (position < end) {
+        if (*position != 'T' && *position != ' ')
+            return false;
+        ++position;
+
+        int hour, minute, second = 0, millisecond = 0;
+        if (!readNumber(position, end, 2, &hour) || position == end || *position++ != ':'
+                || !readNumber(position, end, 2, &minute))
+            return false;
+
+        if (position < end && *position == ':') {
+            ++position;
+            if (!readNumber(position, end, 2, &second))
+                return false;
+
+            if (position < end && (*position == '.' || *position == ',')) {
+                // Fractions beyond milliseconds are dropped
+                ++position;
+                int digits = 0;
+                for (; position < end && isDigit(*position); ++position, ++digits) {
+                    if (digits < 3)
+                        millisecond = millisecond * 10 + (*position - '0');
+                }
+                if (!digits)
+                    return false;
+                for (; digits < 3; ++digits)
+                    millisecond *= 10;
+            }
+        }
+
+        if (hour > 23 || minute > 59 || second > 59)
+            return false;
+
+        result += ((hour * 60 + minute) * 60 + second) * qint64(1000) + millisecond;
+
+        if (position < end && *position == 'Z') {
+            ++position;
+        }
+        else if (position < end && (*position == '+' || *position == '-')) {
+            const int sign = *position++ == '-' ? -1 : 1;
+
+            int offsetHours, offsetMinutes = 0;
+            if (!readNumber(position, end, 2, &offsetHours))
+                return false;
+            if (position < end && *position == ':') {
+                ++position;
+                if (!readNumber(position, end, 2, &offsetMinutes))
+                    return false;
+            }
+            else if (position < end && !readNumber(position, end, 2, &offsetMinutes)) {
+                return false;
+            }
+            if (offsetHours > 23 || offsetMinutes > 59)
+                return false;
+
+            result -= sign * (offsetHours * 60 + offsetMinutes) * qint64(60000);
+        }
+    }
+
+    if (position != end)
+        return false;
+
+    *msecs = result;
+    return true;
+}
+
+
+// Converts a field to the type of its column; fields that do not fit
+// take whatever type they have on their own
+CellValue FieldParser::toValue(const Type type, const char *data, const int size, StringPool *pool)
+{
+    switch (type) {
+    case Integer: {
+        qint64 value;
+        if (toInteger(data, size, &value))
+            return CellValue::fromInteger(value);
+        break;
+    }
+    case Real: {
+        double value;
+        if (toReal(data, size, &value))
+            return CellValue::fromReal(value);
+        break;
+    }
+    case Boolean: {
+        bool value;
+        if (toBoolean(data, size, &value))
+            return CellValue::fromBoolean(value);
+        break;
+    }
+    case DateTime: {
+        qint64 value;
+        if (toDateTime(data, size, &value))
+            return CellValue::fromDateTime(value);
+        break;
+    }
+    case Text:
+        return CellValue::fromUtf8(data, size, pool);
+    }
+
+    return toValue(data, size, pool);
+}
+
+
+CellValue FieldParser::toValue(const char *data, const int size, StringPool *pool)
+{
+    const int types = matchingTypes(data, size);
+    for (const Type type : {Integer, Real, Boolean, DateTime}) {
+        if (types & type)
+            return toValue(type, data, size, pool);
+    }
+
+    // Short text inline, as an edit stores it, so that equal text compares equal
+    return CellValue::fromUtf8(data, size, pool);
+}
@@ -0,0 +1,65 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef FIELD_PARSER_H
+#define FIELD_PARSER_H
+
+#include <QtGlobal>
+
+#include "cell_value.h"
+
+class StringPool;
+
+
+class FieldParser
+{
+public:
+    enum Type : quint8 {
+        Text = 0,
+        Integer = 1,
+        Real = 2,
+        Boolean = 4,
+        DateTime = 8
+    };
+
+    // Narrows the possible type of a column down to what all of its
+    // sampled fields have in common
+    struct Sample {
+        int types = Integer | Real | Boolean | DateTime;
+        int count = 0;
+
+        void add(const char *data, const int size);
+        Type type() const;
+    };
+
+    static int matchingTypes(const char *data, const int size);
+
+    static bool toInteger(const char *data, const int size, qint64 *value);
+    static bool toReal(const char *data, const int size, double *value);
+    static bool toBoolean(const char *data, const int size, bool *value);
+    static bool toDateTime(const char *data, const int size, qint64 *msecs);
+
+    static CellValue toValue(const Type type, const char *data, const int size, StringPool *pool);
+    static CellValue toValue(const char *data, const int size, StringPool *pool);
+};
+
+#endif // FIELD_PARSER_H
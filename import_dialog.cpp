@@ -0,0 +1,149 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "import_dialog.h"
+
+#include <QCheckBox>
+#include <QComboBox>
+#include <QDialogButtonBox>
+#include <QFileInfo>
+#include <QFormLayout>
+#include <QGroupBox>
+#include <QLabel>
+#include <QVBoxLayout>
+
+
+namespace {
+
+void selectData(QComboBox *comboBox, const QVariant &data)
+{
+    const int index = comboBox->findData(data);
+    if (index >= 0)
+        comboBox->setCurrentIndex(index);
+}
+
+} // namespace
+
+
+ImportDialog::ImportDialog(QWidget *parent)
+    : QDialog{parent}
+    , m_textEncoding{TextEncoding::Utf8}
+{
+    setWindowTitle(tr("Import"));
+
+    // Format
+    m_delimiter = new QComboBox;
+    m_delimiter->addItem(tr("Comma"), int(','));
+    m_delimiter->addItem(tr("Semicolon"), int(';'));
+    m_delimiter->addItem(tr("Tab"), int('\t'));
+    m_delimiter->addItem(tr("Pipe"), int('|'));
+
+    m_quote = new QComboBox;
+    m_quote->addItem(tr("Double quote"), int('"'));
+    m_quote->addItem(tr("Single quote"), int('\''));
+
+    m_escape = new QComboBox;
+    m_escape->addItem(tr("Doubled quote"), 0);
+    m_escape->addItem(tr("Backslash"), int('\\'));
+    m_escape->setToolTip(tr("How quotes are written within quoted fields"));
+
+    m_lineEnding = new QComboBox;
+    m_lineEnding->addItem(tr("LF (Unix)"), int(CsvDialect::LF));
+    m_lineEnding->addItem(tr("CRLF (Windows)"), int(CsvDialect::CRLF));
+    m_lineEnding->addItem(tr("CR (Classic Mac OS)"), int(CsvDialect::CR));
+    m_lineEnding->setToolTip(tr("Line ending used when the sheet is saved again"));
+
+    m_encoding = new QLabel;
+
+    auto *formatLayout = new QFormLayout;
+    formatLayout->addRow(tr("Delimiter:"), m_delimiter);
+    formatLayout->addRow(tr("Quote:"), m_quote);
+    formatLayout->addRow(tr("Escape:"), m_escape);
+    formatLayout->addRow(tr("Line ending:"), m_lineEnding);
+    formatLayout->addRow(tr("Encoding:"), m_encoding);
+
+    auto *formatBox = new QGroupBox(tr("Format"));
+    formatBox->setLayout(formatLayout);
+
+    // Header
+    m_headerRow = new QCheckBox(tr("First row contains column titles"));
+
+    // Button box
+    auto *buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttonBox, &QDialogButtonBox::accepted, this, &ImportDialog::accept);
+    connect(buttonBox, &QDialogButtonBox::rejected, this, &ImportDialog::reject);
+
+    // Main layout
+    auto *mainLayout = new QVBoxLayout;
+    mainLayout->addWidget(formatBox);
+    mainLayout->addWidget(m_headerRow);
+    mainLayout->addStretch(1);
+    mainLayout->addWidget(buttonBox);
+    setLayout(mainLayout);
+
+    setDialect(CsvDialect());
+}
+
+
+CsvDialect ImportDialog::dialect() const
+{
+    CsvDialect dialect;
+    dialect.delimiter = char(m_delimiter->currentData().toInt());
+    dialect.quote = char(m_quote->currentData().toInt());
+    dialect.escape = char(m_escape->currentData().toInt());
+    dialect.lineEnding = CsvDialect::LineEnding(m_lineEnding->currentData().toInt());
+    dialect.headerRow = m_headerRow->isChecked();
+    dialect.encoding = m_textEncoding;
+
+    return dialect;
+}
+
+
+void ImportDialog::setDialect(const CsvDialect &dialect)
+{
+    selectData(m_delimiter, int(dialect.delimiter));
+    selectData(m_quote, int(dialect.quote));
+    selectData(m_escape, int(dialect.escape));
+    selectData(m_lineEnding, int(dialect.lineEnding));
+    m_headerRow->setChecked(dialect.headerRow);
+
+    // The encoding is detected again when the file is read
+    m_textEncoding = dialect.encoding;
+    m_encoding->setText(TextEncoding::name(dialect.encoding));
+}
+
+
+bool ImportDialog::getDialect(QWidget *parent, const QString &fileName, CsvDialect *dialect)
+{
+    ImportDialog dialog(parent);
+    dialog.setWindowTitle(tr("Import %1").arg(QFileInfo(fileName).fileName()));
+    if (dialect)
+        dialog.setDialect(*dialect);
+
+    if (dialog.exec() != QDialog::Accepted)
+        return false;
+
+    if (dialect)
+        *dialect = dialog.dialect();
+
+    return true;
+}
@@ -0,0 +1,63 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "memory_usage.h"
+
+#include <QCoreApplication>
+
+
+void MemoryUsage::add(const Category category, const qint64 size)
+{
+    bytes[category] += size;
+}
+
+
+void MemoryUsage::merge(const MemoryUsage &other)
+{
+    for (int category = 0; category < CategoryCount; ++category)
+        bytes[category] += other.bytes[category];
+}
+
+
+qint64 MemoryUsage::total() const
+{
+    qint64 total = 0;
+    for (int category = 0; category < CategoryCount; ++category)
+        total += bytes[category];
+
+    return total;
+}
+
+
+QString MemoryUsage::categoryName(const Category category)
+{
+    switch (category) {
+    case CellStorage:
+        return QCoreApplication::translate("MemoryUsage", "Cell storage");
+    case StringPool:
+        return QCoreApplication::translate("MemoryUsage", "String pool");
+    case Indexes:
+        return QCoreApplication::translate("MemoryUsage", "Indexes");
+    default:
+        return QString();
+    }
+}
@@ -23,6 +23,11 @@
 #include "preferences_dialog.h"
 
 #include <QDialogButtonBox>
+#include <QFormLayout>
+#include <QGroupBox>
+#include <QSettings>
+#include <QSpinBox>
+#include <QThread>
 #include <QVBoxLayout>
 
 
@@ -32,6 +37,23 @@ PreferencesDialog::PreferencesDialog(QWidget *parent)
     setMinimumSize(800, 600);
     setWindowTitle(tr("Preferences"));
 
+    QSettings settings;
+
+    // Import
+    auto *threads = new QSpinBox;
+    threads->setRange(0, 4 * QThread::idealThreadCount());
+    threads->setSpecialValueText(tr("Automatic"));
+    threads->setValue(settings.value(QStringLiteral("Import/Threads"), 0).toInt());
+    threads->setToolTip(tr("Number of threads used to read large files"));
+    connect(threads, qOverload<int>(&QSpinBox::valueChanged), this, [](const int value) {
+        QSettings().setValue(QStringLiteral("Import/Threads"), value);
+    });
+
+    auto *importLayout = new QFormLayout;
+    importLayout->addRow(tr("Worker threads:"), threads);
+
+    auto *importBox = new QGroupBox(tr("Import"));
+    importBox->setLayout(importLayout);
 
     // Button box
     auto *buttonBox = new QDialogButtonBox(QDialogButtonBox::Close);
@@ -39,6 +61,7 @@ PreferencesDialog::PreferencesDialog(QWidget *parent)
 
     // Main layout
     auto *mainLayout = new QVBoxLayout;
+    mainLayout->addWidget(importBox);
     mainLayout->addStretch(1);
     mainLayout->addWidget(buttonBox);
     setLayout(mainLayout);
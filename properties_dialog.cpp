@@ -26,12 +26,15 @@
 #include <QTabWidget>
 #include <QVBoxLayout>
 
+#include "document_widget.h"
 #include "properties_pages.h"
 
 
-PropertiesDialog::PropertiesDialog(const QUrl &url, QWidget *parent)
+PropertiesDialog::PropertiesDialog(DocumentWidget *document, QWidget *parent)
     : QDialog(parent)
 {
+    const QUrl url = document->url();
+
     setMinimumSize(640, 480);
     setWindowTitle(tr("Properties for %1").arg(url.fileName()));
 
@@ -39,11 +42,13 @@ PropertiesDialog::PropertiesDialog(const QUrl &url, QWidget *parent)
     //
     // Content
 
-    auto *pageGeneral = new PropertiesPageGeneral(url);
+    auto *pageGeneral = new PropertiesPageGeneral(document);
+    auto *pageColumns = new PropertiesPageColumns(document);
     auto *pagePermissions = new PropertiesPagePermissions(url);
 
     auto *tabBox = new QTabWidget;
     tabBox->addTab(pageGeneral, pageGeneral->title());
+    tabBox->addTab(pageColumns, pageColumns->title());
     tabBox->addTab(pagePermissions, pagePermissions->title());
 
 
@@ -25,7 +25,7 @@
 
 #include <QDialog>
 
-#include <QUrl>
+class DocumentWidget;
 
 
 class PropertiesDialog : public QDialog
@@ -33,7 +33,7 @@ class PropertiesDialog : public QDialog
     Q_OBJECT
 
 public:
-    explicit PropertiesDialog(const QUrl &url, QWidget *parent = nullptr);
+    explicit PropertiesDialog(DocumentWidget *document, QWidget *parent = nullptr);
 };
 
 #endif // PROPERTIES_DIALOG_H
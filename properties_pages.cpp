@@ -22,17 +22,129 @@
 
 #include "properties_pages.h"
 
+#include <QComboBox>
+#include <QFormLayout>
+#include <QGroupBox>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLocale>
+#include <QTimer>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+#include "abstract_sheet.h"
+#include "columnar_sheet.h"
+#include "document_widget.h"
+#include "sheet_model.h"
+
+
+namespace {
+
+QString typeName(const SheetChunk::Type type)
+{
+    switch (type) {
+    case SheetChunk::Integer:
+        return PropertiesPageColumns::tr("Integer");
+    case SheetChunk::Real:
+        return PropertiesPageColumns::tr("Number");
+    case SheetChunk::Boolean:
+        return PropertiesPageColumns::tr("Boolean");
+    case SheetChunk::DateTime:
+        return PropertiesPageColumns::tr("Date and time");
+    case SheetChunk::String:
+        return PropertiesPageColumns::tr("Text");
+    case SheetChunk::Mixed:
+        return PropertiesPageColumns::tr("Mixed");
+    default:
+        return PropertiesPageColumns::tr("Empty");
+    }
+}
+
+
+// Bounds are shown the way cells of the column show their values
+QString boundText(const SheetChunk::Type type, const double bound)
+{
+    switch (type) {
+    case SheetChunk::Integer:
+        return CellValue::fromInteger(qint64(bound)).toString(nullptr);
+    case SheetChunk::Boolean:
+        return CellValue::fromBoolean(bound != 0.0).toString(nullptr);
+    case SheetChunk::DateTime:
+        return CellValue::fromDateTime(qint64(bound)).toString(nullptr);
+    default:
+        return CellValue::fromReal(bound).toString(nullptr);
+    }
+}
+
+} // namespace
+
 
 //
 //
 // Properties page: General
 //
 
-PropertiesPageGeneral::PropertiesPageGeneral(const QUrl &url, QWidget *parent)
+PropertiesPageGeneral::PropertiesPageGeneral(DocumentWidget *document, QWidget *parent)
     : QWidget(parent)
+    , m_document{document}
+    , m_sheets{new QLabel}
+    , m_cells{new QLabel}
+    , m_memoryTotal{new QLabel}
 {
-    Q_UNUSED(url)
+    const QUrl url = document->url();
 
+    // Document
+    auto *documentLayout = new QFormLayout;
+    documentLayout->addRow(tr("Name:"), new QLabel(url.isEmpty() ? tr("Untitled") : url.fileName()));
+    documentLayout->addRow(tr("Location:"), new QLabel(url.adjusted(QUrl::RemoveFilename).toDisplayString(QUrl::PreferLocalFile)));
+    documentLayout->addRow(tr("Sheets:"), m_sheets);
+    documentLayout->addRow(tr("Cells:"), m_cells);
+
+    // Memory
+    auto *memoryLayout = new QFormLayout;
+    for (int category = 0; category < MemoryUsage::CategoryCount; ++category) {
+        m_memory[category] = new QLabel;
+        memoryLayout->addRow(tr("%1:").arg(MemoryUsage::categoryName(MemoryUsage::Category(category))), m_memory[category]);
+    }
+    memoryLayout->addRow(tr("Total:"), m_memoryTotal);
+
+    auto *memoryBox = new QGroupBox(tr("Memory"));
+    memoryBox->setLayout(memoryLayout);
+
+    // The counters are cheap to read, so the page simply polls them
+    auto *timer = new QTimer(this);
+    connect(timer, &QTimer::timeout, this, &PropertiesPageGeneral::refresh);
+    timer->start(1000);
+    refresh();
+
+    // Main layout
+    auto *mainLayout = new QVBoxLayout;
+    mainLayout->addLayout(documentLayout);
+    mainLayout->addWidget(memoryBox);
+    mainLayout->addStretch(1);
+    setLayout(mainLayout);
+}
+
+
+void PropertiesPageGeneral::refresh()
+{
+    if (!m_document)
+        return;
+
+    qint64 cells = 0;
+    for (int index = 0; index < m_document->sheetCount(); ++index) {
+        if (const AbstractSheet *sheet = m_document->sheet(index))
+            cells += sheet->cellCount();
+    }
+
+    const QLocale locale;
+    m_sheets->setText(locale.toString(m_document->sheetCount()));
+    m_cells->setText(locale.toString(cells));
+
+    const MemoryUsage usage = m_document->memoryUsage();
+    for (int category = 0; category < MemoryUsage::CategoryCount; ++category)
+        m_memory[category]->setText(locale.formattedDataSize(usage.bytes[category]));
+    m_memoryTotal->setText(QStringLiteral("<strong>%1</strong>").arg(locale.formattedDataSize(usage.total())));
 }
 
 
@@ -42,6 +154,91 @@ QString PropertiesPageGeneral::title() const
 }
 
 
+//
+//
+// Properties page: Columns
+//
+
+PropertiesPageColumns::PropertiesPageColumns(DocumentWidget *document, QWidget *parent)
+    : QWidget(parent)
+    , m_document{document}
+    , m_sheets{new QComboBox}
+    , m_columns{new QTreeWidget}
+{
+    for (int index = 0; index < document->sheetCount(); ++index)
+        m_sheets->addItem(document->sheetName(index));
+
+    auto *sheetLayout = new QFormLayout;
+    sheetLayout->addRow(tr("Sheet:"), m_sheets);
+
+    m_columns->setRootIsDecorated(false);
+    m_columns->setHeaderLabels({tr("Column"), tr("Type"), tr("Values"), tr("Empty"), tr("Minimum"), tr("Maximum"), tr("Distinct"), tr("Order")});
+    m_columns->header()->setSectionResizeMode(QHeaderView::ResizeToContents);
+
+    connect(m_sheets, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &PropertiesPageColumns::refresh);
+    refresh();
+
+    // Main layout
+    auto *mainLayout = new QVBoxLayout;
+    mainLayout->addLayout(sheetLayout);
+    mainLayout->addWidget(m_columns);
+    setLayout(mainLayout);
+}
+
+
+void PropertiesPageColumns::refresh()
+{
+    m_columns->clear();
+
+    const int index = m_sheets->currentIndex();
+    if (!m_document || index < 0 || index >= m_document->sheetCount() || m_document->isSheetBusy(index))
+        return;
+
+    // Summaries come from the chunk statistics, which sheets of workbook
+    // files bring along, so that nothing is scanned here
+    const QSharedPointer<const AbstractSheet> sheet = m_document->snapshotSheet(index);
+    const auto *columnarSheet = dynamic_cast<const ColumnarSheet *>(sheet.data());
+    if (!columnarSheet)
+        return;
+
+    const QLocale locale;
+    for (int column = 0; column < columnarSheet->columnCount(); ++column) {
+
+        const ColumnarSheet::ColumnSummary summary = columnarSheet->summary(column);
+        const ChunkStatistics &statistics = summary.statistics;
+        const QString title = columnarSheet->columnTitle(column);
+
+        QString order;
+        if (summary.count > 1 && statistics.flags & ChunkStatistics::Ascending)
+            order = tr("Ascending");
+        else if (summary.count > 1 && statistics.flags & ChunkStatistics::Descending)
+            order = tr("Descending");
+
+        auto *item = new QTreeWidgetItem(m_columns);
+        item->setText(0, title.isEmpty() ? SheetModel::columnName(column) : title);
+        item->setText(1, typeName(summary.type));
+        item->setText(2, locale.toString(summary.count));
+        item->setText(3, locale.toString(summary.emptyCount));
+        if (statistics.hasBounds()) {
+            item->setText(4, boundText(summary.type, statistics.minimum));
+            item->setText(5, boundText(summary.type, statistics.maximum));
+        }
+        if (summary.count)
+            item->setText(6, tr("about %1").arg(locale.toString(qMin(qRound64(statistics.distinctCount()), summary.count))));
+        item->setText(7, order);
+
+        for (int section = 2; section < m_columns->columnCount(); ++section)
+            item->setTextAlignment(section, Qt::AlignRight | Qt::AlignVCenter);
+    }
+}
+
+
+QString PropertiesPageColumns::title() const
+{
+    return tr("Columns");
+}
+
+
 //
 //
 // Properties page: Permissions
@@ -25,8 +25,17 @@
 
 #include <QWidget>
 
+#include <QPointer>
 #include <QUrl>
 
+#include "memory_usage.h"
+
+class QComboBox;
+class QLabel;
+class QTreeWidget;
+
+class DocumentWidget;
+
 
 //
 //
@@ -38,9 +47,45 @@ class PropertiesPageGeneral : public QWidget
     Q_OBJECT
 
 public:
-    explicit PropertiesPageGeneral(const QUrl &url, QWidget *parent = nullptr);
+    explicit PropertiesPageGeneral(DocumentWidget *document, QWidget *parent = nullptr);
+
+    QString title() const;
+
+private slots:
+    void refresh();
+
+private:
+    QPointer<DocumentWidget> m_document;
+
+    QLabel *m_sheets;
+    QLabel *m_cells;
+    QLabel *m_memory[MemoryUsage::CategoryCount];
+    QLabel *m_memoryTotal;
+};
+
+
+//
+//
+// Properties page: Columns
+//
+
+class PropertiesPageColumns : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit PropertiesPageColumns(DocumentWidget *document, QWidget *parent = nullptr);
 
     QString title() const;
+
+private slots:
+    void refresh();
+
+private:
+    QPointer<DocumentWidget> m_document;
+
+    QComboBox *m_sheets;
+    QTreeWidget *m_columns;
 };
 
 
@@ -32,42 +32,98 @@ CONFIG += c++17
 
 SOURCES += \
     about_dialog.cpp \
+    abstract_sheet.cpp \
     application_window.cpp \
+    arena.cpp \
+    cell_value.cpp \
     colophon_dialog.cpp \
     colophon_pages.cpp \
+    columnar_sheet.cpp \
     confirmation_dialog.cpp \
+    csv_dialect.cpp \
+    csv_index.cpp \
+    csv_reader.cpp \
+    csv_scanner.cpp \
+    csv_writer.cpp \
+    decompressor.cpp \
     dialog_header_box.cpp \
     document_manager.cpp \
     document_widget.cpp \
     document_window.cpp \
+    edit_journal.cpp \
+    field_parser.cpp \
+    file_sync.cpp \
+    import_dialog.cpp \
     main.cpp \
+    memory_usage.cpp \
     preferences_dialog.cpp \
     properties_dialog.cpp \
     properties_pages.cpp \
     recent_document_list.cpp \
     rename_dialog.cpp \
-    table_document.cpp
+    sheet_axis.cpp \
+    sheet_chunk.cpp \
+    sheet_loader.cpp \
+    sheet_model.cpp \
+    sheet_saver.cpp \
+    sheet_widget.cpp \
+    sparse_sheet.cpp \
+    string_pool.cpp \
+    table_document.cpp \
+    text_encoding.cpp \
+    workbook_file.cpp \
+    workbook_saver.cpp \
+    workbook_snapshot.cpp
 
 HEADERS += \
     about_dialog.h \
+    abstract_sheet.h \
     application_window.h \
+    arena.h \
+    cell_value.h \
     colophon_dialog.h \
     colophon_pages.h \
+    columnar_sheet.h \
     confirmation_dialog.h \
+    csv_dialect.h \
+    csv_index.h \
+    csv_reader.h \
+    csv_scanner.h \
+    csv_writer.h \
+    decompressor.h \
     dialog_header_box.h \
     document_manager.h \
     document_widget.h \
     document_window.h \
+    edit_journal.h \
+    field_parser.h \
+    file_sync.h \
+    import_dialog.h \
+    memory_usage.h \
     preferences_dialog.h \
     properties_dialog.h \
     properties_pages.h \
     recent_document_list.h \
     rename_dialog.h \
-    table_document.h
+    sheet_axis.h \
+    sheet_chunk.h \
+    sheet_loader.h \
+    sheet_model.h \
+    sheet_saver.h \
+    sheet_widget.h \
+    sparse_sheet.h \
+    string_pool.h \
+    table_document.h \
+    text_encoding.h \
+    workbook_file.h \
+    workbook_saver.h \
+    workbook_snapshot.h
 
 RESOURCES += \
     icons.qrc
 
+include(decompressor.pri)
+
 CONFIG += lrelease
 
 # Default rules for deployment.
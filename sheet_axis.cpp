@@ -0,0 +1,350 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "sheet_axis.h"
+
+#include <algorithm>
+
+
+//
+// The axis is an implicit treap of runs: every node maps a stretch of
+// consecutive logical indices onto consecutive storage slots, and keeps
+// the number of indices in its subtree, so that lookups, insertions and
+// removals cost O(log n) in the number of runs.
+//
+
+SheetAxis::SheetAxis()
+    : m_root{-1}
+    , m_physicalCount{0}
+    , m_seed{0x9e3779b9}
+{
+
+}
+
+
+int SheetAxis::count() const
+{
+    return total(m_root);
+}
+
+
+int SheetAxis::physicalCount() const
+{
+    return m_physicalCount;
+}
+
+
+qint64 SheetAxis::byteSize() const
+{
+    return m_nodes.capacity() * qint64(sizeof(Node)) + m_freeNodes.capacity() * qint64(sizeof(int));
+}
+
+
+bool SheetAxis::isIdentity() const
+{
+    if (m_root < 0)
+        return true;
+
+    const Node &root = m_nodes.at(m_root);
+    return root.left < 0 && root.right < 0 && root.physical == 0;
+}
+
+
+int SheetAxis::map(const int logical) const
+{
+    int node = m_root;
+    int position = logical;
+
+    while (node >= 0) {
+
+        const Node &n = m_nodes.at(node);
+        const int leftTotal = total(n.left);
+
+        if (position < leftTotal) {
+            node = n.left;
+        }
+        else if (position < leftTotal + n.length) {
+            return n.physical + position - leftTotal;
+        }
+        else {
+            position -= leftTotal + n.length;
+            node = n.right;
+        }
+    }
+
+    return -1;
+}
+
+
+void SheetAxis::forEachRun(const int position, const int count, const RunVisitor &visitor) const
+{
+    if (count > 0)
+        visit(m_root, 0, position, position + count, visitor);
+}
+
+
+void SheetAxis::visit(const int node, int offset, const int first, const int last, const RunVisitor &visitor) const
+{
+    if (node < 0 || offset >= last || offset + total(node) <= first)
+        return;
+
+    const Node &n = m_nodes.at(node);
+
+    visit(n.left, offset, first, last, visitor);
+    offset += total(n.left);
+
+    // Clip the run to the requested range
+    const int begin = qMax(first, offset);
+    const int end = qMin(last, offset + n.length);
+    if (begin < end)
+        visitor({begin, n.physical + begin - offset, end - begin});
+
+    visit(n.right, offset + n.length, first, last, visitor);
+}
+
+
+//
+// Modifications
+//
+
+void SheetAxis::extend(const int count)
+{
+    const int missing = count - this->count();
+    if (missing <= 0)
+        return;
+
+    if (!extendLastRun(m_physicalCount, missing))
+        insert(this->count(), missing);
+}
+
+
+void SheetAxis::append(const int physical, const int length)
+{
+    if (length <= 0 || extendLastRun(physical, length))
+        return;
+
+    // Maps the next logical positions onto storage that is already filled
+    m_root = merge(m_root, createNode(physical, length));
+    m_physicalCount = qMax(m_physicalCount, physical + length);
+}
+
+
+void SheetAxis::insert(const int position, const int count)
+{
+    if (count <= 0)
+        return;
+
+    const int node = createNode(m_physicalCount, count);
+    m_physicalCount += count;
+
+    int left, right;
+    split(m_root, position, left, right);
+    m_root = merge(merge(left, node), right);
+}
+
+
+void SheetAxis::remove(const int position, const int count, const RunVisitor &visitor)
+{
+    if (count <= 0)
+        return;
+
+    int left, middle, right;
+    split(m_root, position, left, right);
+    split(right, count, middle, right);
+
+    int logical = position;
+    releaseTree(middle, logical, visitor);
+
+    m_root = merge(left, right);
+}
+
+
+//
+// Treap
+//
+
+bool SheetAxis::extendLastRun(const int physical, const int length)
+{
+    // Storage right behind the last run and the last storage slot just
+    // lengthens that run, which keeps a sheet filled in order an identity
+    int node = m_root;
+    while (node >= 0 && m_nodes.at(node).right >= 0)
+        node = m_nodes.at(node).right;
+
+    if (node < 0 || physical != m_physicalCount || m_nodes.at(node).physical + m_nodes.at(node).length != physical)
+        return false;
+
+    m_nodes[node].length += length;
+    m_physicalCount += length;
+
+    // Fix the subtree totals along the right spine
+    QVector<int> spine;
+    for (int n = m_root; n >= 0; n = m_nodes.at(n).right)
+        spine.append(n);
+    for (int i = spine.size() - 1; i >= 0; --i)
+        update(spine.at(i));
+
+    return true;
+}
+
+
+int SheetAxis::createNode(const int physical, const int length)
+{
+    // Xorshift priorities keep the tree balanced in expectation
+    m_seed ^= m_seed << 13;
+    m_seed ^= m_seed >> 17;
+    m_seed ^= m_seed << 5;
+
+    const Node node = {-1, -1, m_seed, physical, length, length};
+
+    if (!m_freeNodes.isEmpty()) {
+        const int index = m_freeNodes.takeLast();
+        m_nodes[index] = node;
+        return index;
+    }
+
+    m_nodes.append(node);
+    return m_nodes.size() - 1;
+}
+
+
+void SheetAxis::releaseTree(const int node, int &logical, const RunVisitor &visitor)
+{
+    if (node < 0)
+        return;
+
+    const Node n = m_nodes.at(node);
+
+    releaseTree(n.left, logical, visitor);
+    if (visitor)
+        visitor({logical, n.physical, n.length});
+    logical += n.length;
+    releaseTree(n.right, logical, visitor);
+
+    m_freeNodes.append(node);
+}
+
+
+int SheetAxis::total(const int node) const
+{
+    return node >= 0 ? m_nodes.at(node).total : 0;
+}
+
+
+void SheetAxis::update(const int node)
+{
+    Node &n = m_nodes[node];
+    n.total = total(n.left) + n.length + total(n.right);
+}
+
+
+void SheetAxis::split(const int node, const int position, int &left, int &right)
+{
+    if (node < 0) {
+        left = right = -1;
+        return;
+    }
+
+    const int leftTotal = total(m_nodes.at(node).left);
+    const int length = m_nodes.at(node).length;
+
+    if (position <= leftTotal) {
+        int child;
+        split(m_nodes.at(node).left, position, left, child);
+        m_nodes[node].left = child;
+        update(node);
+        right = node;
+    }
+    else if (position >= leftTotal + length) {
+        int child;
+        split(m_nodes.at(node).right, position - leftTotal - length, child, right);
+        m_nodes[node].right = child;
+        update(node);
+        left = node;
+    }
+    else {
+        // The position falls inside this run; cut it in two
+        const int offset = position - leftTotal;
+        const int tail = createNode(m_nodes.at(node).physical + offset, length - offset);
+
+        const int child = m_nodes.at(node).right;
+        m_nodes[node].length = offset;
+        m_nodes[node].right = -1;
+        update(node);
+
+        left = node;
+        right = merge(tail, child);
+    }
+}
+
+
+int SheetAxis::merge(const int left, const int right)
+{
+    if (left < 0)
+        return right;
+    if (right < 0)
+        return left;
+
+    if (m_nodes.at(left).priority > m_nodes.at(right).priority) {
+        const int child = merge(m_nodes.at(left).right, right);
+        m_nodes[left].right = child;
+        update(left);
+        return left;
+    }
+
+    const int child = merge(left, m_nodes.at(right).left);
+    m_nodes[right].left = child;
+    update(right);
+    return right;
+}
+
+
+//
+// Inverse mapping
+//
+
+SheetAxis::Inverse::Inverse(const SheetAxis &axis)
+{
+    axis.forEachRun(0, axis.count(), [this](const Run &run) {
+        m_runs.append(run);
+    });
+
+    std::sort(m_runs.begin(), m_runs.end(), [](const Run &a, const Run &b) {
+        return a.physical < b.physical;
+    });
+}
+
+
+int SheetAxis::Inverse::map(const int physical) const
+{
+    auto it = std::upper_bound(m_runs.cbegin(), m_runs.cend(), physical, [](const int value, const Run &run) {
+        return value < run.physical;
+    });
+    if (it == m_runs.cbegin())
+        return -1;
+
+    --it;
+    if (physical >= it->physical + it->length)
+        return -1;
+
+    return it->logical + physical - it->physical;
+}
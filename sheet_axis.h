@@ -0,0 +1,96 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SHEET_AXIS_H
+#define SHEET_AXIS_H
+
+#include <QVector>
+#include <QtGlobal>
+
+#include <functional>
+
+
+class SheetAxis
+{
+public:
+    struct Run {
+        int logical;
+        int physical;
+        int length;
+    };
+
+    using RunVisitor = std::function<void(const Run &run)>;
+
+    class Inverse
+    {
+    public:
+        explicit Inverse(const SheetAxis &axis);
+
+        int map(const int physical) const;
+
+    private:
+        QVector<Run> m_runs;
+    };
+
+    SheetAxis();
+
+    int count() const;
+    int physicalCount() const;
+    bool isIdentity() const;
+    qint64 byteSize() const;
+
+    int map(const int logical) const;
+    void forEachRun(const int position, const int count, const RunVisitor &visitor) const;
+
+    void extend(const int count);
+    void append(const int physical, const int length);
+    void insert(const int position, const int count);
+    void remove(const int position, const int count, const RunVisitor &visitor);
+
+private:
+    struct Node {
+        int left;
+        int right;
+        quint32 priority;
+        int physical;
+        int length;
+        int total;
+    };
+
+    bool extendLastRun(const int physical, const int length);
+    int createNode(const int physical, const int length);
+    void releaseTree(const int node, int &logical, const RunVisitor &visitor);
+    void update(const int node);
+    int total(const int node) const;
+
+    void split(const int node, const int position, int &left, int &right);
+    int merge(const int left, const int right);
+    void visit(const int node, int offset, const int first, const int last, const RunVisitor &visitor) const;
+
+    QVector<Node> m_nodes;
+    QVector<int> m_freeNodes;
+    int m_root;
+    int m_physicalCount;
+    quint32 m_seed;
+};
+
+#endif // SHEET_AXIS_H
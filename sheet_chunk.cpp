@@ -0,0 +1,1427 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "sheet_chunk.h"
+
+#include <QVector>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+
+//
+// Aggregate
+//
+
+void ChunkAggregate::add(const double value, const qint64 times)
+{
+    if (times <= 0)
+        return;
+
+    if (!count) {
+        minimum = value;
+        maximum = value;
+    }
+    else {
+        minimum = qMin(minimum, value);
+        maximum = qMax(maximum, value);
+    }
+
+    count += times;
+    sum += value * double(times);
+}
+
+
+void ChunkAggregate::merge(const ChunkAggregate &other)
+{
+    if (!other.count)
+        return;
+
+    if (!count) {
+        *this = other;
+        return;
+    }
+
+    count += other.count;
+    sum += other.sum;
+    minimum = qMin(minimum, other.minimum);
+    maximum = qMax(maximum, other.maximum);
+}
+
+
+//
+// Statistics
+//
+
+ChunkStatistics::ChunkStatistics()
+    : minimum{std::numeric_limits<double>::infinity()}
+    , maximum{-std::numeric_limits<double>::infinity()}
+    , flags{Ascending | Descending | Exact}
+    , sketch{}
+{
+
+}
+
+
+bool ChunkStatistics::hasBounds() const
+{
+    return minimum <= maximum;
+}
+
+
+bool ChunkStatistics::overlaps(const double low, const double high) const
+{
+    return hasBounds() && minimum <= high && maximum >= low;
+}
+
+
+bool ChunkStatistics::isWithin(const double low, const double high) const
+{
+    return hasBounds() && minimum >= low && maximum <= high;
+}
+
+
+bool ChunkStatistics::isExact() const
+{
+    return flags & Exact;
+}
+
+
+double ChunkStatistics::distinctCount() const
+{
+    double sum = 0.0;
+    int zeros = 0;
+    for (const quint8 rank : sketch) {
+        sum += std::ldexp(1.0, -rank);
+        if (!rank)
+            ++zeros;
+    }
+
+    // Small counts are better told by the registers that are still empty
+    const double registers = SketchSize;
+    const double estimate = 0.709 * registers * registers / sum;
+    if (estimate <= 2.5 * registers && zeros)
+        return registers * std::log(registers / zeros);
+
+    return estimate;
+}
+
+
+void ChunkStatistics::widen(const double value)
+{
+    if (std::isnan(value))
+        return;
+
+    minimum = qMin(minimum, value);
+    maximum = qMax(maximum, value);
+}
+
+
+void ChunkStatistics::addHash(const quint64 hash)
+{
+    const quint64 rest = hash / SketchSize;
+    const auto rank = quint8(rest ? qCountTrailingZeroBits(rest) + 1 : 59);
+
+    quint8 &target = sketch[hash % SketchSize];
+    target = qMax(target, rank);
+}
+
+
+// Values that are not a number break either order
+void ChunkStatistics::checkOrder(const double first, const double second)
+{
+    if (!(first <= second))
+        flags &= ~Ascending;
+    if (!(first >= second))
+        flags &= ~Descending;
+}
+
+
+// The rows of the other statistics follow the rows of these
+void ChunkStatistics::merge(const ChunkStatistics &next)
+{
+    if (hasBounds() && next.hasBounds()) {
+        if (maximum > next.minimum)
+            flags &= ~Ascending;
+        if (minimum < next.maximum)
+            flags &= ~Descending;
+    }
+
+    flags &= next.flags;
+    minimum = qMin(minimum, next.minimum);
+    maximum = qMax(maximum, next.maximum);
+
+    for (int index = 0; index < SketchSize; ++index)
+        sketch[index] = qMax(sketch[index], next.sketch[index]);
+}
+
+
+//
+// Chunk
+//
+
+SheetChunk::SheetChunk(const Type type)
+    : m_type{type}
+    , m_encoding{Plain}
+    , m_codeWidth{0}
+    , m_encodingChecked{false}
+    , m_count{0}
+    , m_capacity{0}
+    , m_entries{0}
+    , m_lastRow{-1}
+{
+
+}
+
+
+qint64 SheetChunk::payloadSize(const Type type, const int rows)
+{
+    if (type == Boolean)
+        return qint64(rows) / 8;
+    if (type == Mixed)
+        return qint64(rows) * qint64(sizeof(CellValue));
+
+    return qint64(rows) * valueWidth(type);
+}
+
+
+int SheetChunk::valueWidth(const Type type)
+{
+    switch (type) {
+    case Integer:
+    case Real:
+    case DateTime:
+        return 8;
+    case String:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+
+SheetChunk::Type SheetChunk::typeOf(const CellValue &value)
+{
+    switch (value.type()) {
+    case CellValue::Empty:
+        return Empty;
+    case CellValue::Integer:
+        return Integer;
+    case CellValue::Real:
+        return Real;
+    case CellValue::Boolean:
+        return Boolean;
+    case CellValue::DateTime:
+        return DateTime;
+    case CellValue::InlineText:
+    case CellValue::PooledText:
+        return String;
+    default:
+        return Mixed;
+    }
+}
+
+
+quint64 SheetChunk::hashBits(const Type type, const quint64 bits)
+{
+    // Finalizer of splitmix64; the type keeps 1 and true apart
+    quint64 hash = bits + quint64(type) * Q_UINT64_C(0x9e3779b97f4a7c15);
+    hash = (hash ^ (hash >> 30)) * Q_UINT64_C(0xbf58476d1ce4e5b9);
+    hash = (hash ^ (hash >> 27)) * Q_UINT64_C(0x94d049bb133111eb);
+
+    return hash ^ (hash >> 31);
+}
+
+
+// Hashes as the chunk of the value's own type would, so that sketches of
+// mixed and typed chunks can be merged
+quint64 SheetChunk::hashValue(const CellValue &value)
+{
+    const Type type = typeOf(value);
+
+    quint64 bits;
+    switch (value.type()) {
+    case CellValue::Integer:
+        bits = quint64(value.integer());
+        break;
+    case CellValue::Real: {
+        const double real = value.real();
+        std::memcpy(&bits, &real, sizeof(bits));
+        break;
+    }
+    case CellValue::Boolean:
+        bits = value.boolean();
+        break;
+    case CellValue::DateTime:
+        bits = quint64(value.dateTime());
+        break;
+    case CellValue::PooledText:
+        bits = value.stringId();
+        break;
+    default:
+        bits = qHash(value);
+        break;
+    }
+
+    return hashBits(type, bits);
+}
+
+
+// Numbers, booleans and dates have a place on one scale; dates by their
+// milliseconds
+bool SheetChunk::toOrdinal(const CellValue &value, double *ordinal)
+{
+    switch (value.type()) {
+    case CellValue::Integer:
+    case CellValue::Real:
+    case CellValue::Boolean:
+        *ordinal = value.toReal();
+        return true;
+    case CellValue::DateTime:
+        *ordinal = double(value.dateTime());
+        return true;
+    default:
+        return false;
+    }
+}
+
+
+//
+// Properties
+//
+
+SheetChunk::Type SheetChunk::type() const
+{
+    return m_type;
+}
+
+
+SheetChunk::Encoding SheetChunk::encoding() const
+{
+    return m_encoding;
+}
+
+
+int SheetChunk::count() const
+{
+    return m_count;
+}
+
+
+bool SheetChunk::isEmpty() const
+{
+    return !m_count;
+}
+
+
+int SheetChunk::capacity() const
+{
+    return m_capacity;
+}
+
+
+qint64 SheetChunk::byteSize() const
+{
+    return m_values.size() + m_dictionary.size() + m_validity.size();
+}
+
+
+//
+// Values
+//
+
+bool SheetChunk::hasValue(const int row) const
+{
+    if (row >= m_capacity)
+        return false;
+
+    return validity()[row >> 6] & (Q_UINT64_C(1) << (row & 63));
+}
+
+
+qint64 SheetChunk::integer(const int row) const
+{
+    return qint64(bits(row));
+}
+
+
+double SheetChunk::real(const int row) const
+{
+    return toDouble(bits(row));
+}
+
+
+bool SheetChunk::boolean(const int row) const
+{
+    return booleans()[row >> 6] & (Q_UINT64_C(1) << (row & 63));
+}
+
+
+qint64 SheetChunk::dateTime(const int row) const
+{
+    return qint64(bits(row));
+}
+
+
+quint32 SheetChunk::string(const int row) const
+{
+    return quint32(bits(row));
+}
+
+
+CellValue SheetChunk::mixed(const int row) const
+{
+    return mixedValues()[row];
+}
+
+
+CellValue SheetChunk::value(const int row) const
+{
+    if (!hasValue(row))
+        return CellValue();
+
+    if (m_type == Mixed)
+        return mixed(row);
+
+    return toValue(bits(row));
+}
+
+
+const qint64 *SheetChunk::integers() const
+{
+    Q_ASSERT(m_encoding == Plain);
+    return reinterpret_cast<const qint64 *>(m_values.constData());
+}
+
+
+const double *SheetChunk::reals() const
+{
+    Q_ASSERT(m_encoding == Plain);
+    return reinterpret_cast<const double *>(m_values.constData());
+}
+
+
+const quint32 *SheetChunk::strings() const
+{
+    Q_ASSERT(m_encoding == Plain);
+    return reinterpret_cast<const quint32 *>(m_values.constData());
+}
+
+
+const quint64 *SheetChunk::booleans() const
+{
+    return reinterpret_cast<const quint64 *>(m_values.constData());
+}
+
+
+const CellValue *SheetChunk::mixedValues() const
+{
+    Q_ASSERT(m_type == Mixed);
+    return reinterpret_cast<const CellValue *>(m_values.constData());
+}
+
+
+const quint64 *SheetChunk::validity() const
+{
+    return reinterpret_cast<const quint64 *>(m_validity.constData());
+}
+
+
+//
+// Storage
+//
+
+SheetChunk::Layout SheetChunk::layout() const
+{
+    return {m_type, m_encoding, m_codeWidth, m_count, m_capacity, m_entries};
+}
+
+
+const QByteArray &SheetChunk::valueBytes() const
+{
+    return m_values;
+}
+
+
+const QByteArray &SheetChunk::dictionaryBytes() const
+{
+    return m_dictionary;
+}
+
+
+const QByteArray &SheetChunk::validityBytes() const
+{
+    return m_validity;
+}
+
+
+const ChunkStatistics &SheetChunk::statistics() const
+{
+    return m_statistics;
+}
+
+
+ChunkStatistics SheetChunk::exactStatistics() const
+{
+    ChunkStatistics statistics;
+    if (m_type == String || m_type == Mixed)
+        statistics.flags &= ~(ChunkStatistics::Ascending | ChunkStatistics::Descending);
+
+    bool first = true;
+    double previous = 0.0;
+
+    const quint64 *words = validity();
+    for (int word = 0; word < m_capacity / 64; ++word) {
+        quint64 valid = words[word];
+        while (valid) {
+            const int row = word * 64 + qCountTrailingZeroBits(valid);
+            valid &= valid - 1;
+
+            double value;
+            if (!addStatistics(statistics, row, &value))
+                continue;
+
+            if (!first)
+                statistics.checkOrder(previous, value);
+
+            first = false;
+            previous = value;
+        }
+    }
+
+    return statistics;
+}
+
+
+// Tightens statistics that edits have left wider than the values
+void SheetChunk::updateStatistics()
+{
+    if (!m_statistics.isExact())
+        m_statistics = exactStatistics();
+}
+
+
+// Ordinals of the first and the last value in the rows, NaN for values
+// that have none; false if the rows hold no value
+bool SheetChunk::rangeEnds(const int first, const int last, double *front, double *back) const
+{
+    const int end = qMin(last, m_capacity);
+    const int head = nextValid(first);
+    if (head >= end)
+        return false;
+
+    if (!toOrdinal(value(head), front))
+        *front = std::numeric_limits<double>::quiet_NaN();
+    if (!toOrdinal(value(previousValid(end)), back))
+        *back = std::numeric_limits<double>::quiet_NaN();
+
+    return true;
+}
+
+
+// Without statistics, as in files of the first version, they are computed
+bool SheetChunk::fromLayout(const Layout &layout, const QByteArray &values, const QByteArray &dictionary, const QByteArray &validity,
+                            const ChunkStatistics *statistics, const int stringCount, SheetChunk *chunk)
+{
+    // The arrays may point straight into a mapped file; the first write to
+    // a chunk copies them. Sizes are checked first, then the contents.
+    if (layout.type > Mixed || layout.encoding > RunLength)
+        return false;
+    if (layout.capacity < 0 || layout.capacity > Rows || layout.capacity % 64 || layout.count < 0 || layout.count > layout.capacity)
+        return false;
+    if (validity.size() != layout.capacity / 8)
+        return false;
+
+    const int width = valueWidth(layout.type);
+    switch (layout.encoding) {
+    case Plain:
+        if (values.size() != payloadSize(layout.type, layout.capacity) || !dictionary.isEmpty() || layout.entries)
+            return false;
+        break;
+    case Dictionary:
+        if (!width || (layout.codeWidth != 1 && layout.codeWidth != 2) || layout.entries < 1
+                || values.size() != qint64(layout.capacity) * layout.codeWidth || dictionary.size() != qint64(layout.entries) * width)
+            return false;
+        break;
+    case RunLength:
+        if (!width || layout.entries < 1 || values.size() != qint64(layout.entries) * 4 || dictionary.size() != qint64(layout.entries) * width)
+            return false;
+        break;
+    }
+
+    chunk->m_type = layout.type;
+    chunk->m_encoding = layout.encoding;
+    chunk->m_codeWidth = layout.encoding == Dictionary ? layout.codeWidth : 0;
+    chunk->m_encodingChecked = layout.encoding != Plain;
+    chunk->m_count = layout.count;
+    chunk->m_capacity = layout.capacity;
+    chunk->m_entries = layout.entries;
+    chunk->m_values = values;
+    chunk->m_dictionary = dictionary;
+    chunk->m_validity = validity;
+
+    if (!chunk->hasValidArrays(stringCount)) {
+        *chunk = SheetChunk();
+        return false;
+    }
+
+    chunk->m_lastRow = chunk->previousValid(layout.capacity);
+    chunk->m_statistics = statistics ? *statistics : chunk->exactStatistics();
+
+    return true;
+}
+
+
+void SheetChunk::setInteger(const int row, const qint64 value)
+{
+    const bool replaced = prepare(Integer, row);
+    reinterpret_cast<qint64 *>(m_values.data())[row] = value;
+    noteValue(row, replaced);
+}
+
+
+void SheetChunk::setReal(const int row, const double value)
+{
+    const bool replaced = prepare(Real, row);
+    reinterpret_cast<double *>(m_values.data())[row] = value;
+    noteValue(row, replaced);
+}
+
+
+void SheetChunk::setBoolean(const int row, const bool value)
+{
+    const bool replaced = prepare(Boolean, row);
+
+    auto *words = reinterpret_cast<quint64 *>(m_values.data());
+    if (value)
+        words[row >> 6] |= Q_UINT64_C(1) << (row & 63);
+    else
+        words[row >> 6] &= ~(Q_UINT64_C(1) << (row & 63));
+
+    noteValue(row, replaced);
+}
+
+
+void SheetChunk::setDateTime(const int row, const qint64 msecs)
+{
+    const bool replaced = prepare(DateTime, row);
+    reinterpret_cast<qint64 *>(m_values.data())[row] = msecs;
+    noteValue(row, replaced);
+}
+
+
+void SheetChunk::setString(const int row, const quint32 id)
+{
+    const bool replaced = prepare(String, row);
+    reinterpret_cast<quint32 *>(m_values.data())[row] = id;
+    noteValue(row, replaced);
+}
+
+
+void SheetChunk::setMixed(const int row, const CellValue &value)
+{
+    const bool replaced = prepare(Mixed, row);
+    reinterpret_cast<CellValue *>(m_values.data())[row] = value;
+    noteValue(row, replaced);
+}
+
+
+// Text must be pooled already. The chunk takes on a type that can hold the
+// value: integers widen to reals, any other mix keeps every value as it is
+void SheetChunk::setValue(const int row, const CellValue &value)
+{
+    const Type type = typeOf(value);
+    if (type == Empty) {
+        clear(row);
+        return;
+    }
+
+    if (m_type != Empty && m_type != type) {
+        if (m_type == Integer && type == Real)
+            *this = toReal();
+        else if (!(m_type == Real && type == Integer))
+            *this = toMixed();
+    }
+
+    switch (m_type == Empty ? type : m_type) {
+    case Integer:
+        setInteger(row, value.integer());
+        break;
+    case Real:
+        setReal(row, value.toReal());
+        break;
+    case Boolean:
+        setBoolean(row, value.boolean());
+        break;
+    case DateTime:
+        setDateTime(row, value.dateTime());
+        break;
+    case String:
+        setString(row, value.stringId());
+        break;
+    default:
+        setMixed(row, value);
+        break;
+    }
+}
+
+
+void SheetChunk::clear(const int row)
+{
+    if (!hasValue(row))
+        return;
+
+    auto *words = reinterpret_cast<quint64 *>(m_validity.data());
+    words[row >> 6] &= ~(Q_UINT64_C(1) << (row & 63));
+
+    if (--m_count == 0) {
+        // Release the payload of chunks that became empty
+        *this = SheetChunk();
+        return;
+    }
+
+    // The value may have been one of the bounds
+    m_statistics.flags &= ~ChunkStatistics::Exact;
+}
+
+
+int SheetChunk::clear(const int row, const int count)
+{
+    int cleared = 0;
+    for (int r = row; r < row + count && r < m_capacity && m_count; ++r) {
+        if (hasValue(r)) {
+            clear(r);
+            ++cleared;
+        }
+    }
+
+    return cleared;
+}
+
+
+SheetChunk SheetChunk::toReal() const
+{
+    if (m_type == Real)
+        return *this;
+
+    SheetChunk chunk(Real);
+
+    if (m_type == Integer) {
+        chunk.reserve(m_capacity);
+        chunk.m_validity = m_validity;
+        chunk.m_count = m_count;
+
+        auto *target = reinterpret_cast<double *>(chunk.m_values.data());
+        for (int row = 0; row < m_capacity; ++row)
+            target[row] = hasValue(row) ? double(integer(row)) : 0.0;
+
+        // Same bounds and order; the sketch hashed the integers
+        chunk.m_lastRow = m_lastRow;
+        chunk.m_statistics = m_statistics;
+        chunk.m_statistics.flags &= ~ChunkStatistics::Exact;
+    }
+
+    return chunk;
+}
+
+
+SheetChunk SheetChunk::toMixed() const
+{
+    if (m_type == Mixed)
+        return *this;
+
+    SheetChunk chunk(Mixed);
+    chunk.reserve(m_capacity);
+    chunk.m_validity = m_validity;
+    chunk.m_count = m_count;
+
+    auto *target = reinterpret_cast<CellValue *>(chunk.m_values.data());
+    for (int row = 0; row < m_capacity; ++row)
+        target[row] = value(row);
+
+    // Mixed chunks have no order
+    chunk.m_lastRow = m_lastRow;
+    chunk.m_statistics = m_statistics;
+    chunk.m_statistics.flags &= ~(ChunkStatistics::Ascending | ChunkStatistics::Descending | ChunkStatistics::Exact);
+
+    return chunk;
+}
+
+
+//
+// Encoded access
+//
+
+quint64 SheetChunk::bits(const int row) const
+{
+    switch (m_encoding) {
+    case Dictionary:
+        return entry(code(row));
+
+    case RunLength: {
+        const auto *ends = reinterpret_cast<const quint32 *>(m_values.constData());
+        return entry(int(std::upper_bound(ends, ends + m_entries, quint32(row)) - ends));
+    }
+
+    default:
+        if (m_type == Boolean)
+            return boolean(row);
+
+        quint64 value = 0;
+        std::memcpy(&value, m_values.constData() + qint64(row) * valueWidth(m_type), size_t(valueWidth(m_type)));
+        return value;
+    }
+}
+
+
+quint64 SheetChunk::entry(const int index) const
+{
+    quint64 value = 0;
+    std::memcpy(&value, m_dictionary.constData() + qint64(index) * valueWidth(m_type), size_t(valueWidth(m_type)));
+
+    return value;
+}
+
+
+int SheetChunk::code(const int row) const
+{
+    if (m_codeWidth == 1)
+        return reinterpret_cast<const quint8 *>(m_values.constData())[row];
+
+    return reinterpret_cast<const quint16 *>(m_values.constData())[row];
+}
+
+
+int SheetChunk::runEnd(const int run) const
+{
+    return int(reinterpret_cast<const quint32 *>(m_values.constData())[run]);
+}
+
+
+int SheetChunk::validCount(const int first, const int last) const
+{
+    const quint64 *words = validity();
+
+    int count = 0;
+    for (int row = first; row < last; ) {
+        const int bit = row & 63;
+        const int length = qMin(64 - bit, last - row);
+        const quint64 mask = (length == 64 ? ~Q_UINT64_C(0) : (Q_UINT64_C(1) << length) - 1) << bit;
+
+        count += qPopulationCount(words[row >> 6] & mask);
+        row += length;
+    }
+
+    return count;
+}
+
+
+// Whatever is used as an index or a string id must be in range: dictionary
+// codes of every row, run ends rising up to the capacity, and the strings
+// of the rows that hold a value
+bool SheetChunk::hasValidArrays(const int stringCount) const
+{
+    if (validCount(0, m_capacity) != m_count)
+        return false;
+
+    if (m_encoding == RunLength) {
+        const auto *ends = reinterpret_cast<const quint32 *>(m_values.constData());
+        for (int run = 0; run < m_entries; ++run) {
+            if (ends[run] <= (run ? ends[run - 1] : 0) || ends[run] > quint32(m_capacity))
+                return false;
+        }
+        if (ends[m_entries - 1] != quint32(m_capacity))
+            return false;
+    }
+    else if (m_encoding == Dictionary) {
+        for (int row = 0; row < m_capacity; ++row) {
+            if (code(row) >= m_entries)
+                return false;
+        }
+    }
+
+    if (m_type == String && m_encoding != Plain) {
+        for (int index = 0; index < m_entries; ++index) {
+            if (entry(index) >= quint64(stringCount))
+                return false;
+        }
+        return true;
+    }
+
+    if (m_type != String && m_type != Mixed)
+        return true;
+
+    const quint64 *words = validity();
+    for (int word = 0; word < m_capacity / 64; ++word) {
+        quint64 valid = words[word];
+        while (valid) {
+            const int row = word * 64 + qCountTrailingZeroBits(valid);
+            valid &= valid - 1;
+
+            if (m_type == String ? strings()[row] >= quint32(stringCount) : !mixedValues()[row].isValid(stringCount))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+
+// First row from the given one on that holds a value, or the capacity
+int SheetChunk::nextValid(int row) const
+{
+    const quint64 *words = validity();
+
+    while (row < m_capacity) {
+        const quint64 word = words[row >> 6] >> (row & 63);
+        if (word)
+            return row + qCountTrailingZeroBits(word);
+
+        row = (row | 63) + 1;
+    }
+
+    return m_capacity;
+}
+
+
+// Last row before the given one that holds a value, or -1
+int SheetChunk::previousValid(int row) const
+{
+    const quint64 *words = validity();
+
+    while (row > 0) {
+        --row;
+        const quint64 word = words[row >> 6] << (63 - (row & 63));
+        if (word)
+            return row - qCountLeadingZeroBits(word);
+
+        row &= ~63;
+    }
+
+    return -1;
+}
+
+
+// First row from which on every value satisfies the predicate, given that
+// it holds for a tail of the values in row order
+int SheetChunk::partitionRow(const std::function<bool(const double value)> &predicate) const
+{
+    int first = 0;
+    int last = m_capacity;
+
+    while (first < last) {
+        const int middle = first + (last - first) / 2;
+        const int row = nextValid(middle);
+
+        if (row == m_capacity || predicate(toDouble(bits(row))))
+            last = middle;
+        else
+            first = row + 1;
+    }
+
+    return first;
+}
+
+
+double SheetChunk::toDouble(const quint64 bits) const
+{
+    if (m_type == Integer || m_type == Boolean || m_type == DateTime)
+        return double(qint64(bits));
+
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+
+CellValue SheetChunk::toValue(const quint64 bits) const
+{
+    switch (m_type) {
+    case Integer:
+        return CellValue::fromInteger(qint64(bits));
+    case Real:
+        return CellValue::fromReal(toDouble(bits));
+    case Boolean:
+        return CellValue::fromBoolean(bits);
+    case DateTime:
+        return CellValue::fromDateTime(qint64(bits));
+    case String:
+        return CellValue::fromPooledText(quint32(bits));
+    default:
+        return CellValue();
+    }
+}
+
+
+//
+// Encoding
+//
+
+bool SheetChunk::isEncodable() const
+{
+    return !m_encodingChecked && m_encoding == Plain && m_count && valueWidth(m_type);
+}
+
+
+void SheetChunk::encode()
+{
+    if (!isEncodable())
+        return;
+
+    m_encodingChecked = true;
+
+    const int width = valueWidth(m_type);
+
+    // One pass to measure runs and cardinality
+    QHash<quint64, int> codes;
+    QByteArray dictionary;
+    QByteArray runValues;
+    QByteArray runEnds;
+    bool dictionaryFits = true;
+    quint64 current = 0;
+
+    for (int row = 0; row < m_capacity; ++row) {
+
+        if (!hasValue(row))
+            continue;
+
+        const quint64 value = bits(row);
+        if (runValues.isEmpty() || value != current) {
+            if (!runValues.isEmpty()) {
+                const auto end = quint32(row);
+                runEnds.append(reinterpret_cast<const char *>(&end), 4);
+            }
+            runValues.append(reinterpret_cast<const char *>(&value), width);
+            current = value;
+        }
+
+        if (dictionaryFits && !codes.contains(value)) {
+            if (codes.size() == 65536) {
+                dictionaryFits = false;
+            }
+            else {
+                codes.insert(value, codes.size());
+                dictionary.append(reinterpret_cast<const char *>(&value), width);
+            }
+        }
+    }
+
+    const auto end = quint32(m_capacity);
+    runEnds.append(reinterpret_cast<const char *>(&end), 4);
+
+    const int runs = runEnds.size() / 4;
+    const int codeWidth = codes.size() <= 256 ? 1 : 2;
+
+    const qint64 plainSize = qint64(m_capacity) * width;
+    const qint64 runLengthSize = qint64(runs) * (width + 4);
+    const qint64 dictionarySize = dictionaryFits ? qint64(codes.size()) * width + qint64(m_capacity) * codeWidth : plainSize;
+
+    // Only switch when the encoding saves a quarter or more
+    if (runLengthSize <= dictionarySize && runLengthSize * 4 <= plainSize * 3) {
+        m_encoding = RunLength;
+        m_entries = runs;
+        m_dictionary = runValues;
+        m_values = runEnds;
+    }
+    else if (dictionarySize < runLengthSize && dictionarySize * 4 <= plainSize * 3) {
+        QByteArray values(m_capacity * codeWidth, 0);
+        for (int row = 0; row < m_capacity; ++row) {
+            if (!hasValue(row))
+                continue;
+
+            const int code = codes.value(bits(row));
+            if (codeWidth == 1)
+                reinterpret_cast<quint8 *>(values.data())[row] = quint8(code);
+            else
+                reinterpret_cast<quint16 *>(values.data())[row] = quint16(code);
+        }
+
+        m_encoding = Dictionary;
+        m_codeWidth = quint8(codeWidth);
+        m_entries = codes.size();
+        m_dictionary = dictionary;
+        m_values = values;
+    }
+}
+
+
+void SheetChunk::decode()
+{
+    if (m_encoding == Plain)
+        return;
+
+    const int width = valueWidth(m_type);
+    QByteArray values(int(payloadSize(m_type, m_capacity)), 0);
+
+    if (m_encoding == RunLength) {
+        for (int run = 0, first = 0; run < m_entries; first = runEnd(run), ++run) {
+            const quint64 value = entry(run);
+            for (int row = first; row < runEnd(run); ++row)
+                std::memcpy(values.data() + qint64(row) * width, &value, size_t(width));
+        }
+    }
+    else {
+        for (int row = 0; row < m_capacity; ++row) {
+            const quint64 value = entry(code(row));
+            std::memcpy(values.data() + qint64(row) * width, &value, size_t(width));
+        }
+    }
+
+    m_encoding = Plain;
+    m_codeWidth = 0;
+    m_entries = 0;
+    m_values = values;
+    m_dictionary.clear();
+}
+
+
+//
+// Operations on the encoded form
+//
+
+void SheetChunk::aggregate(ChunkAggregate &aggregate) const
+{
+    // Dates and times are not numbers to add up
+    if (m_type == Empty || m_type == String || m_type == DateTime)
+        return;
+
+    ChunkAggregate result;
+
+    if (m_type == Mixed) {
+        // Text and errors do not take part
+        for (int row = 0; row < m_capacity; ++row) {
+            const CellValue value = this->value(row);
+            if (value.isNumber() || value.type() == CellValue::Boolean)
+                result.add(value.toReal(), 1);
+        }
+    }
+    else if (m_encoding == RunLength) {
+        for (int run = 0, first = 0; run < m_entries; first = runEnd(run), ++run)
+            result.add(toDouble(entry(run)), validCount(first, runEnd(run)));
+    }
+    else if (m_encoding == Dictionary) {
+        QVector<qint64> histogram(m_entries, 0);
+        for (int row = 0; row < m_capacity; ++row) {
+            if (hasValue(row))
+                ++histogram[code(row)];
+        }
+        for (int index = 0; index < m_entries; ++index)
+            result.add(toDouble(entry(index)), histogram.at(index));
+    }
+    else {
+        const quint64 *words = validity();
+        for (int word = 0; word < m_capacity / 64; ++word) {
+            quint64 valid = words[word];
+            while (valid) {
+                const int row = word * 64 + qCountTrailingZeroBits(valid);
+                valid &= valid - 1;
+                result.add(toDouble(bits(row)), 1);
+            }
+        }
+    }
+
+    aggregate.merge(result);
+}
+
+
+void SheetChunk::filter(const RealPredicate &predicate, quint64 *selection) const
+{
+    if (m_type == Mixed) {
+        filterValues([&](const CellValue &value) {
+            return (value.isNumber() || value.type() == CellValue::Boolean) && predicate(value.toReal());
+        }, selection);
+        return;
+    }
+
+    if (m_type != Integer && m_type != Real && m_type != Boolean)
+        return;
+
+    filterEntries([&](const quint64 bits) { return predicate(toDouble(bits)); }, selection);
+}
+
+
+void SheetChunk::filter(const StringPredicate &predicate, quint64 *selection) const
+{
+    if (m_type == Mixed) {
+        // Text in mixed chunks is always pooled
+        filterValues([&](const CellValue &value) {
+            return value.type() == CellValue::PooledText && predicate(value.stringId());
+        }, selection);
+        return;
+    }
+
+    if (m_type != String)
+        return;
+
+    filterEntries([&](const quint64 bits) { return predicate(quint32(bits)); }, selection);
+}
+
+
+// Selects numbers, booleans and dates from low to high. Chunks whose
+// bounds lie outside are skipped and sorted chunks are searched, so that
+// only chunks at the edges of the range are looked at row by row
+void SheetChunk::filterRange(const double low, const double high, quint64 *selection) const
+{
+    if (!m_statistics.overlaps(low, high))
+        return;
+
+    if (m_type == Mixed) {
+        filterValues([&](const CellValue &value) {
+            double ordinal;
+            return toOrdinal(value, &ordinal) && ordinal >= low && ordinal <= high;
+        }, selection);
+        return;
+    }
+
+    if (m_statistics.isWithin(low, high)) {
+        selectRows(0, m_capacity, selection);
+    }
+    else if (m_statistics.flags & ChunkStatistics::Ascending) {
+        const int first = partitionRow([low](const double value) { return value >= low; });
+        const int last = partitionRow([high](const double value) { return value > high; });
+        selectRows(first, last, selection);
+    }
+    else if (m_statistics.flags & ChunkStatistics::Descending) {
+        const int first = partitionRow([high](const double value) { return value <= high; });
+        const int last = partitionRow([low](const double value) { return value < low; });
+        selectRows(first, last, selection);
+    }
+    else {
+        filterEntries([&](const quint64 bits) {
+            const double value = toDouble(bits);
+            return value >= low && value <= high;
+        }, selection);
+    }
+}
+
+
+void SheetChunk::filterEntries(const std::function<bool(const quint64 bits)> &predicate, quint64 *selection) const
+{
+    if (m_encoding == RunLength) {
+        // One predicate call per run; whole words are selected at once
+        for (int run = 0, first = 0; run < m_entries; first = runEnd(run), ++run) {
+            if (predicate(entry(run)))
+                selectRows(first, runEnd(run), selection);
+        }
+    }
+    else if (m_encoding == Dictionary) {
+        // One predicate call per distinct value
+        QVector<bool> matches(m_entries);
+        for (int index = 0; index < m_entries; ++index)
+            matches[index] = predicate(entry(index));
+
+        for (int row = 0; row < m_capacity; ++row) {
+            if (hasValue(row) && matches.at(code(row)))
+                selection[row >> 6] |= Q_UINT64_C(1) << (row & 63);
+        }
+    }
+    else {
+        for (int row = 0; row < m_capacity; ++row) {
+            if (hasValue(row) && predicate(bits(row)))
+                selection[row >> 6] |= Q_UINT64_C(1) << (row & 63);
+        }
+    }
+}
+
+
+// Selects the rows in the range that hold a value, whole words at once
+void SheetChunk::selectRows(const int first, const int last, quint64 *selection) const
+{
+    const quint64 *words = validity();
+
+    for (int row = first; row < last; ) {
+        const int bit = row & 63;
+        const int length = qMin(64 - bit, last - row);
+        const quint64 mask = (length == 64 ? ~Q_UINT64_C(0) : (Q_UINT64_C(1) << length) - 1) << bit;
+
+        selection[row >> 6] |= words[row >> 6] & mask;
+        row += length;
+    }
+}
+
+
+void SheetChunk::filterValues(const std::function<bool(const CellValue &value)> &predicate, quint64 *selection) const
+{
+    const CellValue *values = mixedValues();
+    for (int row = 0; row < m_capacity; ++row) {
+        if (hasValue(row) && predicate(values[row]))
+            selection[row >> 6] |= Q_UINT64_C(1) << (row & 63);
+    }
+}
+
+
+void SheetChunk::countValues(QHash<CellValue, qint64> &counts) const
+{
+    if (m_type == Mixed) {
+        for (int row = 0; row < m_capacity; ++row) {
+            if (hasValue(row))
+                ++counts[mixed(row)];
+        }
+        return;
+    }
+
+    // Count raw values first so that keys are only built once per distinct value
+    QHash<quint64, qint64> raw;
+
+    if (m_encoding == RunLength) {
+        for (int run = 0, first = 0; run < m_entries; first = runEnd(run), ++run) {
+            const int count = validCount(first, runEnd(run));
+            if (count)
+                raw[entry(run)] += count;
+        }
+    }
+    else if (m_encoding == Dictionary) {
+        QVector<qint64> histogram(m_entries, 0);
+        for (int row = 0; row < m_capacity; ++row) {
+            if (hasValue(row))
+                ++histogram[code(row)];
+        }
+        for (int index = 0; index < m_entries; ++index) {
+            if (histogram.at(index))
+                raw[entry(index)] += histogram.at(index);
+        }
+    }
+    else {
+        for (int row = 0; row < m_capacity; ++row) {
+            if (hasValue(row))
+                ++raw[bits(row)];
+        }
+    }
+
+    for (auto it = raw.constBegin(); it != raw.constEnd(); ++it)
+        counts[toValue(it.key())] += it.value();
+}
+
+
+//
+// Storage
+//
+
+// Returns whether the row held a value already
+bool SheetChunk::prepare(const Type type, const int row)
+{
+    Q_ASSERT(row >= 0 && row < Rows);
+    Q_ASSERT(m_type == Empty || m_type == type);
+
+    // Edits go to the plain form; the chunk is encoded again later
+    decode();
+    m_encodingChecked = false;
+
+    m_type = type;
+
+    if (row >= m_capacity) {
+        // Grow geometrically so that small sheets stay small
+        int rows = qMax(m_capacity, 1024);
+        while (rows <= row)
+            rows *= 2;
+        reserve(qMin(rows, int(Rows)));
+    }
+
+    const bool replaced = hasValue(row);
+    markValid(row);
+    m_lastRow = qMax(m_lastRow, row);
+
+    return replaced;
+}
+
+
+void SheetChunk::noteValue(const int row, const bool replaced)
+{
+    // The replaced value may have been one of the bounds
+    if (replaced)
+        m_statistics.flags &= ~ChunkStatistics::Exact;
+
+    double value;
+    if (!addStatistics(m_statistics, row, &value)) {
+        m_statistics.flags &= ~(ChunkStatistics::Ascending | ChunkStatistics::Descending);
+        return;
+    }
+
+    // A sorted chunk stays sorted when the value fits between its neighbours
+    if (!(m_statistics.flags & (ChunkStatistics::Ascending | ChunkStatistics::Descending)))
+        return;
+
+    const int previous = previousValid(row);
+    if (previous >= 0)
+        m_statistics.checkOrder(toDouble(bits(previous)), value);
+
+    // Appending, as imports do, has no neighbour behind
+    const int next = row < m_lastRow ? nextValid(row + 1) : m_capacity;
+    if (next < m_capacity)
+        m_statistics.checkOrder(value, toDouble(bits(next)));
+}
+
+
+// Returns whether the value takes part in the order of the chunk
+bool SheetChunk::addStatistics(ChunkStatistics &statistics, const int row, double *ordinal) const
+{
+    if (m_type == Mixed) {
+        const CellValue value = mixed(row);
+        if (toOrdinal(value, ordinal))
+            statistics.widen(*ordinal);
+
+        statistics.addHash(hashValue(value));
+        return false;
+    }
+
+    const quint64 bits = this->bits(row);
+    statistics.addHash(hashBits(m_type, bits));
+
+    if (m_type == String)
+        return false;
+
+    *ordinal = toDouble(bits);
+    statistics.widen(*ordinal);
+
+    return true;
+}
+
+
+void SheetChunk::reserve(const int rows)
+{
+    if (rows <= m_capacity)
+        return;
+
+    const int oldValues = m_values.size();
+    m_values.resize(int(payloadSize(m_type, rows)));
+    std::memset(m_values.data() + oldValues, 0, size_t(m_values.size() - oldValues));
+
+    const int oldValidity = m_validity.size();
+    m_validity.resize(rows / 8);
+    std::memset(m_validity.data() + oldValidity, 0, size_t(m_validity.size() - oldValidity));
+
+    m_capacity = rows;
+}
+
+
+void SheetChunk::markValid(const int row)
+{
+    auto *words = reinterpret_cast<quint64 *>(m_validity.data());
+    const quint64 bit = Q_UINT64_C(1) << (row & 63);
+
+    if (!(words[row >> 6] & bit)) {
+        words[row >> 6] |= bit;
+        ++m_count;
+    }
+}
@@ -0,0 +1,232 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SHEET_CHUNK_H
+#define SHEET_CHUNK_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QtGlobal>
+
+#include <functional>
+
+#include "cell_value.h"
+
+
+struct ChunkAggregate
+{
+    qint64 count = 0;
+    double sum = 0.0;
+    double minimum = 0.0;
+    double maximum = 0.0;
+
+    void add(const double value, const qint64 times);
+    void merge(const ChunkAggregate &other);
+};
+
+
+// What is known about the values of a chunk without looking at them: the
+// bounds of its numbers, booleans and dates, whether these are sorted by
+// row, and a sketch of its distinct values. Edits keep the statistics
+// correct but may leave the bounds and the sketch wider than the values;
+// such statistics are no longer exact until they are computed again.
+struct ChunkStatistics
+{
+    enum Flag : quint8 {
+        Ascending = 0x1,
+        Descending = 0x2,
+        Exact = 0x4
+    };
+
+    static constexpr int SketchSize = 64;
+
+    ChunkStatistics();
+
+    bool hasBounds() const;
+    bool overlaps(const double low, const double high) const;
+    bool isWithin(const double low, const double high) const;
+    bool isExact() const;
+    double distinctCount() const;
+
+    void widen(const double value);
+    void addHash(const quint64 hash);
+    void checkOrder(const double first, const double second);
+    void merge(const ChunkStatistics &next);
+
+    double minimum;
+    double maximum;
+    quint8 flags;
+
+    // HyperLogLog registers
+    quint8 sketch[SketchSize];
+};
+
+
+class SheetChunk
+{
+public:
+    enum Type : quint8 {
+        Empty,
+        Integer,
+        Real,
+        Boolean,
+        DateTime,
+        String,
+        Mixed
+    };
+
+    enum Encoding : quint8 {
+        Plain,
+        Dictionary,
+        RunLength
+    };
+
+    // Everything but the arrays, as stored in workbook files
+    struct Layout {
+        Type type;
+        Encoding encoding;
+        quint8 codeWidth;
+        int count;
+        int capacity;
+        int entries;
+    };
+
+    using RealPredicate = std::function<bool(const double value)>;
+    using StringPredicate = std::function<bool(const quint32 id)>;
+
+    static constexpr int Rows = 65536;
+
+    explicit SheetChunk(const Type type = Empty);
+
+    static Type typeOf(const CellValue &value);
+    static bool fromLayout(const Layout &layout, const QByteArray &values, const QByteArray &dictionary, const QByteArray &validity,
+                           const ChunkStatistics *statistics, const int stringCount, SheetChunk *chunk);
+
+    Type type() const;
+    Encoding encoding() const;
+    int count() const;
+    bool isEmpty() const;
+    int capacity() const;
+    qint64 byteSize() const;
+
+    bool hasValue(const int row) const;
+    qint64 integer(const int row) const;
+    double real(const int row) const;
+    bool boolean(const int row) const;
+    qint64 dateTime(const int row) const;
+    quint32 string(const int row) const;
+    CellValue mixed(const int row) const;
+    CellValue value(const int row) const;
+
+    const qint64 *integers() const;
+    const double *reals() const;
+    const quint32 *strings() const;
+    const quint64 *booleans() const;
+    const CellValue *mixedValues() const;
+    const quint64 *validity() const;
+
+    Layout layout() const;
+    const QByteArray &valueBytes() const;
+    const QByteArray &dictionaryBytes() const;
+    const QByteArray &validityBytes() const;
+
+    const ChunkStatistics &statistics() const;
+    ChunkStatistics exactStatistics() const;
+    void updateStatistics();
+    bool rangeEnds(const int first, const int last, double *front, double *back) const;
+
+    void setInteger(const int row, const qint64 value);
+    void setReal(const int row, const double value);
+    void setBoolean(const int row, const bool value);
+    void setDateTime(const int row, const qint64 msecs);
+    void setString(const int row, const quint32 id);
+    void setMixed(const int row, const CellValue &value);
+    void setValue(const int row, const CellValue &value);
+    void clear(const int row);
+    int clear(const int row, const int count);
+
+    SheetChunk toReal() const;
+    SheetChunk toMixed() const;
+
+    bool isEncodable() const;
+    void encode();
+    void decode();
+
+    void aggregate(ChunkAggregate &aggregate) const;
+    void filter(const RealPredicate &predicate, quint64 *selection) const;
+    void filter(const StringPredicate &predicate, quint64 *selection) const;
+    void filterRange(const double low, const double high, quint64 *selection) const;
+    void countValues(QHash<CellValue, qint64> &counts) const;
+
+private:
+    static qint64 payloadSize(const Type type, const int rows);
+    static int valueWidth(const Type type);
+    static quint64 hashBits(const Type type, const quint64 bits);
+    static quint64 hashValue(const CellValue &value);
+    static bool toOrdinal(const CellValue &value, double *ordinal);
+
+    quint64 bits(const int row) const;
+    quint64 entry(const int index) const;
+    int code(const int row) const;
+    int runEnd(const int run) const;
+    int validCount(const int first, const int last) const;
+    int nextValid(int row) const;
+    int previousValid(int row) const;
+    int partitionRow(const std::function<bool(const double value)> &predicate) const;
+    bool hasValidArrays(const int stringCount) const;
+    double toDouble(const quint64 bits) const;
+    CellValue toValue(const quint64 bits) const;
+
+    void filterEntries(const std::function<bool(const quint64 bits)> &predicate, quint64 *selection) const;
+    void filterValues(const std::function<bool(const CellValue &value)> &predicate, quint64 *selection) const;
+    void selectRows(const int first, const int last, quint64 *selection) const;
+
+    bool prepare(const Type type, const int row);
+    void noteValue(const int row, const bool replaced);
+    bool addStatistics(ChunkStatistics &statistics, const int row, double *ordinal) const;
+    void reserve(const int rows);
+    void markValid(const int row);
+
+    Type m_type;
+    Encoding m_encoding;
+    quint8 m_codeWidth;
+    bool m_encodingChecked;
+    int m_count;
+    int m_capacity;
+    int m_entries;
+
+    // No row behind this one holds a value
+    int m_lastRow;
+
+    // Plain chunks keep one value per row in m_values. Dictionary chunks
+    // keep the distinct values in m_dictionary and one code per row in
+    // m_values; run-length chunks keep one value per run in m_dictionary
+    // and the exclusive end row of every run in m_values. Mixed chunks are
+    // always plain and keep one CellValue per row.
+    QByteArray m_values;
+    QByteArray m_dictionary;
+    QByteArray m_validity;
+
+    ChunkStatistics m_statistics;
+};
+
+#endif // SHEET_CHUNK_H
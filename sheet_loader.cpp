@@ -0,0 +1,132 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "sheet_loader.h"
+
+#include <QMutexLocker>
+
+#include "string_pool.h"
+
+
+SheetLoader::SheetLoader(const QString &fileName, const QSharedPointer<StringPool> &pool, QObject *parent)
+    : QThread(parent)
+    , m_fileName{fileName}
+    , m_reader{pool}
+    , m_failed{false}
+{
+    // Parsed rows wait here until the thread that owns the sheet takes them
+    m_reader.setChunkHandler([this](const QVector<QVector<SheetChunk>> &windows, const int rows, const int columns, const int firstRow) {
+        QMutexLocker locker(&m_mutex);
+        m_batches.append({windows, rows, columns, firstRow, m_reader.columnTitles()});
+        locker.unlock();
+
+        emit rowsAvailable();
+    });
+}
+
+
+SheetLoader::~SheetLoader()
+{
+    cancel();
+    wait();
+}
+
+
+QString SheetLoader::fileName() const
+{
+    return m_fileName;
+}
+
+
+void SheetLoader::setDialect(const CsvDialect &dialect)
+{
+    m_dialect = dialect;
+    m_reader.setDialect(dialect);
+}
+
+
+void SheetLoader::setThreadCount(const int count)
+{
+    m_reader.setThreadCount(count);
+}
+
+
+int SheetLoader::progress() const
+{
+    return m_reader.progress();
+}
+
+
+bool SheetLoader::isCancelled() const
+{
+    return m_reader.isCancelled();
+}
+
+
+bool SheetLoader::hasFailed() const
+{
+    return m_failed;
+}
+
+
+QString SheetLoader::errorString() const
+{
+    return m_reader.errorString();
+}
+
+
+QVector<SheetLoader::Batch> SheetLoader::takeBatches()
+{
+    QMutexLocker locker(&m_mutex);
+
+    QVector<Batch> batches;
+    batches.swap(m_batches);
+
+    return batches;
+}
+
+
+void SheetLoader::cancel()
+{
+    m_reader.cancel();
+}
+
+
+void SheetLoader::run()
+{
+    // The index of an earlier read is only of use for the same dialect
+    CsvIndex knownIndex;
+    const bool indexed = knownIndex.load(m_fileName) && knownIndex.dialect() == m_dialect;
+    if (indexed)
+        m_reader.setIndex(knownIndex);
+
+    m_failed = !m_reader.read(m_fileName) && !m_reader.isCancelled();
+
+    // A complete read is indexed for the next one
+    CsvIndex index = m_reader.index();
+    if (!m_failed && !m_reader.isCancelled() && !indexed && index.isValid()) {
+        CsvDialect dialect = m_dialect;
+        dialect.encoding = m_reader.encoding();
+        index.setDialect(dialect);
+        index.save(m_fileName);
+    }
+}
@@ -0,0 +1,87 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SHEET_LOADER_H
+#define SHEET_LOADER_H
+
+#include <QThread>
+
+#include <QMutex>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVector>
+
+#include "csv_reader.h"
+#include "sheet_chunk.h"
+
+class StringPool;
+
+
+class SheetLoader : public QThread
+{
+    Q_OBJECT
+
+public:
+    // Rows parsed in the background, in file order
+    struct Batch {
+        QVector<QVector<SheetChunk>> windows;
+        int rows = 0;
+        int columns = 0;
+        int firstRow = 0;
+        QStringList titles;
+    };
+
+    explicit SheetLoader(const QString &fileName, const QSharedPointer<StringPool> &pool, QObject *parent = nullptr);
+    ~SheetLoader() override;
+
+    QString fileName() const;
+
+    void setDialect(const CsvDialect &dialect);
+    void setThreadCount(const int count);
+
+    int progress() const;
+    bool isCancelled() const;
+    bool hasFailed() const;
+    QString errorString() const;
+
+    QVector<Batch> takeBatches();
+
+signals:
+    void rowsAvailable();
+
+public slots:
+    void cancel();
+
+protected:
+    void run() override;
+
+private:
+    QString m_fileName;
+    CsvDialect m_dialect;
+    CsvReader m_reader;
+    bool m_failed;
+
+    QMutex m_mutex;
+    QVector<Batch> m_batches;
+};
+
+#endif // SHEET_LOADER_H
@@ -0,0 +1,298 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "sheet_model.h"
+
+#include "abstract_sheet.h"
+
+
+namespace {
+
+// Empty rows and columns past the data, so that there is always a grid to type into
+constexpr int SpareRows = 100;
+constexpr int SpareColumns = 26;
+
+}
+
+
+SheetModel::SheetModel(AbstractSheet *sheet, QObject *parent)
+    : QAbstractTableModel(parent)
+    , m_sheet{sheet}
+    , m_readOnly{false}
+{
+
+}
+
+
+void SheetModel::setSheet(AbstractSheet *sheet)
+{
+    // Only ever swapped for a sheet with the same cells, so views keep
+    // what they show
+    m_sheet = sheet;
+}
+
+
+bool SheetModel::isReadOnly() const
+{
+    return m_readOnly;
+}
+
+
+void SheetModel::setReadOnly(const bool readOnly)
+{
+    // Views ask for the flags whenever an edit starts
+    m_readOnly = readOnly;
+}
+
+
+int SheetModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+
+    return m_sheet->rowCount() + SpareRows;
+}
+
+
+int SheetModel::columnCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+
+    return m_sheet->columnCount() + SpareColumns;
+}
+
+
+QVariant SheetModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid())
+        return QVariant();
+
+    switch (role) {
+    case Qt::DisplayRole:
+    case Qt::EditRole:
+        return m_sheet->cell(index.row(), index.column()).toVariant(m_sheet->stringPool().data());
+
+    case Qt::TextAlignmentRole: {
+        const CellValue value = m_sheet->cell(index.row(), index.column());
+        if (value.isNumber() || value.type() == CellValue::Boolean || value.type() == CellValue::DateTime)
+            return int(Qt::AlignRight | Qt::AlignVCenter);
+        if (value.type() == CellValue::Error)
+            return int(Qt::AlignCenter);
+        return QVariant();
+    }
+
+    default:
+        return QVariant();
+    }
+}
+
+
+bool SheetModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    if (!index.isValid() || role != Qt::EditRole || m_readOnly)
+        return false;
+
+    setValues(index.row(), index.column(), 1, 1, {CellValue::fromVariant(value, m_sheet->stringPool().data())});
+
+    return true;
+}
+
+
+QVariant SheetModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    // Columns read with a header row show its titles, and their letters
+    // as a tool tip
+    if (orientation == Qt::Horizontal) {
+        const QString title = m_sheet->columnTitle(section);
+        if (role == Qt::DisplayRole)
+            return title.isEmpty() ? columnName(section) : title;
+        if (role == Qt::ToolTipRole && !title.isEmpty())
+            return columnName(section);
+        return QVariant();
+    }
+
+    if (role != Qt::DisplayRole)
+        return QVariant();
+
+    return section + 1;
+}
+
+
+Qt::ItemFlags SheetModel::flags(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return Qt::NoItemFlags;
+
+    if (m_readOnly)
+        return Qt::ItemIsSelectable | Qt::ItemIsEnabled;
+
+    return Qt::ItemIsSelectable | Qt::ItemIsEditable | Qt::ItemIsEnabled;
+}
+
+
+bool SheetModel::insertRows(int row, int count, const QModelIndex &parent)
+{
+    // Rows inserted into the spare area do not change anything
+    if (parent.isValid() || m_readOnly || count <= 0 || row < 0 || row > m_sheet->rowCount())
+        return false;
+
+    beginInsertRows(QModelIndex(), row, row + count - 1);
+    m_sheet->insertRows(row, count);
+    endInsertRows();
+
+    emit edited({Edit::InsertRows, row, 0, count, 0, {}});
+
+    return true;
+}
+
+
+bool SheetModel::removeRows(int row, int count, const QModelIndex &parent)
+{
+    const int rows = qMin(count, m_sheet->rowCount() - row);
+    if (parent.isValid() || m_readOnly || rows <= 0 || row < 0)
+        return false;
+
+    beginRemoveRows(QModelIndex(), row, row + rows - 1);
+    m_sheet->removeRows(row, rows);
+    endRemoveRows();
+
+    emit edited({Edit::RemoveRows, row, 0, rows, 0, {}});
+
+    return true;
+}
+
+
+bool SheetModel::insertColumns(int column, int count, const QModelIndex &parent)
+{
+    if (parent.isValid() || m_readOnly || count <= 0 || column < 0 || column > m_sheet->columnCount())
+        return false;
+
+    beginInsertColumns(QModelIndex(), column, column + count - 1);
+    m_sheet->insertColumns(column, count);
+    endInsertColumns();
+
+    emit edited({Edit::InsertColumns, 0, column, 0, count, {}});
+
+    return true;
+}
+
+
+bool SheetModel::removeColumns(int column, int count, const QModelIndex &parent)
+{
+    const int columns = qMin(count, m_sheet->columnCount() - column);
+    if (parent.isValid() || m_readOnly || columns <= 0 || column < 0)
+        return false;
+
+    beginRemoveColumns(QModelIndex(), column, column + columns - 1);
+    m_sheet->removeColumns(column, columns);
+    endRemoveColumns();
+
+    emit edited({Edit::RemoveColumns, 0, column, 0, columns, {}});
+
+    return true;
+}
+
+
+QVector<CellValue> SheetModel::fetchRange(const int row, const int column, const int rows, const int columns) const
+{
+    QVector<CellValue> values;
+    m_sheet->fetchRange(row, column, rows, columns, values);
+
+    return values;
+}
+
+
+void SheetModel::setValues(const int row, const int column, const int rows, const int columns, const QVector<CellValue> &values)
+{
+    if (m_readOnly || row < 0 || column < 0 || rows <= 0 || columns <= 0 || values.size() < rows * columns)
+        return;
+
+    const int oldRows = rowCount();
+    const int oldColumns = columnCount();
+
+    for (int r = 0; r < rows; ++r)
+        for (int c = 0; c < columns; ++c)
+            m_sheet->setCell(row + r, column + c, values.at(r * columns + c));
+
+    // One notification for the part of the range that was already there;
+    // the rest arrives as inserted rows and columns
+    const int lastRow = qMin(row + rows, oldRows) - 1;
+    const int lastColumn = qMin(column + columns, oldColumns) - 1;
+    if (lastRow >= row && lastColumn >= column)
+        emit dataChanged(index(row, column), index(lastRow, lastColumn), {Qt::DisplayRole, Qt::EditRole});
+
+    updateExtent(oldRows, oldColumns);
+
+    emit edited({Edit::SetValues, row, column, rows, columns, values});
+}
+
+
+void SheetModel::updateExtent(const int oldRows, const int oldColumns)
+{
+    // Announces whatever the sheet grew by since the model had oldRows and
+    // oldColumns, be it through an edit or a loader filling it directly
+    if (rowCount() > oldRows) {
+        beginInsertRows(QModelIndex(), oldRows, rowCount() - 1);
+        endInsertRows();
+    }
+    if (columnCount() > oldColumns) {
+        beginInsertColumns(QModelIndex(), oldColumns, columnCount() - 1);
+        endInsertColumns();
+    }
+}
+
+
+bool SheetModel::apply(const Edit &edit)
+{
+    // Makes an edit again the way it was made, with the same checks
+    switch (edit.operation) {
+    case Edit::SetValues:
+        if (m_readOnly || edit.row < 0 || edit.column < 0 || edit.rows <= 0 || edit.columns <= 0 || edit.values.size() < edit.rows * edit.columns)
+            return false;
+        setValues(edit.row, edit.column, edit.rows, edit.columns, edit.values);
+        return true;
+    case Edit::InsertRows:
+        return insertRows(edit.row, edit.rows);
+    case Edit::RemoveRows:
+        return removeRows(edit.row, edit.rows);
+    case Edit::InsertColumns:
+        return insertColumns(edit.column, edit.columns);
+    case Edit::RemoveColumns:
+        return removeColumns(edit.column, edit.columns);
+    }
+
+    return false;
+}
+
+
+QString SheetModel::columnName(int column)
+{
+    QString name;
+
+    do {
+        name.prepend(QChar('A' + column % 26));
+        column = column / 26 - 1;
+    } while (column >= 0);
+
+    return name;
+}
@@ -0,0 +1,94 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SHEET_MODEL_H
+#define SHEET_MODEL_H
+
+#include <QAbstractTableModel>
+
+#include <QVector>
+
+#include "cell_value.h"
+
+class AbstractSheet;
+
+
+class SheetModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    // An edit made through the model, enough to make it again
+    struct Edit {
+        enum Operation : quint8 {
+            SetValues,
+            InsertRows,
+            RemoveRows,
+            InsertColumns,
+            RemoveColumns
+        };
+
+        Operation operation = SetValues;
+        int row = 0;
+        int column = 0;
+        int rows = 0;
+        int columns = 0;
+        QVector<CellValue> values;
+    };
+
+    explicit SheetModel(AbstractSheet *sheet, QObject *parent = nullptr);
+
+    void setSheet(AbstractSheet *sheet);
+
+    bool isReadOnly() const;
+    void setReadOnly(const bool readOnly);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+
+    bool insertRows(int row, int count, const QModelIndex &parent = QModelIndex()) override;
+    bool removeRows(int row, int count, const QModelIndex &parent = QModelIndex()) override;
+    bool insertColumns(int column, int count, const QModelIndex &parent = QModelIndex()) override;
+    bool removeColumns(int column, int count, const QModelIndex &parent = QModelIndex()) override;
+
+    QVector<CellValue> fetchRange(const int row, const int column, const int rows, const int columns) const;
+    void setValues(const int row, const int column, const int rows, const int columns, const QVector<CellValue> &values);
+    void updateExtent(const int oldRows, const int oldColumns);
+
+    bool apply(const Edit &edit);
+
+    static QString columnName(int column);
+
+signals:
+    void edited(const SheetModel::Edit &edit);
+
+private:
+    AbstractSheet *m_sheet;
+    bool m_readOnly;
+};
+
+#endif // SHEET_MODEL_H
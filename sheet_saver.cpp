@@ -0,0 +1,96 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "sheet_saver.h"
+
+#include "abstract_sheet.h"
+
+
+SheetSaver::SheetSaver(const QSharedPointer<const AbstractSheet> &sheet, const QString &fileName, QObject *parent)
+    : QThread(parent)
+    , m_sheet{sheet}
+    , m_fileName{fileName}
+    , m_failed{false}
+{
+
+}
+
+
+SheetSaver::~SheetSaver()
+{
+    // Closing the sheet finishes the file rather than leaving it unsaved
+    wait();
+}
+
+
+QString SheetSaver::fileName() const
+{
+    return m_fileName;
+}
+
+
+void SheetSaver::setDialect(const CsvDialect &dialect)
+{
+    m_writer.setDialect(dialect);
+}
+
+
+void SheetSaver::setThreadCount(const int count)
+{
+    m_writer.setThreadCount(count);
+}
+
+
+int SheetSaver::progress() const
+{
+    return m_writer.progress();
+}
+
+
+bool SheetSaver::isCancelled() const
+{
+    return m_writer.isCancelled();
+}
+
+
+bool SheetSaver::hasFailed() const
+{
+    return m_failed;
+}
+
+
+QString SheetSaver::errorString() const
+{
+    return m_writer.errorString();
+}
+
+
+void SheetSaver::cancel()
+{
+    m_writer.cancel();
+}
+
+
+void SheetSaver::run()
+{
+    m_failed = !m_writer.write(m_sheet.data(), m_fileName) && !m_writer.isCancelled();
+}
@@ -0,0 +1,67 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SHEET_SAVER_H
+#define SHEET_SAVER_H
+
+#include <QThread>
+
+#include <QSharedPointer>
+
+#include "csv_writer.h"
+
+class AbstractSheet;
+
+
+class SheetSaver : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit SheetSaver(const QSharedPointer<const AbstractSheet> &sheet, const QString &fileName, QObject *parent = nullptr);
+    ~SheetSaver() override;
+
+    QString fileName() const;
+
+    void setDialect(const CsvDialect &dialect);
+    void setThreadCount(const int count);
+
+    int progress() const;
+    bool isCancelled() const;
+    bool hasFailed() const;
+    QString errorString() const;
+
+public slots:
+    void cancel();
+
+protected:
+    void run() override;
+
+private:
+    // A snapshot, so that the sheet itself can be edited while it is saved
+    QSharedPointer<const AbstractSheet> m_sheet;
+    QString m_fileName;
+    CsvWriter m_writer;
+    bool m_failed;
+};
+
+#endif // SHEET_SAVER_H
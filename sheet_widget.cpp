@@ -0,0 +1,106 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "sheet_widget.h"
+
+#include <QHeaderView>
+#include <QItemSelectionModel>
+#include <QTableView>
+#include <QTimer>
+#include <QVBoxLayout>
+
+#include "sheet_model.h"
+
+
+SheetWidget::SheetWidget(const QSharedPointer<AbstractSheet> &sheet, QWidget *parent)
+    : QWidget(parent)
+    , m_sheet{sheet}
+    , m_model{new SheetModel(sheet.data(), this)}
+    , m_view{new QTableView}
+    , m_compactTimer{new QTimer(this)}
+{
+    setAttribute(Qt::WA_DeleteOnClose);
+
+    // Re-encode edited chunks once the user pauses
+    m_compactTimer->setSingleShot(true);
+    m_compactTimer->setInterval(5000);
+    connect(m_compactTimer, &QTimer::timeout, this, &SheetWidget::compactSheet);
+    connect(m_model, &SheetModel::edited, m_compactTimer, qOverload<>(&QTimer::start));
+
+    // Fixed section sizes keep the headers from measuring millions of rows
+    m_view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    m_view->verticalHeader()->setDefaultSectionSize(m_view->verticalHeader()->minimumSectionSize());
+    m_view->horizontalHeader()->setSectionResizeMode(QHeaderView::Interactive);
+    m_view->setWordWrap(false);
+    m_view->setModel(m_model);
+
+    // Main layout
+    auto *mainLayout = new QVBoxLayout;
+    mainLayout->setContentsMargins(0, 0, 0, 0);
+    mainLayout->addWidget(m_view);
+    setLayout(mainLayout);
+}
+
+
+AbstractSheet *SheetWidget::sheet() const
+{
+    return m_sheet.data();
+}
+
+
+SheetModel *SheetWidget::model() const
+{
+    return m_model;
+}
+
+
+void SheetWidget::compactSheet()
+{
+    // A sheet whose fill ratio crossed the line moves to the other storage
+    if (!m_model->isReadOnly()) {
+        if (AbstractSheet *sheet = m_sheet->converted()) {
+            m_sheet.reset(sheet);
+            m_model->setSheet(sheet);
+            return;
+        }
+    }
+
+    m_sheet->compact();
+}
+
+
+QRect SheetWidget::selectedRange() const
+{
+    // Bounding rectangle of the selection, or the current cell without one;
+    // x and y are the column and the row
+    const QItemSelection selection = m_view->selectionModel()->selection();
+    if (selection.isEmpty()) {
+        const QModelIndex current = m_view->currentIndex();
+        return current.isValid() ? QRect(current.column(), current.row(), 1, 1) : QRect();
+    }
+
+    QRect range;
+    for (const QItemSelectionRange &part : selection)
+        range |= QRect(QPoint(part.left(), part.top()), QPoint(part.right(), part.bottom()));
+
+    return range;
+}
@@ -0,0 +1,62 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SHEET_WIDGET_H
+#define SHEET_WIDGET_H
+
+#include <QWidget>
+
+#include <QRect>
+#include <QSharedPointer>
+
+#include "abstract_sheet.h"
+
+class QTableView;
+class QTimer;
+
+class SheetModel;
+
+
+class SheetWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit SheetWidget(const QSharedPointer<AbstractSheet> &sheet, QWidget *parent = nullptr);
+
+    AbstractSheet *sheet() const;
+    SheetModel *model() const;
+
+    void compactSheet();
+
+    QRect selectedRange() const;
+
+private:
+    QSharedPointer<AbstractSheet> m_sheet;
+
+    SheetModel *m_model;
+    QTableView *m_view;
+
+    QTimer *m_compactTimer;
+};
+
+#endif // SHEET_WIDGET_H
@@ -0,0 +1,254 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "sparse_sheet.h"
+
+
+SparseSheet::SparseSheet(const QSharedPointer<StringPool> &pool)
+    : AbstractSheet(pool)
+    , m_cellCount{0}
+{
+
+}
+
+
+AbstractSheet *SparseSheet::clone() const
+{
+    // Storage is implicitly shared and only detaches once either side writes
+    return new SparseSheet(*this);
+}
+
+
+qint64 SparseSheet::cellCount() const
+{
+    return m_cellCount;
+}
+
+
+int SparseSheet::blockCount() const
+{
+    return m_blocks.size();
+}
+
+
+qint64 SparseSheet::indexBytes() const
+{
+    // Buckets and node headers of the block hash
+    return m_blocks.capacity() * qint64(sizeof(void *)) + m_blocks.size() * qint64(sizeof(quint64) + sizeof(void *));
+}
+
+
+//
+// Blocks
+//
+
+quint64 SparseSheet::blockKey(const int row, const int column)
+{
+    return (quint64(quint32(row / BlockRows)) << 32) | quint32(column / BlockColumns);
+}
+
+
+int SparseSheet::blockSlot(const int row, const int column)
+{
+    return (row % BlockRows) * BlockColumns + (column % BlockColumns);
+}
+
+
+int SparseSheet::Block::rank(const int slot) const
+{
+    int rank = 0;
+    for (int word = 0; word < (slot >> 6); ++word)
+        rank += qPopulationCount(occupancy[word]);
+
+    return rank + qPopulationCount(occupancy[slot >> 6] & ((Q_UINT64_C(1) << (slot & 63)) - 1));
+}
+
+
+bool SparseSheet::Block::contains(const int slot) const
+{
+    return occupancy[slot >> 6] & (Q_UINT64_C(1) << (slot & 63));
+}
+
+
+int SparseSheet::Block::removeIf(const std::function<bool(const int slot)> &predicate)
+{
+    // Compact the packed values in a single pass
+    int index = 0;
+    int kept = 0;
+    for (int word = 0; word < BlockWords; ++word) {
+
+        quint64 bits = occupancy[word];
+        while (bits) {
+            const int bit = qCountTrailingZeroBits(bits);
+            bits &= bits - 1;
+
+            if (predicate(word * 64 + bit)) {
+                occupancy[word] &= ~(Q_UINT64_C(1) << bit);
+            }
+            else {
+                values[kept] = values.at(index);
+                ++kept;
+            }
+            ++index;
+        }
+    }
+
+    values.resize(kept);
+
+    return index - kept;
+}
+
+
+//
+// Cells
+//
+
+CellValue SparseSheet::storedCell(const int row, const int column) const
+{
+    auto it = m_blocks.constFind(blockKey(row, column));
+    if (it == m_blocks.constEnd())
+        return CellValue();
+
+    const Block &block = it.value();
+    const int slot = blockSlot(row, column);
+    if (!block.contains(slot))
+        return CellValue();
+
+    return block.values.at(block.rank(slot));
+}
+
+
+void SparseSheet::setStoredCell(const int row, const int column, const CellValue &value)
+{
+    const quint64 key = blockKey(row, column);
+    const int slot = blockSlot(row, column);
+    const quint64 bit = Q_UINT64_C(1) << (slot & 63);
+
+    if (value.isEmpty()) {
+        // Clearing a cell; drop the block once it holds nothing
+        auto it = m_blocks.find(key);
+        if (it == m_blocks.end() || !it.value().contains(slot))
+            return;
+
+        Block &block = it.value();
+        block.values.remove(block.rank(slot));
+        block.occupancy[slot >> 6] &= ~bit;
+        addStorageBytes(-qint64(sizeof(CellValue)));
+        --m_cellCount;
+
+        if (block.values.isEmpty()) {
+            m_blocks.erase(it);
+            addStorageBytes(-qint64(sizeof(Block)));
+        }
+        return;
+    }
+
+    // Short text stays inline; only long text refers to the pool
+    const CellValue stored = value.toInline(stringPool().data());
+
+    if (!m_blocks.contains(key))
+        addStorageBytes(sizeof(Block));
+
+    Block &block = m_blocks[key];
+    const int index = block.rank(slot);
+    if (block.contains(slot)) {
+        block.values[index] = stored;
+    }
+    else {
+        block.values.insert(index, stored);
+        block.occupancy[slot >> 6] |= bit;
+        addStorageBytes(sizeof(CellValue));
+        ++m_cellCount;
+    }
+}
+
+
+void SparseSheet::forEachStoredCell(const CellVisitor &visitor) const
+{
+    // Only occupied blocks are stored, so this runs in O(occupied cells)
+    for (auto it = m_blocks.constBegin(); it != m_blocks.constEnd(); ++it) {
+
+        const int firstRow = int(it.key() >> 32) * BlockRows;
+        const int firstColumn = int(it.key() & 0xffffffff) * BlockColumns;
+        const Block &block = it.value();
+
+        int index = 0;
+        for (int word = 0; word < BlockWords; ++word) {
+
+            quint64 bits = block.occupancy[word];
+            while (bits) {
+                const int slot = word * 64 + qCountTrailingZeroBits(bits);
+                bits &= bits - 1;
+
+                visitor(firstRow + slot / BlockColumns, firstColumn + slot % BlockColumns, block.values.at(index));
+                ++index;
+            }
+        }
+    }
+}
+
+
+//
+// Rows and columns
+//
+
+void SparseSheet::clearStoredRows(const int row, const int count)
+{
+    clearStored(true, row, count);
+}
+
+
+void SparseSheet::clearStoredColumns(const int column, const int count)
+{
+    clearStored(false, column, count);
+}
+
+
+void SparseSheet::clearStored(const bool rows, const int first, const int count)
+{
+    const int size = rows ? BlockRows : BlockColumns;
+
+    for (auto it = m_blocks.begin(); it != m_blocks.end(); ) {
+
+        // Skip blocks that do not overlap the cleared range
+        const int blockFirst = int(rows ? it.key() >> 32 : it.key() & 0xffffffff) * size;
+        if (blockFirst + size <= first || blockFirst >= first + count) {
+            ++it;
+            continue;
+        }
+
+        const int removed = it.value().removeIf([=](const int slot) {
+            const int position = blockFirst + (rows ? slot / BlockColumns : slot % BlockColumns);
+            return position >= first && position < first + count;
+        });
+        m_cellCount -= removed;
+        addStorageBytes(-removed * qint64(sizeof(CellValue)));
+
+        if (it.value().values.isEmpty()) {
+            it = m_blocks.erase(it);
+            addStorageBytes(-qint64(sizeof(Block)));
+        }
+        else {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,78 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPARSE_SHEET_H
+#define SPARSE_SHEET_H
+
+#include "abstract_sheet.h"
+
+#include <QHash>
+#include <QVector>
+
+#include <functional>
+
+
+class SparseSheet : public AbstractSheet
+{
+public:
+    static constexpr int BlockRows = 32;
+    static constexpr int BlockColumns = 32;
+
+    explicit SparseSheet(const QSharedPointer<StringPool> &pool);
+
+    AbstractSheet *clone() const override;
+
+    qint64 cellCount() const override;
+
+    int blockCount() const;
+
+protected:
+    CellValue storedCell(const int row, const int column) const override;
+    void setStoredCell(const int row, const int column, const CellValue &value) override;
+    void forEachStoredCell(const CellVisitor &visitor) const override;
+    void clearStoredRows(const int row, const int count) override;
+    void clearStoredColumns(const int column, const int count) override;
+    qint64 indexBytes() const override;
+
+private:
+    static constexpr int BlockWords = BlockRows * BlockColumns / 64;
+
+    struct Block {
+        quint64 occupancy[BlockWords] = {};
+        QVector<CellValue> values;
+
+        int rank(const int slot) const;
+        bool contains(const int slot) const;
+        int removeIf(const std::function<bool(const int slot)> &predicate);
+    };
+
+    static quint64 blockKey(const int row, const int column);
+    static int blockSlot(const int row, const int column);
+
+    void clearStored(const bool rows, const int first, const int count);
+
+    qint64 m_cellCount;
+
+    QHash<quint64, Block> m_blocks;
+};
+
+#endif // SPARSE_SHEET_H
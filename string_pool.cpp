@@ -0,0 +1,331 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "string_pool.h"
+
+#include <QReadLocker>
+#include <QVarLengthArray>
+#include <QWriteLocker>
+
+#include <climits>
+#include <cstring>
+
+
+StringPool::StringPool(const QSharedPointer<Arena> &arena)
+    : m_arena{arena}
+    , m_bytes{0}
+{
+    rehash(1024);
+}
+
+
+uint StringPool::hashOf(QStringView text)
+{
+    return uint(qHash(text));
+}
+
+
+quint32 StringPool::intern(QStringView text)
+{
+    quint32 id;
+    if (find(text, &id))
+        return id;
+
+    const uint hash = hashOf(text);
+
+    QWriteLocker locker(&m_lock);
+
+    // Another thread may have added the string in the meantime
+    int slot = slotOf(text, hash);
+    if (m_slots.at(slot))
+        return m_slots.at(slot) - 1;
+
+    // The characters live in the document arena and are never moved
+    auto *data = m_arena->allocateArray<QChar>(qMax(qsizetype(text.size()), qsizetype(1)));
+    std::memcpy(static_cast<void *>(data), text.data(), size_t(text.size()) * sizeof(QChar));
+
+    id = quint32(m_entries.size());
+    m_entries.append({data, int(text.size()), hash});
+    m_slots[slot] = id + 1;
+    m_bytes += text.size() * qint64(sizeof(QChar)) + qint64(sizeof(Entry));
+
+    // Keep the load factor at or below one half
+    if (m_entries.size() * 2 > m_slots.size())
+        rehash(m_slots.size() * 2);
+
+    return id;
+}
+
+
+quint32 StringPool::internUtf8(const char *data, const int size)
+{
+    // Decodes on the stack for all but very long text, so that loaders
+    // never build a QString per field
+    QVarLengthArray<QChar, 256> buffer(qMax(size, 1));
+    const int length = decodeUtf8(data, size, buffer.data());
+
+    return intern(QStringView(buffer.constData(), length));
+}
+
+
+int StringPool::decodeUtf8(const char *data, const int size, QChar *target)
+{
+    const auto *bytes = reinterpret_cast<const uchar *>(data);
+    QChar *out = target;
+
+    for (int index = 0; index < size; ) {
+
+        const uchar lead = bytes[index];
+        if (lead < 0x80) {
+            *out++ = QChar(lead);
+            ++index;
+            continue;
+        }
+
+        int length = 0;
+        uint code = 0;
+        if ((lead & 0xe0) == 0xc0) {
+            length = 2;
+            code = lead & 0x1f;
+        }
+        else if ((lead & 0xf0) == 0xe0) {
+            length = 3;
+            code = lead & 0x0f;
+        }
+        else if ((lead & 0xf8) == 0xf0) {
+            length = 4;
+            code = lead & 0x07;
+        }
+
+        bool valid = length && index + length <= size;
+        for (int offset = 1; valid && offset < length; ++offset) {
+            valid = (bytes[index + offset] & 0xc0) == 0x80;
+            code = (code << 6) | (bytes[index + offset] & 0x3f);
+        }
+
+        // Overlong forms, surrogates and out of range values are invalid too
+        static const uint minimum[] = {0, 0, 0x80, 0x800, 0x10000};
+        if (!valid || code < minimum[length] || code > 0x10ffff || (code >= 0xd800 && code <= 0xdfff)) {
+            *out++ = QChar(QChar::ReplacementCharacter);
+            ++index;
+            continue;
+        }
+
+        if (code >= 0x10000) {
+            *out++ = QChar(QChar::highSurrogate(code));
+            *out++ = QChar(QChar::lowSurrogate(code));
+        }
+        else {
+            *out++ = QChar(char16_t(code));
+        }
+        index += length;
+    }
+
+    return int(out - target);
+}
+
+
+bool StringPool::find(QStringView text, quint32 *id) const
+{
+    const uint hash = hashOf(text);
+
+    QReadLocker locker(&m_lock);
+
+    const quint32 value = m_slots.at(slotOf(text, hash));
+    if (!value)
+        return false;
+
+    *id = value - 1;
+    return true;
+}
+
+
+QString StringPool::string(const quint32 id) const
+{
+    return view(id).toString();
+}
+
+
+QStringView StringPool::view(const quint32 id) const
+{
+    QReadLocker locker(&m_lock);
+
+    if (id >= quint32(m_entries.size()))
+        return QStringView();
+
+    const Entry &entry = m_entries.at(int(id));
+    return QStringView(entry.data, entry.size);
+}
+
+
+int StringPool::count() const
+{
+    QReadLocker locker(&m_lock);
+
+    return m_entries.size();
+}
+
+
+qint64 StringPool::byteSize() const
+{
+    QReadLocker locker(&m_lock);
+
+    return m_bytes + m_slots.size() * qint64(sizeof(quint32));
+}
+
+
+//
+// Persistence
+//
+
+void StringPool::exportTable(const int first, QVector<Record> *records, QVector<quint32> *hashSlots) const
+{
+    // Taken under one lock, so that the slots never name a later string
+    QReadLocker locker(&m_lock);
+
+    records->resize(qMax(m_entries.size() - first, 0));
+
+    // Offsets count from the first string exported
+    qint64 offset = 0;
+    for (int id = first; id < m_entries.size(); ++id) {
+        const Entry &entry = m_entries.at(id);
+        (*records)[id - first] = {offset, qint32(entry.size), entry.hash};
+        offset += entry.size;
+    }
+
+    if (hashSlots)
+        *hashSlots = m_slots;
+}
+
+
+bool StringPool::restore(const QVector<Segment> &segments, const quint32 *hashSlots, const int slotCount)
+{
+    QWriteLocker locker(&m_lock);
+
+    // Only a pool nobody has used yet can take over a stored one
+    if (!m_entries.isEmpty())
+        return false;
+
+    qint64 count = 0;
+    for (const Segment &segment : segments)
+        count += segment.count;
+    if (count > INT_MAX / 2)
+        return false;
+
+    QVector<Entry> entries;
+    entries.reserve(int(count));
+    qint64 bytes = 0;
+    for (const Segment &segment : segments) {
+        for (int index = 0; index < segment.count; ++index) {
+            const Record &record = segment.records[index];
+            if (record.offset < 0 || record.size < 0 || record.offset + record.size > segment.length)
+                return false;
+
+            entries.append({segment.characters + record.offset, int(record.size), record.hash});
+            bytes += record.size * qint64(sizeof(QChar)) + qint64(sizeof(Entry));
+        }
+    }
+
+    // Slots are only taken over if they name every string exactly once and
+    // leave room for probes to end; any other table is rebuilt
+    bool validSlots = hashSlots && slotCount >= 2 && !(slotCount & (slotCount - 1)) && count * 2 <= slotCount;
+    if (validSlots) {
+        QVector<bool> named(int(count), false);
+        int empty = 0;
+        for (int slot = 0; slot < slotCount && validSlots; ++slot) {
+            const quint32 value = hashSlots[slot];
+            if (!value)
+                ++empty;
+            else if (value > quint32(count) || named.at(int(value - 1)))
+                validSlots = false;
+            else
+                named[int(value - 1)] = true;
+        }
+        validSlots = validSlots && empty > 0 && slotCount - empty == count;
+    }
+
+    // Stored hashes are only valid if strings still hash the same way; a
+    // few samples tell
+    bool rehashed = false;
+    const int step = qMax(1, entries.size() / 64);
+    for (int id = 0; id < entries.size() && !rehashed; id += step)
+        rehashed = hashOf(QStringView(entries.at(id).data, entries.at(id).size)) != entries.at(id).hash;
+
+    if (rehashed) {
+        for (Entry &entry : entries)
+            entry.hash = hashOf(QStringView(entry.data, entry.size));
+    }
+
+    m_entries = entries;
+    m_bytes = bytes;
+
+    if (rehashed || !validSlots) {
+        int capacity = 1024;
+        while (capacity < m_entries.size() * 2)
+            capacity *= 2;
+        rehash(capacity);
+    }
+    else {
+        m_slots.resize(slotCount);
+        std::memcpy(m_slots.data(), hashSlots, size_t(slotCount) * sizeof(quint32));
+    }
+
+    return true;
+}
+
+
+//
+// Hash table
+//
+
+int StringPool::slotOf(QStringView text, const uint hash) const
+{
+    // Open addressing with linear probing over a power of two table
+    const int mask = m_slots.size() - 1;
+
+    for (int slot = int(hash) & mask; ; slot = (slot + 1) & mask) {
+
+        const quint32 value = m_slots.at(slot);
+        if (!value)
+            return slot;
+
+        const Entry &entry = m_entries.at(int(value - 1));
+        if (entry.hash == hash && QStringView(entry.data, entry.size) == text)
+            return slot;
+    }
+}
+
+
+void StringPool::rehash(const int capacity)
+{
+    m_slots.fill(0, capacity);
+
+    const int mask = capacity - 1;
+    for (int id = 0; id < m_entries.size(); ++id) {
+
+        int slot = int(m_entries.at(id).hash) & mask;
+        while (m_slots.at(slot))
+            slot = (slot + 1) & mask;
+
+        m_slots[slot] = quint32(id) + 1;
+    }
+}
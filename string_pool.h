@@ -0,0 +1,90 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef STRING_POOL_H
+#define STRING_POOL_H
+
+#include <QReadWriteLock>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringView>
+#include <QVector>
+
+#include "arena.h"
+
+
+class StringPool
+{
+public:
+    // One per string in workbook files; offset and size count characters
+    struct Record {
+        qint64 offset;
+        qint32 size;
+        quint32 hash;
+    };
+
+    // Strings stored back to back, as added by one save
+    struct Segment {
+        const QChar *characters;
+        qint64 length;
+        const Record *records;
+        int count;
+    };
+
+    explicit StringPool(const QSharedPointer<Arena> &arena);
+
+    quint32 intern(QStringView text);
+    quint32 internUtf8(const char *data, const int size);
+    bool find(QStringView text, quint32 *id) const;
+    QString string(const quint32 id) const;
+    QStringView view(const quint32 id) const;
+
+    int count() const;
+    qint64 byteSize() const;
+
+    void exportTable(const int first, QVector<Record> *records, QVector<quint32> *hashSlots) const;
+    bool restore(const QVector<Segment> &segments, const quint32 *hashSlots, const int slotCount);
+
+private:
+    Q_DISABLE_COPY(StringPool)
+
+    struct Entry {
+        const QChar *data;
+        int size;
+        uint hash;
+    };
+
+    static uint hashOf(QStringView text);
+    static int decodeUtf8(const char *data, const int size, QChar *target);
+
+    int slotOf(QStringView text, const uint hash) const;
+    void rehash(const int capacity);
+
+    mutable QReadWriteLock m_lock;
+
+    QSharedPointer<Arena> m_arena;
+    QVector<Entry> m_entries;
+    QVector<quint32> m_slots;
+    qint64 m_bytes;
+};
+
+#endif // STRING_POOL_H
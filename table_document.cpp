@@ -22,14 +22,37 @@
 
 #include "table_document.h"
 
+#include <QAction>
+#include <QClipboard>
+#include <QDir>
+#include <QGuiApplication>
+#include <QHBoxLayout>
+#include <QMessageBox>
+#include <QProgressBar>
 #include <QSettings>
+#include <QSignalBlocker>
 #include <QTabBar>
+#include <QTimer>
+#include <QToolButton>
 #include <QVBoxLayout>
 
+#include "abstract_sheet.h"
+#include "arena.h"
+#include "columnar_sheet.h"
+#include "sheet_loader.h"
+#include "sheet_saver.h"
+#include "sheet_model.h"
+#include "sheet_widget.h"
+#include "string_pool.h"
+
 
 TableDocument::TableDocument(QWidget *parent)
     : QWidget(parent)
     , m_tabs{new QTabWidget}
+    , m_arena{new Arena}
+    , m_stringPool{new StringPool(m_arena)}
+    , m_idleTimer{new QTimer(this)}
+    , m_clipboardColumns{0}
     , m_tabBarVisible{true}
 {
     m_tabs->setDocumentMode(true);
@@ -37,6 +60,34 @@ TableDocument::TableDocument(QWidget *parent)
     m_tabs->setTabPosition(QTabWidget::South);
     m_tabs->setTabBarAutoHide(true);
     connect(m_tabs, &QTabWidget::tabCloseRequested, this, &TableDocument::slotCloseTab);
+    connect(m_tabs->tabBar(), &QTabBar::tabMoved, this, &TableDocument::sheetMoved);
+
+    // Queued, so that tabs are never swapped while one is being added
+    connect(m_tabs, &QTabWidget::currentChanged, this, &TableDocument::slotDecodeSheet, Qt::QueuedConnection);
+
+    // Runs whenever no events are waiting, one pending sheet at a time
+    m_idleTimer->setSingleShot(true);
+    m_idleTimer->setInterval(0);
+    connect(m_idleTimer, &QTimer::timeout, this, &TableDocument::slotDecodeIdleSheet);
+
+    // Clipboard
+    auto *actionCopy = new QAction(this);
+    actionCopy->setShortcut(QKeySequence::Copy);
+    actionCopy->setShortcutContext(Qt::WidgetWithChildrenShortcut);
+    connect(actionCopy, &QAction::triggered, this, &TableDocument::copy);
+    addAction(actionCopy);
+
+    auto *actionCut = new QAction(this);
+    actionCut->setShortcut(QKeySequence::Cut);
+    actionCut->setShortcutContext(Qt::WidgetWithChildrenShortcut);
+    connect(actionCut, &QAction::triggered, this, &TableDocument::cut);
+    addAction(actionCut);
+
+    auto *actionPaste = new QAction(this);
+    actionPaste->setShortcut(QKeySequence::Paste);
+    actionPaste->setShortcutContext(Qt::WidgetWithChildrenShortcut);
+    connect(actionPaste, &QAction::triggered, this, &TableDocument::paste);
+    addAction(actionPaste);
 
     loadSettings();
 
@@ -85,6 +136,35 @@ void TableDocument::saveSettings()
 }
 
 
+QVariantMap TableDocument::documentSettings() const
+{
+    // The settings a workbook file carries, under the keys of the preferences
+    QVariantMap settings;
+    settings.insert(QStringLiteral("SheetTabBarVisible"), isTabBarVisible());
+    settings.insert(QStringLiteral("SheetTabBarPosition"), int(tabBarPosition()));
+    settings.insert(QStringLiteral("SheetTabBarAutoHide"), isTabBarAutoHide());
+
+    return settings;
+}
+
+
+void TableDocument::setDocumentSettings(const QVariantMap &settings)
+{
+    if (settings.contains(QStringLiteral("SheetTabBarVisible")))
+        setTabBarVisible(settings.value(QStringLiteral("SheetTabBarVisible")).toBool());
+
+    if (settings.contains(QStringLiteral("SheetTabBarPosition"))) {
+        const int value = settings.value(QStringLiteral("SheetTabBarPosition")).toInt();
+        const QList<int> values = {QTabWidget::North, QTabWidget::South};
+        if (values.contains(value))
+            setTabBarPosition(static_cast<QTabWidget::TabPosition>(value));
+    }
+
+    if (settings.contains(QStringLiteral("SheetTabBarAutoHide")))
+        setTabBarAutoHide(settings.value(QStringLiteral("SheetTabBarAutoHide")).toBool());
+}
+
+
 //
 // Property: tabBarVisible
 //
@@ -192,34 +272,488 @@ void TableDocument::initTabBarAutoHide()
 
 
 //
-// Slots
+// Sheets
 //
 
-void TableDocument::slotAddTab(const int count)
+int TableDocument::sheetCount() const
 {
-    if (!m_tabs->count()) {
+    return m_tabs->count();
+}
+
+
+AbstractSheet *TableDocument::sheet(const int index) const
+{
+    QWidget *widget = m_tabs->widget(index);
+    if (auto *sheetWidget = qobject_cast<SheetWidget *>(widget))
+        return sheetWidget->sheet();
+
+    // Null until a pending sheet has been decoded
+    return m_pendingSheets.value(widget).sheet.data();
+}
+
+
+AbstractSheet *TableDocument::currentSheet() const
+{
+    return sheet(m_tabs->currentIndex());
+}
 
-        for (int i = 1; i <= count; ++i) {
-            auto widget = new QWidget;
-            widget->setAttribute(Qt::WA_DeleteOnClose);
-            m_tabs->addTab(widget, tr("Sheet %1").arg(i));
+
+int TableDocument::currentSheetIndex() const
+{
+    return m_tabs->currentIndex();
+}
+
+
+QString TableDocument::sheetName(const int index) const
+{
+    return m_tabs->tabText(index);
+}
+
+
+void TableDocument::addSheet(const QSharedPointer<AbstractSheet> &sheet, const QString &name)
+{
+    m_tabs->addTab(createSheetWidget(sheet), name);
+    m_tabs->setTabsClosable(m_tabs->count() > 1);
+}
+
+
+void TableDocument::addPendingSheet(const SheetDecoder &decoder, const QString &name)
+{
+    auto *placeholder = new QWidget;
+    m_pendingSheets.insert(placeholder, {decoder, QSharedPointer<AbstractSheet>()});
+
+    // The first tab becomes current and is decoded right after
+    m_tabs->addTab(placeholder, name);
+    m_tabs->setTabsClosable(m_tabs->count() > 1);
+
+    m_idleTimer->start();
+}
+
+
+QSharedPointer<AbstractSheet> TableDocument::decodePendingSheet(QWidget *placeholder)
+{
+    PendingSheet &pending = m_pendingSheets[placeholder];
+    if (!pending.sheet) {
+        pending.sheet = pending.decoder();
+
+        // A damaged sheet leaves an empty one behind
+        if (!pending.sheet) {
+            pending.sheet.reset(new ColumnarSheet(m_stringPool));
+
+            const QString title = tr("Could Not Read Sheet");
+            const QString text = tr("The sheet <em>%1</em> is damaged and could not be read.").arg(m_tabs->tabText(m_tabs->indexOf(placeholder)));
+            QMessageBox::warning(this, title, text);
         }
+    }
 
-        m_tabs->setTabsClosable(m_tabs->count() > 1);
+    return pending.sheet;
+}
+
+
+void TableDocument::slotDecodeSheet(const int index)
+{
+    if (index == m_tabs->currentIndex() && m_pendingSheets.contains(m_tabs->widget(index)))
+        sheetWidget(index);
+}
+
+
+void TableDocument::slotDecodeIdleSheet()
+{
+    // Only the storage is decoded, in tab order; widgets wait for the tab
+    // to be shown
+    for (int index = 0; index < m_tabs->count(); ++index) {
+        const auto pending = m_pendingSheets.constFind(m_tabs->widget(index));
+        if (pending != m_pendingSheets.constEnd() && !pending->sheet) {
+            decodePendingSheet(m_tabs->widget(index));
+            m_idleTimer->start();
+            return;
+        }
     }
 }
 
 
-void TableDocument::slotCloseTab(const int index)
+void TableDocument::loadSheet(SheetLoader *loader, const QString &name)
 {
-    if (m_tabs->count() > 1) {
+    // The tab opens right away and fills while the loader runs; until it
+    // is done the sheet can be browsed but not edited
+    QSharedPointer<ColumnarSheet> sheet(new ColumnarSheet(m_stringPool));
+    auto *widget = createSheetWidget(sheet);
+    widget->model()->setReadOnly(true);
+    loader->setParent(widget);
+
+    m_tabs->addTab(widget, name);
+    m_tabs->setTabsClosable(m_tabs->count() > 1);
+
+    QWidget *indicator = addProgressIndicator(widget, tr("Loading: %1%"), tr("Stop loading and keep the rows read so far"),
+                                              [loader]() { return loader->progress(); }, [loader]() { loader->cancel(); });
+
+    ColumnarSheet *columnarSheet = sheet.data();
+    const auto appendRows = [widget, loader, columnarSheet]() {
+        SheetModel *model = widget->model();
+        const int rows = model->rowCount();
+        const int columns = model->columnCount();
+
+        for (const SheetLoader::Batch &batch : loader->takeBatches()) {
+            if (columnarSheet->columnTitles().isEmpty() && !batch.titles.isEmpty())
+                columnarSheet->setColumnTitles(batch.titles);
+            columnarSheet->appendChunks(batch.windows, batch.rows, batch.columns, batch.firstRow);
+        }
 
-        auto widget = m_tabs->widget(index);
-        if (widget) {
-            widget->close();
-            m_tabs->removeTab(index);
+        model->updateExtent(rows, columns);
+    };
+    connect(loader, &SheetLoader::rowsAvailable, widget, appendRows);
+
+    connect(loader, &QThread::finished, widget, [this, widget, loader, indicator, appendRows]() {
+        appendRows();
+        widget->model()->setReadOnly(false);
+        widget->compactSheet();
+        removeProgressIndicator(widget, indicator);
+
+        if (loader->hasFailed()) {
+            const QString title = tr("Could Not Load Sheet");
+            const QString text = tr("The file <em>%1</em> could only be read in part.<br>%2").arg(QDir::toNativeSeparators(loader->fileName()), loader->errorString());
+            QMessageBox::warning(this, title, text);
+        }
+
+        loader->deleteLater();
+
+        emit sheetLoaded(m_tabs->indexOf(widget));
+    });
+
+    loader->start();
+}
+
+
+void TableDocument::saveSheet(SheetSaver *saver, const int index)
+{
+    // The saver works on a snapshot, so the sheet stays editable meanwhile
+    auto *widget = qobject_cast<SheetWidget *>(m_tabs->widget(index));
+    saver->setParent(widget);
+
+    QWidget *indicator = addProgressIndicator(widget, tr("Saving: %1%"), tr("Stop saving and keep the file as it was"),
+                                              [saver]() { return saver->progress(); }, [saver]() { saver->cancel(); });
+
+    connect(saver, &QThread::finished, widget, [this, widget, saver, indicator]() {
+        removeProgressIndicator(widget, indicator);
+
+        if (saver->hasFailed()) {
+            const QString title = tr("Could Not Save Sheet");
+            const QString text = tr("The file <em>%1</em> could not be written.<br>%2").arg(QDir::toNativeSeparators(saver->fileName()), saver->errorString());
+            QMessageBox::warning(this, title, text);
         }
 
+        saver->deleteLater();
+    });
+
+    saver->start();
+}
+
+
+bool TableDocument::isSheetBusy(const int index) const
+{
+    return m_tabs->tabBar()->tabButton(index, QTabBar::LeftSide) != nullptr;
+}
+
+
+void TableDocument::moveSheet(const int from, const int to)
+{
+    // Reported through the tab bar, just like a tab dragged by the user
+    if (from != to && from >= 0 && to >= 0 && from < m_tabs->count() && to < m_tabs->count())
+        m_tabs->tabBar()->moveTab(from, to);
+}
+
+
+void TableDocument::closeSheet(const int index)
+{
+    if (m_tabs->count() > 1 && index >= 0 && index < m_tabs->count()) {
+
+        auto widget = m_tabs->widget(index);
+        widget->close();
+        m_tabs->removeTab(index);
+
+        if (m_pendingSheets.remove(widget))
+            widget->deleteLater();
+
         m_tabs->setTabsClosable(m_tabs->count() > 1);
+
+        emit sheetClosed(index);
     }
 }
+
+
+SheetModel *TableDocument::sheetModel(const int index)
+{
+    SheetWidget *widget = sheetWidget(index);
+    return widget ? widget->model() : nullptr;
+}
+
+
+QWidget *TableDocument::addProgressIndicator(QWidget *widget, const QString &status, const QString &stopToolTip, const std::function<int()> &progress, const std::function<void()> &stop)
+{
+    // Progress and a way to stop early live in the tab itself
+    auto *progressBar = new QProgressBar;
+    progressBar->setRange(0, 100);
+    progressBar->setTextVisible(false);
+    progressBar->setFixedSize(48, 8);
+
+    auto *stopButton = new QToolButton;
+    stopButton->setAutoRaise(true);
+    stopButton->setIcon(QIcon::fromTheme(QStringLiteral("process-stop"), QIcon(QStringLiteral(":/icons/actions/16/process-stop.svg"))));
+    stopButton->setToolTip(stopToolTip);
+
+    auto *indicatorLayout = new QHBoxLayout;
+    indicatorLayout->setContentsMargins(0, 0, 0, 0);
+    indicatorLayout->setSpacing(2);
+    indicatorLayout->addWidget(progressBar);
+    indicatorLayout->addWidget(stopButton);
+
+    auto *indicator = new QWidget;
+    indicator->setLayout(indicatorLayout);
+    m_tabs->tabBar()->setTabButton(m_tabs->indexOf(widget), QTabBar::LeftSide, indicator);
+
+    connect(stopButton, &QToolButton::clicked, indicator, stop);
+
+    // Workers only keep a counter, so the tab simply polls it
+    auto *timer = new QTimer(indicator);
+    connect(timer, &QTimer::timeout, indicator, [this, widget, progressBar, status, progress]() {
+        const int value = progress();
+        progressBar->setValue(value);
+        m_tabs->setTabToolTip(m_tabs->indexOf(widget), status.arg(value));
+    });
+    timer->start(100);
+
+    return indicator;
+}
+
+
+void TableDocument::removeProgressIndicator(QWidget *widget, QWidget *indicator)
+{
+    const int index = m_tabs->indexOf(widget);
+    m_tabs->tabBar()->setTabButton(index, QTabBar::LeftSide, nullptr);
+    m_tabs->setTabToolTip(index, QString());
+    indicator->deleteLater();
+}
+
+
+QSharedPointer<const AbstractSheet> TableDocument::snapshotSheet(const int index) const
+{
+    const AbstractSheet *sheet = this->sheet(index);
+    if (!sheet) {
+        // A sheet that was never decoded is decoded just for the snapshot
+        const auto pending = m_pendingSheets.constFind(m_tabs->widget(index));
+        if (pending != m_pendingSheets.constEnd())
+            return pending->decoder();
+
+        return QSharedPointer<const AbstractSheet>();
+    }
+
+    return QSharedPointer<const AbstractSheet>(sheet->clone());
+}
+
+
+bool TableDocument::snapshot(WorkbookSnapshot *snapshot, QString *errorString) const
+{
+    // Copy-on-write clones; chunks are only duplicated once an edit touches them.
+    // A sheet that cannot be decoded fails the snapshot, since a workbook
+    // saved without it would lose the sheet for good
+    for (int index = 0; index < sheetCount(); ++index) {
+        const QSharedPointer<const AbstractSheet> sheet = snapshotSheet(index);
+        if (!sheet) {
+            if (errorString)
+                *errorString = tr("The sheet <em>%1</em> is damaged and could not be read.").arg(sheetName(index));
+            return false;
+        }
+
+        snapshot->addSheet(sheetName(index), sheet);
+    }
+
+    return true;
+}
+
+
+QSharedPointer<Arena> TableDocument::arena() const
+{
+    return m_arena;
+}
+
+
+QSharedPointer<StringPool> TableDocument::stringPool() const
+{
+    return m_stringPool;
+}
+
+
+MemoryUsage TableDocument::memoryUsage() const
+{
+    // Only sums counters the storage keeps up to date
+    MemoryUsage usage;
+    for (int index = 0; index < sheetCount(); ++index) {
+        if (const AbstractSheet *sheet = this->sheet(index))
+            sheet->addMemoryUsage(usage);
+    }
+    usage.add(MemoryUsage::StringPool, m_stringPool->byteSize());
+
+    return usage;
+}
+
+
+//
+// Clipboard
+//
+
+SheetWidget *TableDocument::currentSheetWidget() const
+{
+    return qobject_cast<SheetWidget *>(m_tabs->currentWidget());
+}
+
+
+SheetWidget *TableDocument::createSheetWidget(const QSharedPointer<AbstractSheet> &sheet)
+{
+    // Edits are reported with the position the tab has at the time
+    auto *widget = new SheetWidget(sheet);
+    connect(widget->model(), &SheetModel::edited, this, [this, widget](const SheetModel::Edit &edit) {
+        emit sheetEdited(m_tabs->indexOf(widget), edit);
+    });
+
+    return widget;
+}
+
+
+SheetWidget *TableDocument::sheetWidget(const int index)
+{
+    QWidget *placeholder = m_tabs->widget(index);
+    if (!m_pendingSheets.contains(placeholder))
+        return qobject_cast<SheetWidget *>(placeholder);
+
+    const QSharedPointer<AbstractSheet> sheet = decodePendingSheet(placeholder);
+    m_pendingSheets.remove(placeholder);
+
+    // Swapped in place; to everyone else the tab stays the same
+    auto *widget = createSheetWidget(sheet);
+    {
+        const QSignalBlocker blocker(m_tabs);
+        const bool current = index == m_tabs->currentIndex();
+        const QString name = m_tabs->tabText(index);
+        m_tabs->insertTab(index, widget, name);
+        m_tabs->removeTab(index + 1);
+        if (current)
+            m_tabs->setCurrentIndex(index);
+    }
+
+    placeholder->deleteLater();
+
+    return widget;
+}
+
+
+void TableDocument::copy()
+{
+    auto *widget = currentSheetWidget();
+    if (!widget)
+        return;
+
+    const QRect range = widget->selectedRange();
+    if (range.isEmpty())
+        return;
+
+    m_clipboardValues = widget->model()->fetchRange(range.top(), range.left(), range.height(), range.width());
+    m_clipboardColumns = range.width();
+
+    // Other applications get tab separated text
+    QString text;
+    for (int row = 0; row < range.height(); ++row) {
+        for (int column = 0; column < range.width(); ++column) {
+            if (column)
+                text += QLatin1Char('\t');
+            text += m_clipboardValues.at(row * range.width() + column).toString(m_stringPool.data());
+        }
+        text += QLatin1Char('\n');
+    }
+
+    m_clipboardText = text;
+    QGuiApplication::clipboard()->setText(text);
+}
+
+
+void TableDocument::cut()
+{
+    auto *widget = currentSheetWidget();
+    if (!widget)
+        return;
+
+    copy();
+
+    const QRect range = widget->selectedRange();
+    if (!range.isEmpty())
+        widget->model()->setValues(range.top(), range.left(), range.height(), range.width(), QVector<CellValue>(range.width() * range.height()));
+}
+
+
+void TableDocument::paste()
+{
+    auto *widget = currentSheetWidget();
+    if (!widget)
+        return;
+
+    const QRect range = widget->selectedRange();
+    if (range.isEmpty())
+        return;
+
+    const QString text = QGuiApplication::clipboard()->text();
+    if (text.isEmpty())
+        return;
+
+    QVector<CellValue> values;
+    int columns = 0;
+
+    if (!m_clipboardValues.isEmpty() && text == m_clipboardText) {
+        // Our own copy; no parsing and no string lookups
+        values = m_clipboardValues;
+        columns = m_clipboardColumns;
+    }
+    else {
+        QStringList lines = text.split(QLatin1Char('\n'));
+        if (lines.last().isEmpty())
+            lines.removeLast();
+
+        QVector<QStringList> rows;
+        for (const QString &line : qAsConst(lines)) {
+            rows.append(line.split(QLatin1Char('\t')));
+            columns = qMax(columns, rows.last().size());
+        }
+
+        values.resize(rows.size() * columns);
+        for (int row = 0; row < rows.size(); ++row) {
+            const QStringList &fields = rows.at(row);
+            for (int column = 0; column < fields.size(); ++column) {
+                QStringView field(fields.at(column));
+                if (field.endsWith(QLatin1Char('\r')))
+                    field.chop(1);
+                values[row * columns + column] = CellValue::fromText(field, m_stringPool.data());
+            }
+        }
+    }
+
+    if (columns)
+        widget->model()->setValues(range.top(), range.left(), values.size() / columns, columns, values);
+}
+
+
+//
+// Slots
+//
+
+void TableDocument::slotAddTab(const int count)
+{
+    if (!m_tabs->count()) {
+
+        for (int i = 1; i <= count; ++i)
+            addSheet(QSharedPointer<AbstractSheet>(AbstractSheet::create(m_stringPool, 0, 0, 0)), tr("Sheet %1").arg(i));
+    }
+}
+
+
+void TableDocument::slotCloseTab(const int index)
+{
+    closeSheet(index);
+}
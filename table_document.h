@@ -25,7 +25,27 @@
 
 #include <QWidget>
 
+#include <QHash>
+#include <QSharedPointer>
 #include <QTabWidget>
+#include <QVariantMap>
+#include <QVector>
+
+#include <functional>
+
+#include "cell_value.h"
+#include "memory_usage.h"
+#include "sheet_model.h"
+#include "workbook_snapshot.h"
+
+class QTimer;
+
+class AbstractSheet;
+class Arena;
+class SheetLoader;
+class SheetSaver;
+class SheetWidget;
+class StringPool;
 
 
 class TableDocument : public QWidget
@@ -37,15 +57,48 @@ class TableDocument : public QWidget
     Q_PROPERTY(bool tabBarAutoHide READ isTabBarAutoHide WRITE setTabBarAutoHide RESET resetTabBarAutoHide NOTIFY tabBarAutoHideChanged)
 
 public:
+    using SheetDecoder = std::function<QSharedPointer<AbstractSheet>()>;
+
     explicit TableDocument(QWidget *parent = nullptr);
 
     void saveSettings();
 
+    QVariantMap documentSettings() const;
+    void setDocumentSettings(const QVariantMap &settings);
+
     bool isTabBarVisible() const;
     QTabWidget::TabPosition tabBarPosition() const;
     bool isTabBarAutoHide() const;
 
+    int sheetCount() const;
+    AbstractSheet *sheet(const int index) const;
+    AbstractSheet *currentSheet() const;
+    int currentSheetIndex() const;
+    QString sheetName(const int index) const;
+    void addSheet(const QSharedPointer<AbstractSheet> &sheet, const QString &name);
+    void addPendingSheet(const SheetDecoder &decoder, const QString &name);
+    void loadSheet(SheetLoader *loader, const QString &name);
+    void saveSheet(SheetSaver *saver, const int index);
+    bool isSheetBusy(const int index) const;
+    void moveSheet(const int from, const int to);
+    void closeSheet(const int index);
+
+    SheetModel *sheetModel(const int index);
+
+    QSharedPointer<const AbstractSheet> snapshotSheet(const int index) const;
+    bool snapshot(WorkbookSnapshot *snapshot, QString *errorString = nullptr) const;
+
+    QSharedPointer<Arena> arena() const;
+    QSharedPointer<StringPool> stringPool() const;
+
+    MemoryUsage memoryUsage() const;
+
 signals:
+    void sheetEdited(const int index, const SheetModel::Edit &edit);
+    void sheetMoved(const int from, const int to);
+    void sheetClosed(const int index);
+    void sheetLoaded(const int index);
+
     void tabBarVisibleChanged(const bool visible);
     void tabBarPositionChanged(const QTabWidget::TabPosition position);
     void tabBarAutoHideChanged(const bool enabled);
@@ -63,6 +116,10 @@ public slots:
     void resetTabBarAutoHide();
     void initTabBarAutoHide();
 
+    void copy();
+    void cut();
+    void paste();
+
 protected slots:
     void slotAddTab(const int count);
 
@@ -71,12 +128,40 @@ private:
 
     void _setTabBarVisible(const bool visible);
 
+    SheetWidget *currentSheetWidget() const;
+    SheetWidget *createSheetWidget(const QSharedPointer<AbstractSheet> &sheet);
+    SheetWidget *sheetWidget(const int index);
+
+    QWidget *addProgressIndicator(QWidget *widget, const QString &status, const QString &stopToolTip, const std::function<int()> &progress, const std::function<void()> &stop);
+    void removeProgressIndicator(QWidget *widget, QWidget *indicator);
+
+    QSharedPointer<AbstractSheet> decodePendingSheet(QWidget *placeholder);
+
 private slots:
     void slotCloseTab(const int index);
+    void slotDecodeSheet(const int index);
+    void slotDecodeIdleSheet();
 
 private:
     QTabWidget *m_tabs;
 
+    QSharedPointer<Arena> m_arena;
+    QSharedPointer<StringPool> m_stringPool;
+
+    // Tabs of sheets that have not been shown yet hold a placeholder; the
+    // sheet is decoded on first activation, or earlier in idle time
+    struct PendingSheet {
+        SheetDecoder decoder;
+        QSharedPointer<AbstractSheet> sheet;
+    };
+    QHash<QWidget *, PendingSheet> m_pendingSheets;
+    QTimer *m_idleTimer;
+
+    // Copied cells stay typed while the clipboard still holds our text
+    QVector<CellValue> m_clipboardValues;
+    int m_clipboardColumns;
+    QString m_clipboardText;
+
     bool m_tabBarVisible;
 };
 
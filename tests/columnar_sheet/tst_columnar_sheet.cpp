@@ -0,0 +1,209 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QHash>
+#include <QVector>
+#include <QtTest>
+
+#include "arena.h"
+#include "columnar_sheet.h"
+#include "string_pool.h"
+
+
+namespace {
+
+// Three chunks, the last one partly filled
+constexpr int Rows = 2 * SheetChunk::Rows + 20000;
+
+enum Column {
+    LongRuns,
+    FewDistinct,
+    Distinct,
+    Texts,
+    Columns
+};
+
+const char *const Names[] = {"north", "east", "south", "west", "a name too long to be kept inline"};
+
+
+bool toNumber(const CellValue &value, double *number)
+{
+    if (!value.isNumber() && value.type() != CellValue::Boolean)
+        return false;
+
+    *number = value.toReal();
+    return true;
+}
+
+} // namespace
+
+
+class TestColumnarSheet : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void columnOperations_data();
+    void columnOperations();
+    void statisticsAfterEdits();
+
+private:
+    QSharedPointer<StringPool> m_pool;
+    QSharedPointer<ColumnarSheet> m_sheet;
+};
+
+
+// Dictionary, run-length and plain chunks, with rows removed and inserted
+// so that logical rows no longer match the stored ones
+void TestColumnarSheet::init()
+{
+    m_pool.reset(new StringPool(QSharedPointer<Arena>(new Arena)));
+    m_sheet.reset(new ColumnarSheet(m_pool));
+    m_sheet->extend(Rows, Columns);
+
+    for (int row = 0; row < Rows; ++row) {
+        if (row % 10 == 9)
+            continue;
+
+        const char *name = Names[(row / 700) % 5];
+        m_sheet->setCell(row, LongRuns, CellValue::fromInteger(row / 1000));
+        m_sheet->setCell(row, FewDistinct, CellValue::fromReal(((row * 7) % 20) * 0.5));
+        m_sheet->setCell(row, Distinct, CellValue::fromInteger(Rows - row));
+        m_sheet->setCell(row, Texts, CellValue::fromUtf8(name, int(qstrlen(name)), m_pool.data()));
+    }
+
+    m_sheet->removeRows(1000, 5000);
+    m_sheet->insertRows(70000, 10);
+    m_sheet->compact();
+
+    QCOMPARE(m_sheet->chunk(LongRuns, 0).encoding(), SheetChunk::RunLength);
+    QCOMPARE(m_sheet->chunk(FewDistinct, 0).encoding(), SheetChunk::Dictionary);
+    QCOMPARE(m_sheet->chunk(Distinct, 0).encoding(), SheetChunk::Plain);
+    QCOMPARE(m_sheet->chunk(Texts, 0).encoding(), SheetChunk::RunLength);
+}
+
+
+void TestColumnarSheet::columnOperations_data()
+{
+    QTest::addColumn<int>("column");
+
+    QTest::newRow("run length") << int(LongRuns);
+    QTest::newRow("dictionary") << int(FewDistinct);
+    QTest::newRow("plain") << int(Distinct);
+    QTest::newRow("text") << int(Texts);
+}
+
+
+void TestColumnarSheet::columnOperations()
+{
+    QFETCH(int, column);
+
+    // The cells as the sheet hands them out are the reference
+    QVector<CellValue> reference(m_sheet->rowCount());
+    for (int row = 0; row < reference.size(); ++row)
+        reference[row] = m_sheet->cell(row, column);
+
+    ChunkAggregate expected;
+    QVector<int> above;
+    QVector<int> within;
+    QVector<int> named;
+    QHash<CellValue, qint64> expectedCounts;
+
+    const quint32 nameId = m_pool->internUtf8(Names[2], int(qstrlen(Names[2])));
+    for (int row = 0; row < reference.size(); ++row) {
+        const CellValue &value = reference.at(row);
+        if (value.isEmpty())
+            continue;
+
+        double number;
+        if (toNumber(value, &number)) {
+            expected.add(number, 1);
+            if (number > 5.0)
+                above.append(row);
+            if (number >= 20.0 && number <= 70000.0)
+                within.append(row);
+        }
+        if (value.isText() && value.toPooled(m_pool.data()).stringId() == nameId)
+            named.append(row);
+        ++expectedCounts[value];
+    }
+
+    const ChunkAggregate aggregate = m_sheet->aggregate(column);
+    QCOMPARE(aggregate.count, expected.count);
+    QCOMPARE(aggregate.sum, expected.sum);
+    QCOMPARE(aggregate.minimum, expected.minimum);
+    QCOMPARE(aggregate.maximum, expected.maximum);
+
+    QCOMPARE(m_sheet->filter(column, SheetChunk::RealPredicate([](const double value) { return value > 5.0; })), above);
+    QCOMPARE(m_sheet->filter(column, SheetChunk::StringPredicate([nameId](const quint32 id) { return id == nameId; })), named);
+    QCOMPARE(m_sheet->filterRange(column, 20.0, 70000.0), within);
+
+    // Keyed like the cells, so short text is inline and long text pooled
+    const QHash<CellValue, qint64> counts = m_sheet->countValues(column);
+    QCOMPARE(counts.size(), expectedCounts.size());
+    for (auto it = expectedCounts.cbegin(); it != expectedCounts.cend(); ++it)
+        QCOMPARE(counts.value(it.key()), it.value());
+}
+
+
+
+// The distinct column descends along the shown rows, though rows were
+// removed and inserted
+void TestColumnarSheet::statisticsAfterEdits()
+{
+    const auto isDescending = [this]() {
+        return bool(m_sheet->summary(Distinct).statistics.flags & ChunkStatistics::Descending);
+    };
+
+    QVERIFY(isDescending());
+    QCOMPARE(m_sheet->summary(Distinct).statistics.minimum, 1.0);
+    QCOMPARE(m_sheet->summary(Distinct).statistics.maximum, double(Rows));
+
+    m_sheet->setCell(100, Distinct, CellValue::fromInteger(2 * Rows));
+    const ChunkStatistics &edited = m_sheet->chunk(Distinct, 0).statistics();
+    QCOMPARE(edited.maximum, 2.0 * Rows);
+    QVERIFY(!(edited.flags & ChunkStatistics::Descending));
+    QVERIFY(!isDescending());
+    QCOMPARE(m_sheet->summary(Distinct).statistics.maximum, 2.0 * Rows);
+
+    m_sheet->setCell(100, Distinct, CellValue::fromInteger(Rows - 100));
+    QVERIFY(isDescending());
+    QCOMPARE(m_sheet->summary(Distinct).statistics.maximum, double(Rows));
+
+    // Stored last, so the stored rows still descend, but shown near the top
+    m_sheet->insertRows(10, 1);
+    m_sheet->setCell(10, Distinct, CellValue::fromInteger(0));
+    QVERIFY(m_sheet->chunk(Distinct, 2).statistics().flags & ChunkStatistics::Descending);
+    QVERIFY(!isDescending());
+    QCOMPARE(m_sheet->summary(Distinct).statistics.minimum, 0.0);
+    QCOMPARE(m_sheet->filterRange(Distinct, -1.0, 0.5), QVector<int>{10});
+
+    m_sheet->removeRows(10, 1);
+    QVERIFY(isDescending());
+    QCOMPARE(m_sheet->summary(Distinct).statistics.minimum, 1.0);
+}
+
+
+QTEST_APPLESS_MAIN(TestColumnarSheet)
+
+#include "tst_columnar_sheet.moc"
@@ -0,0 +1,159 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include "arena.h"
+#include "csv_index.h"
+#include "csv_reader.h"
+#include "string_pool.h"
+
+
+namespace {
+
+// Large enough for several segments, each of them several checkpoints long
+constexpr int Rows = 200000;
+constexpr int Columns = 4;
+
+// Rows of different lengths, with quoted delimiters, quotes and line
+// breaks that a segment cut at the wrong place would read as rows
+QByteArray makeRow(const int row)
+{
+    QByteArray bytes = QByteArray::number(row) + ',' + QByteArray::number(row * 0.25) + ',';
+    if (row % 3 == 0)
+        bytes += "\"text, with \"\"quotes\"\"\nand a line break " + QByteArray::number(row) + '"';
+    else
+        bytes += "text " + QByteArray::number(row);
+    bytes += ",name" + QByteArray::number(row % 7) + '\n';
+    return bytes;
+}
+
+} // namespace
+
+
+class TestCsvReader : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void checkpoints();
+    void indexedRead();
+
+private:
+    QSharedPointer<StringPool> m_pool;
+    QString m_fileName;
+    QByteArray m_bytes;
+    CsvIndex m_index;
+    QSharedPointer<AbstractSheet> m_sheet;
+    QTemporaryDir m_directory;
+};
+
+
+void TestCsvReader::initTestCase()
+{
+    QVERIFY(m_directory.isValid());
+
+    m_pool.reset(new StringPool(QSharedPointer<Arena>(new Arena)));
+
+    for (int row = 0; row < Rows; ++row)
+        m_bytes += makeRow(row);
+
+    m_fileName = m_directory.filePath(QStringLiteral("rows.csv"));
+    QFile file(m_fileName);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QCOMPARE(file.write(m_bytes), qint64(m_bytes.size()));
+    file.close();
+
+    // The first read finds the rows and indexes them
+    CsvReader reader(m_pool);
+    reader.setThreadCount(4);
+    QVERIFY2(reader.read(m_fileName), qPrintable(reader.errorString()));
+
+    m_sheet = reader.sheet();
+    m_index = reader.index();
+    QVERIFY(m_sheet);
+    QVERIFY(m_index.isValid());
+    QVERIFY(m_index.matches(m_fileName));
+}
+
+
+void TestCsvReader::checkpoints()
+{
+    QCOMPARE(m_index.rowCount(), qint64(Rows));
+
+    const QVector<CsvIndex::Checkpoint> checkpoints = m_index.checkpoints();
+    QVERIFY(checkpoints.size() >= Rows / CsvIndex::CheckpointRows);
+    QCOMPARE(checkpoints.first().row, qint64(0));
+    QCOMPARE(checkpoints.first().offset, qint64(0));
+
+    // Every checkpoint is at the first byte of its row, also where a quoted
+    // line break comes right before it
+    for (int index = 0; index < checkpoints.size(); ++index) {
+        const CsvIndex::Checkpoint &checkpoint = checkpoints.at(index);
+        QVERIFY(checkpoint.row >= 0 && checkpoint.row < Rows);
+        QVERIFY(index == 0 || checkpoint.row > checkpoints.at(index - 1).row);
+
+        const QByteArray row = makeRow(int(checkpoint.row));
+        QCOMPARE(m_bytes.mid(int(checkpoint.offset), row.size()), row);
+    }
+}
+
+
+void TestCsvReader::indexedRead()
+{
+    // Segments of the second read start at checkpoints in the middle of the
+    // file instead of searching for rows
+    CsvReader reader(m_pool);
+    reader.setThreadCount(4);
+    reader.setIndex(m_index);
+    QVERIFY2(reader.read(m_fileName), qPrintable(reader.errorString()));
+
+    const QSharedPointer<AbstractSheet> sheet = reader.sheet();
+    QVERIFY(sheet);
+    QCOMPARE(sheet->rowCount(), Rows);
+    QCOMPARE(sheet->columnCount(), Columns);
+
+    for (int row = 0; row < Rows; ++row) {
+        for (int column = 0; column < Columns; ++column) {
+            if (sheet->cell(row, column) != m_sheet->cell(row, column))
+                QFAIL(qPrintable(QStringLiteral("Cell %1, %2 differs").arg(row).arg(column)));
+        }
+    }
+
+    // Rows right at a checkpoint and right before it
+    for (const CsvIndex::Checkpoint &checkpoint : m_index.checkpoints()) {
+        for (const qint64 row : {checkpoint.row - 1, checkpoint.row}) {
+            if (row < 0)
+                continue;
+            QCOMPARE(sheet->cell(int(row), 0).integer(), row);
+            QCOMPARE(sheet->cell(int(row), 3).toString(m_pool.data()), QStringLiteral("name%1").arg(row % 7));
+        }
+    }
+}
+
+
+QTEST_APPLESS_MAIN(TestCsvReader)
+
+#include "tst_csv_reader.moc"
@@ -0,0 +1,263 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QRandomGenerator>
+#include <QtTest>
+
+#include "csv_scanner.h"
+
+
+namespace {
+
+// Bytes that matter to the scanner, some of them twice to make them
+// common, and bytes that are not ASCII
+const QByteArray Alphabet = QByteArray("ab1 ,,;\t\"\"'\n\r\\\\\x80\xa7\xc3\xff");
+
+QByteArray makeDialect(const char delimiter, const char quote, const char escape = 0)
+{
+    return QByteArray() + delimiter + quote + escape;
+}
+
+
+QByteArray generated(const quint32 seed, const int size)
+{
+    QRandomGenerator generator(seed);
+
+    QByteArray data(size, Qt::Uninitialized);
+    for (char &byte : data)
+        byte = Alphabet.at(int(generator.bounded(quint32(Alphabet.size()))));
+
+    return data;
+}
+
+
+// The data padded to whole blocks, as the reader pads the last one
+QByteArray padded(const QByteArray &data)
+{
+    const int blocks = (data.size() + CsvScanner::BlockSize - 1) / CsvScanner::BlockSize;
+    return data + QByteArray(blocks * CsvScanner::BlockSize - data.size(), '\0');
+}
+
+
+bool isSeparator(const char byte, const char delimiter)
+{
+    return byte == delimiter || byte == '\n' || byte == '\r';
+}
+
+
+// The separators outside of quotes, found one byte at a time
+QVector<quint64> expectedSeparators(const QByteArray &data, const QByteArray &dialect, bool *inQuotes, qint64 *quotes)
+{
+    const char delimiter = dialect.at(0);
+    const char quote = dialect.at(1);
+    const char escape = dialect.at(2);
+
+    QVector<quint64> masks(data.size() / CsvScanner::BlockSize);
+    bool escaped = false;
+    *inQuotes = false;
+    *quotes = 0;
+
+    for (int index = 0; index < data.size(); ++index) {
+        const char byte = data.at(index);
+        if (escaped) {
+            escaped = false;
+        }
+        else if (escape && byte == escape) {
+            escaped = true;
+        }
+        else if (byte == quote) {
+            *inQuotes = !*inQuotes;
+            ++*quotes;
+        }
+        else if (!*inQuotes && isSeparator(byte, delimiter)) {
+            masks[index / CsvScanner::BlockSize] |= Q_UINT64_C(1) << (index % CsvScanner::BlockSize);
+        }
+    }
+
+    return masks;
+}
+
+} // namespace
+
+
+class TestCsvScanner : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void classify_data();
+    void classify();
+    void scan_data();
+    void scan();
+    void countQuotes_data();
+    void countQuotes();
+
+private:
+    void addRows();
+};
+
+
+void TestCsvScanner::addRows()
+{
+    QTest::addColumn<int>("kernel");
+    QTest::addColumn<QByteArray>("dialect");
+    QTest::addColumn<QByteArray>("data");
+
+    const QByteArray comma = makeDialect(',', '"');
+    const QByteArray backslash = makeDialect(',', '"', '\\');
+    const QByteArray filler(CsvScanner::BlockSize - 1, 'x');
+
+    const QVector<CsvScanner::Kernel> kernels{CsvScanner::Scalar, CsvScanner::Sse2, CsvScanner::Avx2};
+    for (const CsvScanner::Kernel kernel : kernels) {
+        const QByteArray name = CsvScanner::kernelName(kernel).toLatin1() + ' ';
+        const auto addRow = [&](const char *row, const QByteArray &dialect, const QByteArray &data) {
+            QTest::newRow((name + row).constData()) << int(kernel) << dialect << data;
+        };
+
+        addRow("empty", comma, QByteArray());
+        addRow("plain", comma, "a,b,c\n1,2,3\n");
+        addRow("crlf", comma, "a,b\r\n1,2\r\n");
+        addRow("quoted separators", comma, "\"a,b\",\"c\nd\",\"e\r\nf\"\n");
+        addRow("doubled quotes", comma, "\"a\"\"b\",\"\"\"\",c\n");
+        addRow("open quote", comma, "a,\"b,c\nd,e");
+        addRow("block tail", comma, QByteArray(CsvScanner::BlockSize * 3 + 17, ','));
+        addRow("quote across blocks", comma, '"' + filler + ",\n\"" + filler + ",\n");
+        addRow("separator at block end", comma, filler + ',' + filler + '\n');
+        addRow("quote at block end", comma, filler + '"' + filler + '"' + ',');
+        addRow("delimiter is quote", makeDialect('"', '"'), "a\"b\",\"c\n");
+        addRow("semicolon", makeDialect(';', '"'), "a;b,c;\"d;e\"\n");
+        addRow("tab", makeDialect('\t', '\''), "a\tb\t'c\td'\t\"e\tf\"\n");
+        addRow("high delimiter", makeDialect('\xa7', '"'), "a\xa7\xc3\xa7\x80\"\xa7\"\xff\xa7\n");
+        addRow("high bytes", comma, QByteArray("\x80,\xff,\"\xfe,\",\xa7\xc3\n").repeated(11));
+        addRow("escapes", backslash, "a\\,b,\"c\\\"d\",e\\\\,f\\\n,g\n");
+        addRow("escaped quote in quotes", backslash, "\"a\\\"b,c\",d\n");
+        addRow("escape at block end", backslash, filler + '\\' + ",a," + filler + '\\' + "\"b,c\n");
+        addRow("escape run across blocks", backslash, QByteArray(CsvScanner::BlockSize - 2, 'x') + "\\\\\\,a,\\\\\\\\,b\n");
+
+        for (quint32 seed = 1; seed <= 8; ++seed) {
+            const int size = int(QRandomGenerator(seed).bounded(2000));
+            addRow(QByteArray("generated " + QByteArray::number(seed)).constData(), comma, generated(seed, size));
+            addRow(QByteArray("generated with escapes " + QByteArray::number(seed)).constData(), backslash, generated(seed, size));
+        }
+    }
+}
+
+
+void TestCsvScanner::classify_data()
+{
+    addRows();
+}
+
+
+void TestCsvScanner::classify()
+{
+    QFETCH(int, kernel);
+    QFETCH(QByteArray, dialect);
+    QFETCH(QByteArray, data);
+
+    if (!CsvScanner::isKernelSupported(CsvScanner::Kernel(kernel)))
+        QSKIP("The kernel is not supported by this processor.");
+
+    const char delimiter = dialect.at(0);
+    const char quote = dialect.at(1);
+    const QByteArray bytes = padded(data);
+
+    for (int block = 0; block < bytes.size() / CsvScanner::BlockSize; ++block) {
+        const char *first = bytes.constData() + block * CsvScanner::BlockSize;
+
+        // A delimiter equal to the quote character is a quote
+        quint64 expectedQuotes = 0;
+        quint64 expectedSeparators = 0;
+        for (int index = 0; index < CsvScanner::BlockSize; ++index) {
+            if (first[index] == quote)
+                expectedQuotes |= Q_UINT64_C(1) << index;
+            else if (isSeparator(first[index], delimiter))
+                expectedSeparators |= Q_UINT64_C(1) << index;
+        }
+
+        quint64 quotes;
+        quint64 separators;
+        CsvScanner::classify(CsvScanner::Kernel(kernel), first, delimiter, quote, &quotes, &separators);
+        QCOMPARE(quotes, expectedQuotes);
+        QCOMPARE(separators, expectedSeparators);
+    }
+}
+
+
+void TestCsvScanner::scan_data()
+{
+    addRows();
+}
+
+
+void TestCsvScanner::scan()
+{
+    QFETCH(int, kernel);
+    QFETCH(QByteArray, dialect);
+    QFETCH(QByteArray, data);
+
+    if (!CsvScanner::isKernelSupported(CsvScanner::Kernel(kernel)))
+        QSKIP("The kernel is not supported by this processor.");
+
+    const QByteArray bytes = padded(data);
+    bool inQuotes;
+    qint64 quotes;
+    const QVector<quint64> expected = expectedSeparators(bytes, dialect, &inQuotes, &quotes);
+
+    // Blocks are scanned in order, so quotes and escapes carry over
+    CsvScanner scanner(dialect.at(0), dialect.at(1), dialect.at(2));
+    scanner.setKernel(CsvScanner::Kernel(kernel));
+
+    for (int block = 0; block < expected.size(); ++block)
+        QCOMPARE(scanner.scan(bytes.constData() + block * CsvScanner::BlockSize), expected.at(block));
+    QCOMPARE(scanner.isInQuotes(), inQuotes);
+}
+
+
+void TestCsvScanner::countQuotes_data()
+{
+    addRows();
+}
+
+
+void TestCsvScanner::countQuotes()
+{
+    QFETCH(int, kernel);
+    QFETCH(QByteArray, dialect);
+    QFETCH(QByteArray, data);
+
+    if (!CsvScanner::isKernelSupported(CsvScanner::Kernel(kernel)))
+        QSKIP("The kernel is not supported by this processor.");
+
+    bool inQuotes;
+    qint64 quotes;
+    expectedSeparators(padded(data), dialect, &inQuotes, &quotes);
+
+    CsvScanner scanner(dialect.at(0), dialect.at(1), dialect.at(2));
+    scanner.setKernel(CsvScanner::Kernel(kernel));
+    QCOMPARE(scanner.countQuotes(data.constData(), data.size()), quotes);
+}
+
+
+QTEST_APPLESS_MAIN(TestCsvScanner)
+
+#include "tst_csv_scanner.moc"
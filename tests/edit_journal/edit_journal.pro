@@ -0,0 +1,43 @@
+#
+# Copyright 2022 naracanto <https://naracanto.github.io>.
+#
+# This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+#
+# QTabelo is an open source table editor written in C++ using the
+# Qt framework.
+#
+# QTabelo is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# QTabelo is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+#
+
+QT += testlib
+QT -= gui
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_edit_journal
+
+INCLUDEPATH += ../..
+
+HEADERS += \
+    ../../edit_journal.h
+
+SOURCES += \
+    tst_edit_journal.cpp \
+    ../../arena.cpp \
+    ../../cell_value.cpp \
+    ../../edit_journal.cpp \
+    ../../file_sync.cpp \
+    ../../memory_usage.cpp \
+    ../../string_pool.cpp
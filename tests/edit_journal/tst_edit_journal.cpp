@@ -0,0 +1,231 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include "arena.h"
+#include "edit_journal.h"
+#include "string_pool.h"
+
+
+namespace {
+
+// Too long to be kept inline, so that both kinds of text go through
+const QString LongText = QStringLiteral("a text too long to be kept inline");
+
+enum Damage {
+    CutChecksum,
+    CutPayload,
+    CutSize,
+    BadChecksum
+};
+
+EditJournal::Record record(const int target, const QVector<CellValue> &values = {})
+{
+    EditJournal::Record record;
+    record.target = target;
+    record.edit.row = 3;
+    record.edit.column = 2;
+    record.edit.rows = 1;
+    record.edit.columns = values.size();
+    record.edit.values = values;
+    return record;
+}
+
+} // namespace
+
+
+class TestEditJournal : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void roundTrip();
+    void damaged_data();
+    void damaged();
+    void rebase();
+
+private:
+    int recordCount(const QString &fileName);
+
+    QSharedPointer<StringPool> m_pool;
+    QString m_documentFileName;
+    QByteArray m_bytes;
+    int m_lastRecordAt = 0;
+    QTemporaryDir m_directory;
+};
+
+
+void TestEditJournal::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    QVERIFY(m_directory.isValid());
+
+    m_pool.reset(new StringPool(QSharedPointer<Arena>(new Arena)));
+
+    // Journals only read back against the file they were written for
+    m_documentFileName = m_directory.filePath(QStringLiteral("document.qtab"));
+    QFile document(m_documentFileName);
+    QVERIFY(document.open(QIODevice::WriteOnly));
+    QVERIFY(document.write("document") > 0);
+}
+
+
+int TestEditJournal::recordCount(const QString &fileName)
+{
+    QVector<EditJournal::Record> records;
+    return EditJournal::read(fileName, m_pool, &records) ? records.size() : -1;
+}
+
+
+void TestEditJournal::roundTrip()
+{
+    const QVector<CellValue> values = {
+        CellValue::fromInteger(42),
+        CellValue::fromReal(2.5),
+        CellValue::fromText(QStringLiteral("abc"), m_pool.data()),
+        CellValue::fromText(LongText, m_pool.data()),
+        CellValue()
+    };
+
+    EditJournal journal(m_pool);
+    QVERIFY(journal.open(m_documentFileName));
+
+    journal.append(1, record(1, values));
+    EditJournal::Record moved = record(2);
+    moved.kind = EditJournal::Record::SheetMoved;
+    moved.sheet = 1;
+    journal.append(2, moved);
+
+    // Written by the journal's own thread
+    QTRY_COMPARE(recordCount(journal.fileName()), 2);
+    m_lastRecordAt = int(QFileInfo(journal.fileName()).size());
+
+    EditJournal::Record removed = record(3);
+    removed.edit.operation = SheetModel::Edit::RemoveRows;
+    removed.edit.rows = 7;
+    journal.append(3, removed);
+    QTRY_COMPARE(recordCount(journal.fileName()), 3);
+
+    QVector<EditJournal::Record> records;
+    QString errorString;
+    QVERIFY2(EditJournal::read(journal.fileName(), m_pool, &records, &errorString), qPrintable(errorString));
+    QCOMPARE(EditJournal::documentFileName(journal.fileName()), QFileInfo(m_documentFileName).absoluteFilePath());
+
+    QCOMPARE(records.at(0).kind, EditJournal::Record::SheetEdited);
+    QCOMPARE(records.at(0).target, 1);
+    QCOMPARE(records.at(0).edit.operation, SheetModel::Edit::SetValues);
+    QCOMPARE(records.at(0).edit.row, 3);
+    QCOMPARE(records.at(0).edit.column, 2);
+    QCOMPARE(records.at(0).edit.columns, values.size());
+    QVERIFY(records.at(0).edit.values == values);
+    QCOMPARE(records.at(0).edit.values.at(3).toString(m_pool.data()), LongText);
+
+    QCOMPARE(records.at(1).kind, EditJournal::Record::SheetMoved);
+    QCOMPARE(records.at(1).sheet, 1);
+    QCOMPARE(records.at(1).target, 2);
+
+    QCOMPARE(records.at(2).edit.operation, SheetModel::Edit::RemoveRows);
+    QCOMPARE(records.at(2).edit.rows, 7);
+
+    QFile file(journal.fileName());
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    m_bytes = file.readAll();
+}
+
+
+void TestEditJournal::damaged_data()
+{
+    QTest::addColumn<int>("damage");
+
+    QTest::newRow("cut in the checksum") << int(CutChecksum);
+    QTest::newRow("cut in the payload") << int(CutPayload);
+    QTest::newRow("cut in the size") << int(CutSize);
+    QTest::newRow("bad checksum") << int(BadChecksum);
+}
+
+
+void TestEditJournal::damaged()
+{
+    QFETCH(int, damage);
+    QVERIFY(m_lastRecordAt > 0 && m_lastRecordAt < m_bytes.size());
+
+    // The last record is framed by 4 bytes of size and 2 of checksum
+    QByteArray bytes = m_bytes;
+    switch (damage) {
+    case CutChecksum:
+        bytes.chop(1);
+        break;
+    case CutPayload:
+        bytes.truncate(m_lastRecordAt + 4 + 5);
+        break;
+    case CutSize:
+        bytes.truncate(m_lastRecordAt + 2);
+        break;
+    case BadChecksum:
+        bytes[bytes.size() - 1] = char(bytes.at(bytes.size() - 1) ^ 0x5a);
+        break;
+    }
+
+    const QString fileName = m_directory.filePath(QStringLiteral("damaged-%1.journal").arg(damage));
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QCOMPARE(file.write(bytes), qint64(bytes.size()));
+    file.close();
+
+    // A torn record ends the journal; the ones before it are kept
+    QVector<EditJournal::Record> records;
+    QVERIFY(EditJournal::read(fileName, m_pool, &records));
+    QCOMPARE(records.size(), 2);
+    QCOMPARE(records.at(0).edit.values.at(0).integer(), Q_INT64_C(42));
+    QCOMPARE(records.at(1).kind, EditJournal::Record::SheetMoved);
+}
+
+
+void TestEditJournal::rebase()
+{
+    EditJournal journal(m_pool);
+    QVERIFY(journal.open(m_documentFileName));
+
+    for (int sequence = 1; sequence <= 4; ++sequence)
+        journal.append(quint64(sequence), record(sequence, {CellValue::fromInteger(sequence)}));
+    QTRY_COMPARE(recordCount(journal.fileName()), 4);
+
+    // Edits up to the second are saved; only the ones after stay
+    journal.rebase(m_documentFileName, 2);
+    QTRY_COMPARE(recordCount(journal.fileName()), 2);
+
+    QVector<EditJournal::Record> records;
+    QVERIFY(EditJournal::read(journal.fileName(), m_pool, &records));
+    QCOMPARE(records.at(0).target, 3);
+    QCOMPARE(records.at(1).target, 4);
+}
+
+
+QTEST_GUILESS_MAIN(TestEditJournal)
+
+#include "tst_edit_journal.moc"
@@ -0,0 +1,243 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QHash>
+#include <QRandomGenerator>
+#include <QVector>
+#include <QtTest>
+
+#include <functional>
+#include <utility>
+
+#include "sheet_chunk.h"
+
+
+namespace {
+
+constexpr int Rows = 4096;
+
+enum Values {
+    Distinct,
+    FewDistinct,
+    LongRuns
+};
+
+// The key of a row picks its value; every tenth row is left empty
+int makeKey(const int values, const int row, QRandomGenerator &random)
+{
+    switch (values) {
+    case Distinct:
+        return row;
+    case FewDistinct:
+        return int(random.bounded(20));
+    default:
+        return row / 500;
+    }
+}
+
+
+CellValue makeValue(const int type, const int key)
+{
+    switch (type) {
+    case SheetChunk::Integer:
+        return CellValue::fromInteger(key * 3 - 1000);
+    case SheetChunk::Real:
+        return CellValue::fromReal(key * 0.5 - 7.0);
+    case SheetChunk::Boolean:
+        return CellValue::fromBoolean(key % 2);
+    case SheetChunk::DateTime:
+        return CellValue::fromDateTime(qint64(key) * 86400000 + 12345);
+    case SheetChunk::String:
+        return CellValue::fromPooledText(quint32(key));
+    default:
+        switch (key % 5) {
+        case 0:
+            return CellValue::fromInteger(key);
+        case 1:
+            return CellValue::fromReal(key * 0.5);
+        case 2:
+            return CellValue::fromPooledText(quint32(key % 13));
+        case 3:
+            return CellValue::fromBoolean(key % 2);
+        default:
+            return CellValue::fromError(CellValue::ValueError);
+        }
+    }
+}
+
+
+// What the chunk methods are expected to see in a value
+bool toNumber(const CellValue &value, double *number)
+{
+    if (!value.isNumber() && value.type() != CellValue::Boolean)
+        return false;
+
+    *number = value.toReal();
+    return true;
+}
+
+
+bool toOrdinal(const CellValue &value, double *ordinal)
+{
+    if (value.type() == CellValue::DateTime) {
+        *ordinal = double(value.dateTime());
+        return true;
+    }
+    return toNumber(value, ordinal);
+}
+
+
+QVector<quint64> select(const QVector<CellValue> &reference, const std::function<bool(const CellValue &value)> &predicate)
+{
+    QVector<quint64> selection(Rows / 64, 0);
+    for (int row = 0; row < reference.size(); ++row) {
+        if (predicate(reference.at(row)))
+            selection[row >> 6] |= Q_UINT64_C(1) << (row & 63);
+    }
+    return selection;
+}
+
+} // namespace
+
+
+class TestSheetChunk : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void encodings_data();
+    void encodings();
+};
+
+
+void TestSheetChunk::encodings_data()
+{
+    QTest::addColumn<int>("type");
+    QTest::addColumn<int>("values");
+    QTest::addColumn<int>("encoding");
+
+    QTest::newRow("integer plain") << int(SheetChunk::Integer) << int(Distinct) << int(SheetChunk::Plain);
+    QTest::newRow("integer dictionary") << int(SheetChunk::Integer) << int(FewDistinct) << int(SheetChunk::Dictionary);
+    QTest::newRow("integer run length") << int(SheetChunk::Integer) << int(LongRuns) << int(SheetChunk::RunLength);
+    QTest::newRow("real plain") << int(SheetChunk::Real) << int(Distinct) << int(SheetChunk::Plain);
+    QTest::newRow("real dictionary") << int(SheetChunk::Real) << int(FewDistinct) << int(SheetChunk::Dictionary);
+    QTest::newRow("real run length") << int(SheetChunk::Real) << int(LongRuns) << int(SheetChunk::RunLength);
+    QTest::newRow("boolean plain") << int(SheetChunk::Boolean) << int(FewDistinct) << int(SheetChunk::Plain);
+    QTest::newRow("date dictionary") << int(SheetChunk::DateTime) << int(FewDistinct) << int(SheetChunk::Dictionary);
+    QTest::newRow("date run length") << int(SheetChunk::DateTime) << int(LongRuns) << int(SheetChunk::RunLength);
+    QTest::newRow("string plain") << int(SheetChunk::String) << int(Distinct) << int(SheetChunk::Plain);
+    QTest::newRow("string dictionary") << int(SheetChunk::String) << int(FewDistinct) << int(SheetChunk::Dictionary);
+    QTest::newRow("string run length") << int(SheetChunk::String) << int(LongRuns) << int(SheetChunk::RunLength);
+    QTest::newRow("mixed plain") << int(SheetChunk::Mixed) << int(Distinct) << int(SheetChunk::Plain);
+}
+
+
+void TestSheetChunk::encodings()
+{
+    QFETCH(int, type);
+    QFETCH(int, values);
+    QFETCH(int, encoding);
+
+    QRandomGenerator random(quint32(type * 3 + values));
+
+    SheetChunk chunk;
+    QVector<CellValue> reference(Rows);
+    for (int row = 0; row < Rows; ++row) {
+        if (row % 10 == 9)
+            continue;
+
+        reference[row] = makeValue(type, makeKey(values, row, random));
+        if (type == SheetChunk::Mixed)
+            chunk.setMixed(row, reference.at(row));
+        else
+            chunk.setValue(row, reference.at(row));
+    }
+
+    chunk.encode();
+    QCOMPARE(int(chunk.type()), type);
+    QCOMPARE(int(chunk.encoding()), encoding);
+
+    for (int row = 0; row < Rows; ++row)
+        QVERIFY2(chunk.value(row) == reference.at(row), qPrintable(QString::number(row)));
+
+    // Aggregate
+    ChunkAggregate expected;
+    for (const CellValue &value : qAsConst(reference)) {
+        double number;
+        if (toNumber(value, &number))
+            expected.add(number, 1);
+    }
+
+    ChunkAggregate aggregate;
+    chunk.aggregate(aggregate);
+    QCOMPARE(aggregate.count, expected.count);
+    QCOMPARE(aggregate.sum, expected.sum);
+    QCOMPARE(aggregate.minimum, expected.minimum);
+    QCOMPARE(aggregate.maximum, expected.maximum);
+
+    // Filters
+    QVector<quint64> selection(Rows / 64, 0);
+    chunk.filter(SheetChunk::RealPredicate([](const double value) { return value > 10.0; }), selection.data());
+    QCOMPARE(selection, select(reference, [](const CellValue &value) {
+        double number;
+        return toNumber(value, &number) && number > 10.0;
+    }));
+
+    selection.fill(0);
+    chunk.filter(SheetChunk::StringPredicate([](const quint32 id) { return id % 3 == 1; }), selection.data());
+    QCOMPARE(selection, select(reference, [](const CellValue &value) {
+        return value.type() == CellValue::PooledText && value.stringId() % 3 == 1;
+    }));
+
+    // Bounds taken from the values, so that both ends fall inside the chunk
+    double low = 0.0;
+    double high = 0.0;
+    toOrdinal(reference.at(Rows / 4), &low);
+    toOrdinal(reference.at(Rows / 2), &high);
+    if (low > high)
+        std::swap(low, high);
+
+    selection.fill(0);
+    chunk.filterRange(low, high, selection.data());
+    QCOMPARE(selection, select(reference, [low, high](const CellValue &value) {
+        double ordinal;
+        return toOrdinal(value, &ordinal) && ordinal >= low && ordinal <= high;
+    }));
+
+    // Value counts
+    QHash<CellValue, qint64> expectedCounts;
+    for (const CellValue &value : qAsConst(reference)) {
+        if (!value.isEmpty())
+            ++expectedCounts[value];
+    }
+
+    QHash<CellValue, qint64> counts;
+    chunk.countValues(counts);
+    QCOMPARE(counts.size(), expectedCounts.size());
+    for (auto it = expectedCounts.cbegin(); it != expectedCounts.cend(); ++it)
+        QCOMPARE(counts.value(it.key()), it.value());
+}
+
+
+QTEST_APPLESS_MAIN(TestSheetChunk)
+
+#include "tst_sheet_chunk.moc"
@@ -0,0 +1,329 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include <cstring>
+
+#include "columnar_sheet.h"
+#include "sparse_sheet.h"
+#include "workbook_file.h"
+
+
+namespace {
+
+// Values that are easy to find again in the saved file
+constexpr qint64 MixedMarker = Q_INT64_C(0x0123456789abcdef);
+constexpr qint32 SparseRow = 654321;
+constexpr qint32 SparseColumn = 777;
+
+constexpr int Rows = 4096;
+
+// Too long to be kept inline, so the sparse cell refers to the pool
+const char SparseText[] = "epsilon, pooled in the sparse sheet";
+
+// Where a CellValue keeps its size and its type
+constexpr int SizeOffset = CellValue::InlineSize;
+constexpr int TypeOffset = CellValue::InlineSize + 1;
+
+enum Corruption {
+    Truncated,
+    DictionaryCode,
+    RunEndOrder,
+    RunEndCapacity,
+    MixedType,
+    MixedString,
+    SparseType,
+    SparseInlineSize,
+    SparseString,
+    HashSlots
+};
+
+QByteArray words(const QVector<quint32> &values)
+{
+    return QByteArray(reinterpret_cast<const char *>(values.constData()), values.size() * int(sizeof(quint32)));
+}
+
+} // namespace
+
+
+class TestWorkbookFile : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void intact();
+    void saveChanges();
+    void corrupted_data();
+    void corrupted();
+
+private:
+    QByteArray m_bytes;
+    QByteArray m_hashSlots;
+    QTemporaryDir m_directory;
+};
+
+
+void TestWorkbookFile::initTestCase()
+{
+    QVERIFY(m_directory.isValid());
+
+    QSharedPointer<Arena> arena(new Arena);
+    QSharedPointer<StringPool> pool(new StringPool(arena));
+
+    // Dictionary, run-length and mixed chunks
+    QSharedPointer<ColumnarSheet> columnar(new ColumnarSheet(pool));
+    const quint32 names[] = {pool->internUtf8("alpha", 5), pool->internUtf8("beta", 4), pool->internUtf8("gamma", 5)};
+    for (int row = 0; row < Rows; ++row) {
+        columnar->setCell(row, 0, CellValue::fromPooledText(names[row % 3]));
+        columnar->setCell(row, 1, CellValue::fromInteger(row / 1000));
+        columnar->setCell(row, 2, CellValue::fromInteger(row));
+    }
+    columnar->setCell(0, 2, CellValue::fromInteger(MixedMarker));
+    columnar->setCell(1, 2, CellValue::fromPooledText(pool->internUtf8("delta", 5)));
+    columnar->compact();
+
+    QCOMPARE(columnar->chunk(0, 0).encoding(), SheetChunk::Dictionary);
+    QCOMPARE(columnar->chunk(1, 0).encoding(), SheetChunk::RunLength);
+    QCOMPARE(columnar->chunk(2, 0).type(), SheetChunk::Mixed);
+
+    QSharedPointer<SparseSheet> sparse(new SparseSheet(pool));
+    sparse->extend(SparseRow + 1, SparseColumn + 1);
+    sparse->setCell(SparseRow, SparseColumn, CellValue::fromUtf8(SparseText, int(sizeof(SparseText)) - 1, pool.data()));
+
+    WorkbookSnapshot snapshot;
+    snapshot.addSheet(QStringLiteral("Columnar"), columnar);
+    snapshot.addSheet(QStringLiteral("Sparse"), sparse);
+
+    const QString fileName = m_directory.filePath(QStringLiteral("intact.qtab"));
+    WorkbookFile workbook;
+    QVERIFY2(workbook.save(fileName, snapshot, pool), qPrintable(workbook.errorString()));
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    m_bytes = file.readAll();
+
+    QVector<StringPool::Record> records;
+    QVector<quint32> hashSlots;
+    pool->exportTable(0, &records, &hashSlots);
+    m_hashSlots = words(hashSlots);
+}
+
+
+void TestWorkbookFile::intact()
+{
+    QSharedPointer<Arena> arena(new Arena);
+    QSharedPointer<StringPool> pool(new StringPool(arena));
+
+    WorkbookFile workbook;
+    QVERIFY2(workbook.load(m_directory.filePath(QStringLiteral("intact.qtab")), arena, pool), qPrintable(workbook.errorString()));
+    QCOMPARE(workbook.sheetCount(), 2);
+
+    const QSharedPointer<AbstractSheet> columnar = workbook.sheet(0);
+    QVERIFY(columnar);
+    QCOMPARE(columnar->cell(4095, 1).integer(), Q_INT64_C(4));
+    QCOMPARE(columnar->cell(0, 2).integer(), MixedMarker);
+    QCOMPARE(columnar->cell(5, 0).toString(pool.data()), QStringLiteral("gamma"));
+
+    const QSharedPointer<AbstractSheet> sparse = workbook.sheet(1);
+    QVERIFY(sparse);
+    QCOMPARE(sparse->cell(SparseRow, SparseColumn).toString(pool.data()), QString::fromUtf8(SparseText));
+}
+
+
+void TestWorkbookFile::saveChanges()
+{
+    const QString fileName = m_directory.filePath(QStringLiteral("changes.qtab"));
+    QVERIFY(QFile::copy(m_directory.filePath(QStringLiteral("intact.qtab")), fileName));
+    const qint64 size = QFileInfo(fileName).size();
+
+    QSharedPointer<Arena> arena(new Arena);
+    QSharedPointer<StringPool> pool(new StringPool(arena));
+
+    WorkbookFile workbook;
+    QVERIFY2(workbook.load(fileName, arena, pool), qPrintable(workbook.errorString()));
+
+    const QSharedPointer<AbstractSheet> columnar = workbook.sheet(0);
+    const QSharedPointer<AbstractSheet> sparse = workbook.sheet(1);
+    const auto *chunks = dynamic_cast<const ColumnarSheet *>(columnar.data());
+    QVERIFY(chunks && sparse);
+
+    // One cell of the run-length chunk; every other chunk stays as stored
+    columnar->setCell(10, 1, CellValue::fromInteger(-5));
+    const qint64 chunkSize = chunks->chunk(1, 0).byteSize();
+
+    WorkbookSnapshot snapshot;
+    snapshot.addSheet(workbook.sheetName(0), columnar);
+    snapshot.addSheet(workbook.sheetName(1), sparse);
+
+    QVERIFY(workbook.canSaveChanges(fileName));
+    QVERIFY2(workbook.saveChanges(snapshot, pool), qPrintable(workbook.errorString()));
+
+    // The edited chunk and a new directory, each on their own pages
+    const qint64 grown = QFileInfo(fileName).size() - size;
+    QVERIFY2(grown >= chunkSize && grown <= chunkSize + 4 * WorkbookFile::PageSize, qPrintable(QString::number(grown)));
+
+    QSharedPointer<Arena> reloadedArena(new Arena);
+    QSharedPointer<StringPool> reloadedPool(new StringPool(reloadedArena));
+
+    WorkbookFile reloaded;
+    QVERIFY2(reloaded.load(fileName, reloadedArena, reloadedPool), qPrintable(reloaded.errorString()));
+    QCOMPARE(reloaded.sheetCount(), 2);
+
+    const QSharedPointer<AbstractSheet> edited = reloaded.sheet(0);
+    QVERIFY(edited);
+    QCOMPARE(edited->cell(10, 1).integer(), Q_INT64_C(-5));
+    QCOMPARE(edited->cell(11, 1).integer(), Q_INT64_C(0));
+    QCOMPARE(edited->cell(4095, 1).integer(), Q_INT64_C(4));
+    QCOMPARE(edited->cell(0, 2).integer(), MixedMarker);
+    QCOMPARE(edited->cell(5, 0).toString(reloadedPool.data()), QStringLiteral("gamma"));
+
+    const QSharedPointer<AbstractSheet> unchanged = reloaded.sheet(1);
+    QVERIFY(unchanged);
+    QCOMPARE(unchanged->cell(SparseRow, SparseColumn).toString(reloadedPool.data()), QString::fromUtf8(SparseText));
+}
+
+
+void TestWorkbookFile::corrupted_data()
+{
+    QTest::addColumn<int>("corruption");
+    QTest::addColumn<int>("sheet");
+
+    QTest::newRow("truncated") << int(Truncated) << 0;
+    QTest::newRow("dictionary code") << int(DictionaryCode) << 0;
+    QTest::newRow("run end order") << int(RunEndOrder) << 0;
+    QTest::newRow("run end capacity") << int(RunEndCapacity) << 0;
+    QTest::newRow("mixed type") << int(MixedType) << 0;
+    QTest::newRow("mixed string") << int(MixedString) << 0;
+    QTest::newRow("sparse type") << int(SparseType) << 1;
+    QTest::newRow("sparse inline size") << int(SparseInlineSize) << 1;
+    QTest::newRow("sparse string") << int(SparseString) << 1;
+    QTest::newRow("hash slots") << int(HashSlots) << -1;
+}
+
+
+void TestWorkbookFile::corrupted()
+{
+    QFETCH(int, corruption);
+    QFETCH(int, sheet);
+
+    QByteArray bytes = m_bytes;
+
+    QByteArray codes;
+    for (int index = 0; index < 64; ++index)
+        codes.append(char(index % 3));
+
+    const QByteArray runEnds = words({1000, 2000, 3000, 4000, quint32(Rows)});
+    const QByteArray marker(reinterpret_cast<const char *>(&MixedMarker), sizeof(MixedMarker));
+    const QByteArray cell = words({quint32(SparseRow), quint32(SparseColumn)});
+
+    const int codeAt = bytes.indexOf(codes);
+    const int runEndAt = bytes.indexOf(runEnds);
+    const int markerAt = bytes.indexOf(marker);
+    const int valueAt = bytes.indexOf(cell) + cell.size();
+    const int slotAt = bytes.indexOf(m_hashSlots);
+    QVERIFY(codeAt > 0 && runEndAt > 0 && markerAt > 0 && valueAt > cell.size() && slotAt > 0);
+
+    const quint32 badRunEnd = 500;
+    const quint32 badLastRunEnd = Rows + 64;
+    const quint32 badId = 0xffffffff;
+
+    switch (corruption) {
+    case Truncated:
+        bytes.truncate(bytes.size() / 2);
+        break;
+    case DictionaryCode:
+        bytes[codeAt + 10] = char(200);
+        break;
+    case RunEndOrder:
+        std::memcpy(bytes.data() + runEndAt + 4, &badRunEnd, sizeof(badRunEnd));
+        break;
+    case RunEndCapacity:
+        std::memcpy(bytes.data() + runEndAt + 16, &badLastRunEnd, sizeof(badLastRunEnd));
+        break;
+    case MixedType:
+        bytes[markerAt + TypeOffset] = char(42);
+        break;
+    case MixedString:
+        // The marker becomes the id of a string that is not in the pool
+        bytes[markerAt + TypeOffset] = char(CellValue::PooledText);
+        break;
+    case SparseType:
+        bytes[valueAt + TypeOffset] = char(42);
+        break;
+    case SparseInlineSize:
+        bytes[valueAt + TypeOffset] = char(CellValue::InlineText);
+        bytes[valueAt + SizeOffset] = char(200);
+        break;
+    case SparseString:
+        std::memcpy(bytes.data() + valueAt, &badId, sizeof(badId));
+        break;
+    case HashSlots:
+        // Every slot names the first string, so no probe would ever end
+        bytes.replace(slotAt, m_hashSlots.size(), words(QVector<quint32>(m_hashSlots.size() / int(sizeof(quint32)), 1)));
+        break;
+    }
+
+    const QString fileName = m_directory.filePath(QStringLiteral("corrupted-%1.qtab").arg(corruption));
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QCOMPARE(file.write(bytes), qint64(bytes.size()));
+    file.close();
+
+    QSharedPointer<Arena> arena(new Arena);
+    QSharedPointer<StringPool> pool(new StringPool(arena));
+
+    WorkbookFile workbook;
+    const bool loaded = workbook.load(fileName, arena, pool);
+    if (corruption == Truncated) {
+        QVERIFY(!loaded);
+        return;
+    }
+
+    if (corruption == HashSlots) {
+        // The table is rebuilt from the strings, so lookups still end
+        QVERIFY2(loaded, qPrintable(workbook.errorString()));
+        quint32 id;
+        QVERIFY(pool->find(QStringLiteral("gamma"), &id));
+        QCOMPARE(pool->string(id), QStringLiteral("gamma"));
+        const int count = pool->count();
+        QCOMPARE(pool->internUtf8("zeta", 4), quint32(count));
+        QCOMPARE(pool->internUtf8("zeta", 4), quint32(count));
+        QVERIFY(workbook.sheet(0) && workbook.sheet(1));
+        return;
+    }
+
+    // The file opens, as sheets are only listed, but the damaged sheet is
+    // rejected once it is decoded
+    QVERIFY2(loaded, qPrintable(workbook.errorString()));
+    QVERIFY(!workbook.sheet(sheet));
+    QVERIFY(workbook.sheet(1 - sheet));
+}
+
+
+QTEST_APPLESS_MAIN(TestWorkbookFile)
+
+#include "tst_workbook_file.moc"
@@ -0,0 +1,348 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "text_encoding.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define TEXT_ENCODING_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TEXT_ENCODING_AVX2
+#include <immintrin.h>
+#endif
+
+
+namespace {
+
+// Bytes looked at to tell encodings without a byte order mark apart
+constexpr qint64 DetectionSize = 64 * 1024;
+
+// Windows-1252 differs from Latin-1 only in these; the five undefined
+// bytes keep their Latin-1 control characters
+const ushort Windows1252High[32] = {
+    0x20ac, 0x0081, 0x201a, 0x0192, 0x201e, 0x2026, 0x2020, 0x2021,
+    0x02c6, 0x2030, 0x0160, 0x2039, 0x0152, 0x008d, 0x017d, 0x008f,
+    0x0090, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014,
+    0x02dc, 0x2122, 0x0161, 0x203a, 0x0153, 0x009d, 0x017e, 0x0178
+};
+
+
+//
+// Kernels
+//
+// Every kernel returns the number of ASCII bytes the data starts with.
+
+qint64 asciiLengthScalar(const char *data, const qint64 size)
+{
+    qint64 index = 0;
+    for (; index + 8 <= size; index += 8) {
+        quint64 word;
+        std::memcpy(&word, data + index, sizeof(word));
+        if (word & Q_UINT64_C(0x8080808080808080))
+            break;
+    }
+
+    while (index < size && !(data[index] & 0x80))
+        ++index;
+
+    return index;
+}
+
+
+#ifdef TEXT_ENCODING_SSE2
+qint64 asciiLengthSse2(const char *data, const qint64 size)
+{
+    qint64 index = 0;
+    for (; index + 16 <= size; index += 16) {
+        const int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + index)));
+        if (mask)
+            return index + qCountTrailingZeroBits(quint32(mask));
+    }
+
+    return index + asciiLengthScalar(data + index, size - index);
+}
+#endif
+
+
+#ifdef TEXT_ENCODING_AVX2
+__attribute__((target("avx2")))
+qint64 asciiLengthAvx2(const char *data, const qint64 size)
+{
+    qint64 index = 0;
+    for (; index + 32 <= size; index += 32) {
+        const int mask = _mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + index)));
+        if (mask)
+            return index + qCountTrailingZeroBits(quint32(mask));
+    }
+
+    return index + asciiLengthScalar(data + index, size - index);
+}
+#endif
+
+} // namespace
+
+
+TextEncoding::Kernel TextEncoding::kernel()
+{
+#ifdef TEXT_ENCODING_AVX2
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    if (avx2)
+        return Avx2;
+#endif
+
+#ifdef TEXT_ENCODING_SSE2
+    return Sse2;
+#else
+    return Scalar;
+#endif
+}
+
+
+QString TextEncoding::name(const Encoding encoding)
+{
+    switch (encoding) {
+    case Utf16LE:
+        return QStringLiteral("UTF-16LE");
+    case Utf16BE:
+        return QStringLiteral("UTF-16BE");
+    case Windows1252:
+        return QStringLiteral("Windows-1252");
+    default:
+        return QStringLiteral("UTF-8");
+    }
+}
+
+
+TextEncoding::Encoding TextEncoding::detect(const char *data, const qint64 size, int *bomSize)
+{
+    const auto *bytes = reinterpret_cast<const uchar *>(data);
+
+    *bomSize = 0;
+    if (size >= 3 && bytes[0] == 0xef && bytes[1] == 0xbb && bytes[2] == 0xbf) {
+        *bomSize = 3;
+        return Utf8;
+    }
+    if (size >= 2 && bytes[0] == 0xff && bytes[1] == 0xfe) {
+        *bomSize = 2;
+        return Utf16LE;
+    }
+    if (size >= 2 && bytes[0] == 0xfe && bytes[1] == 0xff) {
+        *bomSize = 2;
+        return Utf16BE;
+    }
+
+    // UTF-16 without a byte order mark still shows, as long as the text is
+    // mostly ASCII, as zero bytes in every other position
+    const qint64 units = qMin(size, DetectionSize) / 2;
+    qint64 evenZeros = 0;
+    qint64 oddZeros = 0;
+    for (qint64 unit = 0; unit < units; ++unit) {
+        evenZeros += !bytes[2 * unit];
+        oddZeros += !bytes[2 * unit + 1];
+    }
+
+    if (units >= 2 && oddZeros * 2 > units && evenZeros * 10 < units)
+        return Utf16LE;
+    if (units >= 2 && evenZeros * 2 > units && oddZeros * 10 < units)
+        return Utf16BE;
+
+    // A sequence cut off at the end of the sample does not count against UTF-8
+    qint64 length = qMin(size, DetectionSize);
+    if (length < size) {
+        for (int back = 1; back <= 3 && back <= length; ++back) {
+            const uchar byte = bytes[length - back];
+            if (byte >= 0xc0) {
+                length -= back;
+                break;
+            }
+            if (byte < 0x80)
+                break;
+        }
+    }
+
+    return isValidUtf8(data, length) ? Utf8 : Windows1252;
+}
+
+
+qint64 TextEncoding::asciiLength(const char *data, const qint64 size)
+{
+    return asciiLength(kernel(), data, size);
+}
+
+
+qint64 TextEncoding::asciiLength(const Kernel kernel, const char *data, const qint64 size)
+{
+    switch (kernel) {
+#ifdef TEXT_ENCODING_AVX2
+    case Avx2:
+        return asciiLengthAvx2(data, size);
+#endif
+#ifdef TEXT_ENCODING_SSE2
+    case Sse2:
+        return asciiLengthSse2(data, size);
+#endif
+    default:
+        return asciiLengthScalar(data, size);
+    }
+}
+
+
+bool TextEncoding::isValidUtf8(const char *data, const qint64 size)
+{
+    const auto *bytes = reinterpret_cast<const uchar *>(data);
+    const Kernel kernel = TextEncoding::kernel();
+
+    qint64 index = 0;
+    while (index < size) {
+
+        // Runs of ASCII are skipped a vector at a time
+        index += asciiLength(kernel, data + index, size - index);
+        if (index >= size)
+            break;
+
+        // Well-formed sequences as listed in RFC 3629
+        const uchar lead = bytes[index];
+        int length = 0;
+        uchar low = 0x80;
+        uchar high = 0xbf;
+        if (lead >= 0xc2 && lead <= 0xdf) {
+            length = 2;
+        }
+        else if (lead == 0xe0) {
+            length = 3;
+            low = 0xa0;
+        }
+        else if (lead == 0xed) {
+            length = 3;
+            high = 0x9f;
+        }
+        else if (lead >= 0xe1 && lead <= 0xef) {
+            length = 3;
+        }
+        else if (lead == 0xf0) {
+            length = 4;
+            low = 0x90;
+        }
+        else if (lead >= 0xf1 && lead <= 0xf3) {
+            length = 4;
+        }
+        else if (lead == 0xf4) {
+            length = 4;
+            high = 0x8f;
+        }
+        else {
+            return false;
+        }
+
+        if (size - index < length || bytes[index + 1] < low || bytes[index + 1] > high)
+            return false;
+        for (int offset = 2; offset < length; ++offset) {
+            if ((bytes[index + offset] & 0xc0) != 0x80)
+                return false;
+        }
+
+        index += length;
+    }
+
+    return true;
+}
+
+
+int TextEncoding::decodeWindows1252(const char *data, const int size, QChar *target)
+{
+    const auto *bytes = reinterpret_cast<const uchar *>(data);
+    for (int index = 0; index < size; ++index) {
+        const uchar byte = bytes[index];
+        target[index] = QChar(byte >= 0x80 && byte < 0xa0 ? Windows1252High[byte - 0x80] : ushort(byte));
+    }
+
+    return size;
+}
+
+
+qint64 TextEncoding::utf16ToUtf8(const char *data, const qint64 size, const bool bigEndian, char *target)
+{
+    // The target holds three bytes per code unit at most
+    const auto *bytes = reinterpret_cast<const uchar *>(data);
+    const qint64 units = size / 2;
+    const auto unitAt = [bytes, bigEndian](const qint64 index) -> uint {
+        const uchar *unit = bytes + 2 * index;
+        return bigEndian ? uint(unit[0] << 8 | unit[1]) : uint(unit[1] << 8 | unit[0]);
+    };
+
+    char *out = target;
+    qint64 index = 0;
+    while (index < units) {
+
+#ifdef TEXT_ENCODING_SSE2
+        // Runs of ASCII are narrowed eight code units at a time
+        const __m128i nonAscii = _mm_set1_epi16(short(0xff80));
+        for (; index + 8 <= units; index += 8) {
+            __m128i vector = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 2 * index));
+            if (bigEndian)
+                vector = _mm_or_si128(_mm_slli_epi16(vector, 8), _mm_srli_epi16(vector, 8));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(vector, nonAscii), _mm_setzero_si128())) != 0xffff)
+                break;
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out), _mm_packus_epi16(vector, vector));
+            out += 8;
+        }
+        if (index >= units)
+            break;
+#endif
+
+        uint c = unitAt(index++);
+
+        if (c < 0x80) {
+            *out++ = char(c);
+            continue;
+        }
+
+        if (c < 0x800) {
+            *out++ = char(0xc0 | (c >> 6));
+            *out++ = char(0x80 | (c & 0x3f));
+            continue;
+        }
+
+        if (QChar::isHighSurrogate(c) && index < units && QChar::isLowSurrogate(unitAt(index))) {
+            c = QChar::surrogateToUcs4(ushort(c), ushort(unitAt(index++)));
+            *out++ = char(0xf0 | (c >> 18));
+            *out++ = char(0x80 | ((c >> 12) & 0x3f));
+            *out++ = char(0x80 | ((c >> 6) & 0x3f));
+            *out++ = char(0x80 | (c & 0x3f));
+            continue;
+        }
+
+        // Unpaired surrogates cannot be encoded
+        if (QChar::isSurrogate(c))
+            c = QChar::ReplacementCharacter;
+
+        *out++ = char(0xe0 | (c >> 12));
+        *out++ = char(0x80 | ((c >> 6) & 0x3f));
+        *out++ = char(0x80 | (c & 0x3f));
+    }
+
+    return out - target;
+}
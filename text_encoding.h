@@ -0,0 +1,61 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEXT_ENCODING_H
+#define TEXT_ENCODING_H
+
+#include <QChar>
+#include <QString>
+
+
+class TextEncoding
+{
+public:
+    enum Encoding {
+        Utf8,
+        Utf16LE,
+        Utf16BE,
+        Windows1252
+    };
+
+    enum Kernel {
+        Scalar,
+        Sse2,
+        Avx2
+    };
+
+    static Kernel kernel();
+    static QString name(const Encoding encoding);
+
+    static Encoding detect(const char *data, const qint64 size, int *bomSize);
+
+    static qint64 asciiLength(const char *data, const qint64 size);
+    static bool isValidUtf8(const char *data, const qint64 size);
+
+    static int decodeWindows1252(const char *data, const int size, QChar *target);
+    static qint64 utf16ToUtf8(const char *data, const qint64 size, const bool bigEndian, char *target);
+
+private:
+    static qint64 asciiLength(const Kernel kernel, const char *data, const qint64 size);
+};
+
+#endif // TEXT_ENCODING_H
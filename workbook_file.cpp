@@ -0,0 +1,913 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "workbook_file.h"
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QScopedPointer>
+#include <QSysInfo>
+
+#include <climits>
+
+#include "columnar_sheet.h"
+#include "file_sync.h"
+#include "sparse_sheet.h"
+
+
+namespace {
+
+constexpr quint32 Magic = 0x51544142; // "QTAB"
+constexpr quint16 Version = 2;
+
+// Chunk statistics were added with the second version
+constexpr quint16 StatisticsVersion = 2;
+
+// Magic, version and where the directory is; the rest of the first page
+// stays empty
+constexpr int HeaderSize = 4 + 2 + 2 + 8 + 8;
+
+// Arrays behind the first one of a chunk only need to stay on cache lines
+constexpr qint64 LineSize = 64;
+
+// Files are rewritten once at least this much and half of them is dead
+constexpr qint64 CompactionSize = qint64(64) << 20;
+
+enum SheetKind : quint8 {
+    Columnar,
+    Sparse
+};
+
+using Blob = WorkbookFile::Blob;
+
+QDataStream &operator<<(QDataStream &stream, const Blob &blob)
+{
+    return stream << blob.offset << blob.size;
+}
+
+QDataStream &operator>>(QDataStream &stream, Blob &blob)
+{
+    return stream >> blob.offset >> blob.size;
+}
+
+QDataStream &operator<<(QDataStream &stream, const ChunkStatistics &statistics)
+{
+    stream << statistics.minimum << statistics.maximum << statistics.flags;
+    stream.writeRawData(reinterpret_cast<const char *>(statistics.sketch), ChunkStatistics::SketchSize);
+
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, ChunkStatistics &statistics)
+{
+    stream >> statistics.minimum >> statistics.maximum >> statistics.flags;
+    if (stream.readRawData(reinterpret_cast<char *>(statistics.sketch), ChunkStatistics::SketchSize) != ChunkStatistics::SketchSize)
+        stream.setStatus(QDataStream::ReadPastEnd);
+
+    return stream;
+}
+
+QByteArray header(const Blob &directory)
+{
+    QByteArray bytes;
+    QDataStream(&bytes, QIODevice::WriteOnly) << Magic << Version << quint16(0) << directory.offset << directory.size;
+
+    return bytes;
+}
+
+// Sparse sheets are stored cell by cell at their logical position
+struct StoredCell {
+    qint32 row;
+    qint32 column;
+    CellValue value;
+};
+
+
+class BlobWriter
+{
+public:
+    BlobWriter(QIODevice *device, const qint64 position)
+        : m_device{device}
+        , m_position{position}
+        , m_liveSize{0}
+        , m_previous{nullptr}
+        , m_mapping{nullptr}
+        , m_mappedSize{0}
+    {
+
+    }
+
+    // Arrays found here are in the file already and are not written again
+    void setStored(const WorkbookFile::StoredArrays *previous, const uchar *mapping, const qint64 mappedSize)
+    {
+        m_previous = previous;
+        m_mapping = mapping;
+        m_mappedSize = mappedSize;
+    }
+
+    qint64 position() const
+    {
+        return m_position;
+    }
+
+    qint64 liveSize() const
+    {
+        return m_liveSize;
+    }
+
+    WorkbookFile::StoredArrays takeStored()
+    {
+        return std::move(m_stored);
+    }
+
+    bool append(const char *data, const qint64 size)
+    {
+        if (m_device->write(data, size) != size)
+            return false;
+
+        m_position += size;
+        return true;
+    }
+
+    bool pad(const qint64 alignment)
+    {
+        const qint64 padding = (alignment - m_position % alignment) % alignment;
+        if (!padding)
+            return true;
+
+        const QByteArray zeros(int(padding), '\0');
+        return append(zeros.constData(), padding);
+    }
+
+    void reference(const Blob &blob)
+    {
+        m_liveSize += blob.size;
+    }
+
+    bool write(const char *data, const qint64 size, const qint64 alignment, Blob *blob)
+    {
+        *blob = Blob();
+        if (!size)
+            return true;
+
+        if (!pad(alignment))
+            return false;
+
+        blob->offset = m_position;
+        blob->size = size;
+        reference(*blob);
+
+        return append(data, size);
+    }
+
+    bool write(const QByteArray &bytes, const qint64 alignment, Blob *blob)
+    {
+        *blob = Blob();
+        if (bytes.isEmpty())
+            return true;
+
+        // Edits always detach an array from the file or from the copy held
+        // here, so an address that is known still holds the same data
+        const char *data = bytes.constData();
+        if (m_previous) {
+            const auto stored = m_previous->constFind(data);
+            if (stored != m_previous->constEnd() && stored->blob.size == bytes.size()) {
+                *blob = stored->blob;
+                reference(*blob);
+                m_stored.insert(data, {bytes, *blob});
+                return true;
+            }
+        }
+
+        const auto address = reinterpret_cast<quintptr>(data);
+        const auto mapping = reinterpret_cast<quintptr>(m_mapping);
+        if (m_mapping && address >= mapping + quintptr(WorkbookFile::PageSize) && address + quintptr(bytes.size()) <= mapping + quintptr(m_mappedSize)) {
+            blob->offset = qint64(address - mapping);
+            blob->size = bytes.size();
+            reference(*blob);
+            return true;
+        }
+
+        if (!write(data, bytes.size(), alignment, blob))
+            return false;
+
+        m_stored.insert(data, {bytes, *blob});
+        return true;
+    }
+
+private:
+    QIODevice *m_device;
+    qint64 m_position;
+    qint64 m_liveSize;
+
+    const WorkbookFile::StoredArrays *m_previous;
+    const uchar *m_mapping;
+    qint64 m_mappedSize;
+    WorkbookFile::StoredArrays m_stored;
+};
+
+
+class BlobReader
+{
+public:
+    BlobReader(const uchar *data, const qint64 begin, const qint64 end)
+        : m_data{data}
+        , m_begin{begin}
+        , m_end{end}
+    {
+
+    }
+
+    bool isValid(const Blob &blob, const qint64 alignment) const
+    {
+        if (!blob.size)
+            return true;
+
+        return blob.size > 0 && blob.offset >= m_begin && blob.offset <= m_end - blob.size && !(blob.offset % alignment);
+    }
+
+    const char *data(const Blob &blob) const
+    {
+        return reinterpret_cast<const char *>(m_data + blob.offset);
+    }
+
+    // Shares the mapping; nothing is copied until the array is written to
+    bool bytes(const Blob &blob, const qint64 alignment, QByteArray *bytes) const
+    {
+        if (!isValid(blob, alignment) || blob.size > INT_MAX)
+            return false;
+
+        *bytes = blob.size ? QByteArray::fromRawData(data(blob), int(blob.size)) : QByteArray();
+        return true;
+    }
+
+private:
+    const uchar *m_data;
+    qint64 m_begin;
+    qint64 m_end;
+};
+
+
+//
+// Writing
+//
+
+void writeAxis(QDataStream &section, const SheetAxis &axis)
+{
+    QVector<SheetAxis::Run> runs;
+    axis.forEachRun(0, axis.count(), [&runs](const SheetAxis::Run &run) {
+        runs.append(run);
+    });
+
+    section << qint32(runs.size());
+    for (const SheetAxis::Run &run : qAsConst(runs))
+        section << qint32(run.physical) << qint32(run.length);
+}
+
+
+bool writeChunk(BlobWriter &writer, QDataStream &section, const SheetChunk &chunk)
+{
+    const SheetChunk::Layout layout = chunk.layout();
+    section << quint8(layout.type) << quint8(layout.encoding) << layout.codeWidth
+            << qint32(layout.count) << qint32(layout.capacity) << qint32(layout.entries);
+
+    // Kept with the layout, so that skipping a chunk never touches its arrays
+    section << chunk.statistics();
+
+    Blob values, dictionary, validity;
+    if (!writer.write(chunk.valueBytes(), WorkbookFile::PageSize, &values)
+            || !writer.write(chunk.dictionaryBytes(), LineSize, &dictionary)
+            || !writer.write(chunk.validityBytes(), LineSize, &validity))
+        return false;
+
+    section << values << dictionary << validity;
+    return true;
+}
+
+
+bool writeSheet(BlobWriter &writer, QDataStream &section, const AbstractSheet *sheet)
+{
+    section << sheet->columnTitles();
+
+    const auto *columnarSheet = dynamic_cast<const ColumnarSheet *>(sheet);
+    if (!columnarSheet) {
+        QVector<StoredCell> cells;
+        cells.reserve(int(sheet->cellCount()));
+        sheet->forEachCell([&cells](const int row, const int column, const CellValue &value) {
+            if (row >= 0 && column >= 0)
+                cells.append({row, column, value});
+        });
+
+        Blob blob;
+        if (!writer.write(reinterpret_cast<const char *>(cells.constData()), cells.size() * qint64(sizeof(StoredCell)), WorkbookFile::PageSize, &blob))
+            return false;
+
+        section << quint8(Sparse) << qint32(sheet->rowCount()) << qint32(sheet->columnCount()) << blob;
+        return true;
+    }
+
+    // Chunks stay at their storage position and the axes are stored as
+    // runs, so that inserted and removed rows need no rewrite
+    section << quint8(Columnar);
+    writeAxis(section, sheet->rowAxis());
+    writeAxis(section, sheet->columnAxis());
+
+    section << qint32(columnarSheet->storedColumnCount());
+    for (int column = 0; column < columnarSheet->storedColumnCount(); ++column) {
+
+        section << qint32(columnarSheet->chunkCount(column));
+        for (int index = 0; index < columnarSheet->chunkCount(column); ++index) {
+            if (!writeChunk(writer, section, columnarSheet->chunk(column, index)))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+
+//
+// Reading
+//
+
+bool readRuns(QDataStream &section, QVector<SheetAxis::Run> *runs)
+{
+    qint32 count;
+    section >> count;
+
+    qint64 total = 0;
+    for (qint32 index = 0; index < count && section.status() == QDataStream::Ok; ++index) {
+        qint32 physical, length;
+        section >> physical >> length;
+
+        total += length;
+        if (physical < 0 || length <= 0 || qint64(physical) + length > INT_MAX || total > INT_MAX)
+            return false;
+
+        runs->append({0, physical, length});
+    }
+
+    return section.status() == QDataStream::Ok;
+}
+
+
+AbstractSheet *readColumnarSheet(QDataStream &section, const BlobReader &blobs, const QSharedPointer<StringPool> &pool, const quint16 version)
+{
+    QScopedPointer<ColumnarSheet> sheet(new ColumnarSheet(pool));
+
+    QVector<SheetAxis::Run> rows, columns;
+    if (!readRuns(section, &rows) || !readRuns(section, &columns))
+        return nullptr;
+
+    qint32 storedColumns;
+    section >> storedColumns;
+    if (storedColumns < 0)
+        return nullptr;
+
+    for (qint32 column = 0; column < storedColumns && section.status() == QDataStream::Ok; ++column) {
+
+        qint32 chunks;
+        section >> chunks;
+        if (chunks < 0 || qint64(chunks) * SheetChunk::Rows > qint64(INT_MAX) + SheetChunk::Rows)
+            return nullptr;
+
+        for (qint32 index = 0; index < chunks && section.status() == QDataStream::Ok; ++index) {
+
+            quint8 type, encoding, codeWidth;
+            qint32 count, capacity, entries;
+            section >> type >> encoding >> codeWidth >> count >> capacity >> entries;
+
+            ChunkStatistics statistics;
+            if (version >= StatisticsVersion)
+                section >> statistics;
+
+            Blob valueBlob, dictionaryBlob, validityBlob;
+            section >> valueBlob >> dictionaryBlob >> validityBlob;
+
+            QByteArray values, dictionary, validity;
+            if (!blobs.bytes(valueBlob, WorkbookFile::PageSize, &values) || !blobs.bytes(dictionaryBlob, LineSize, &dictionary)
+                    || !blobs.bytes(validityBlob, LineSize, &validity))
+                return nullptr;
+
+            const SheetChunk::Layout layout = {SheetChunk::Type(type), SheetChunk::Encoding(encoding), codeWidth, count, capacity, entries};
+            SheetChunk chunk;
+            if (!SheetChunk::fromLayout(layout, values, dictionary, validity, version >= StatisticsVersion ? &statistics : nullptr, pool->count(), &chunk))
+                return nullptr;
+
+            if (!chunk.isEmpty())
+                sheet->setChunk(column, index, chunk);
+        }
+    }
+
+    for (const SheetAxis::Run &run : qAsConst(rows))
+        sheet->appendStoredRows(run.physical, run.length);
+    for (const SheetAxis::Run &run : qAsConst(columns))
+        sheet->appendStoredColumns(run.physical, run.length);
+
+    return sheet.take();
+}
+
+
+AbstractSheet *readSparseSheet(QDataStream &section, const BlobReader &blobs, const QSharedPointer<StringPool> &pool)
+{
+    qint32 rows, columns;
+    Blob blob;
+    section >> rows >> columns >> blob;
+
+    if (rows < 0 || columns < 0 || !blobs.isValid(blob, alignof(StoredCell)) || blob.size % qint64(sizeof(StoredCell)))
+        return nullptr;
+
+    QScopedPointer<SparseSheet> sheet(new SparseSheet(pool));
+    sheet->extend(rows, columns);
+
+    const auto *cells = reinterpret_cast<const StoredCell *>(blobs.data(blob));
+    const qint64 count = blob.size / qint64(sizeof(StoredCell));
+    for (qint64 index = 0; index < count; ++index) {
+        const StoredCell &cell = cells[index];
+        if (cell.row < 0 || cell.row >= rows || cell.column < 0 || cell.column >= columns || !cell.value.isValid(pool->count()))
+            return nullptr;
+
+        sheet->setCell(cell.row, cell.column, cell.value);
+    }
+
+    return sheet.take();
+}
+
+
+AbstractSheet *readSheet(QDataStream &section, const BlobReader &blobs, const QSharedPointer<StringPool> &pool, const quint16 version)
+{
+    QStringList titles;
+    quint8 kind;
+    section >> titles >> kind;
+    if (section.status() != QDataStream::Ok)
+        return nullptr;
+
+    AbstractSheet *sheet = nullptr;
+    if (kind == Columnar)
+        sheet = readColumnarSheet(section, blobs, pool, version);
+    else if (kind == Sparse)
+        sheet = readSparseSheet(section, blobs, pool);
+
+    if (sheet && section.status() != QDataStream::Ok) {
+        delete sheet;
+        return nullptr;
+    }
+
+    if (sheet)
+        sheet->setColumnTitles(titles);
+
+    return sheet;
+}
+
+} // namespace
+
+
+WorkbookFile::WorkbookFile()
+    : m_fileSize{0}
+    , m_lastModified{0}
+    , m_mappingCurrent{false}
+    , m_data{nullptr}
+    , m_mappedSize{0}
+    , m_directoryOffset{0}
+    , m_version{Version}
+{
+
+}
+
+
+bool WorkbookFile::isWorkbookFile(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+    quint32 magic;
+    stream >> magic;
+
+    return stream.status() == QDataStream::Ok && magic == Magic;
+}
+
+
+QString WorkbookFile::fileName() const
+{
+    return m_fileName;
+}
+
+
+QVariantMap WorkbookFile::documentSettings() const
+{
+    return m_documentSettings;
+}
+
+
+void WorkbookFile::setDocumentSettings(const QVariantMap &settings)
+{
+    m_documentSettings = settings;
+}
+
+
+int WorkbookFile::sheetCount() const
+{
+    return m_sheetSections.size();
+}
+
+
+QString WorkbookFile::sheetName(const int index) const
+{
+    return m_sheetNames.value(index);
+}
+
+
+QSharedPointer<AbstractSheet> WorkbookFile::sheet(const int index) const
+{
+    if (index < 0 || index >= m_sheetSections.size())
+        return QSharedPointer<AbstractSheet>();
+
+    // Decoded anew on every call; all copies share the mapped chunks
+    QDataStream section(m_sheetSections.at(index));
+    section.setVersion(QDataStream::Qt_5_12);
+
+    const BlobReader blobs(m_data, PageSize, m_directoryOffset);
+    return QSharedPointer<AbstractSheet>(readSheet(section, blobs, m_pool, m_version));
+}
+
+
+qint64 WorkbookFile::deadSize() const
+{
+    return m_fileSize - m_contents.liveSize;
+}
+
+
+bool WorkbookFile::needsCompaction() const
+{
+    return deadSize() >= CompactionSize && deadSize() * 2 >= m_fileSize;
+}
+
+
+QString WorkbookFile::errorString() const
+{
+    return m_errorString;
+}
+
+
+//
+// Storage
+//
+
+bool WorkbookFile::load(const QString &fileName, const QSharedPointer<Arena> &arena, const QSharedPointer<StringPool> &pool)
+{
+    m_sheetNames.clear();
+    m_sheetSections.clear();
+    m_errorString.clear();
+
+    const auto fail = [this](const QString &errorString) {
+        m_errorString = errorString;
+        m_sheetNames.clear();
+        m_sheetSections.clear();
+        return false;
+    };
+    const QString damaged = QCoreApplication::translate("WorkbookFile", "The file is not a workbook or it is damaged.");
+
+    QSharedPointer<QFile> file(new QFile(fileName));
+    if (!file->open(QIODevice::ReadOnly))
+        return fail(file->errorString());
+
+    const qint64 size = file->size();
+    if (size < PageSize)
+        return fail(damaged);
+
+    const uchar *data = file->map(0, size);
+    if (!data)
+        return fail(file->errorString());
+
+    // Anything behind the directory is left from a save that did not finish
+    QDataStream header(QByteArray::fromRawData(reinterpret_cast<const char *>(data), HeaderSize));
+    quint32 magic;
+    quint16 version, reserved;
+    qint64 directoryOffset, directorySize;
+    header >> magic >> version >> reserved >> directoryOffset >> directorySize;
+    if (magic != Magic)
+        return fail(damaged);
+    if (version < 1 || version > Version)
+        return fail(QCoreApplication::translate("WorkbookFile", "The workbook was written by a newer version of the application."));
+    if (directoryOffset < PageSize || directorySize <= 0 || directorySize > INT_MAX || directoryOffset > size - directorySize)
+        return fail(damaged);
+
+    QDataStream directory(QByteArray::fromRawData(reinterpret_cast<const char *>(data + directoryOffset), int(directorySize)));
+    directory.setVersion(QDataStream::Qt_5_12);
+
+    // Arrays are used the way they were written
+    quint8 byteOrder;
+    directory >> byteOrder;
+    if (byteOrder != quint8(QSysInfo::ByteOrder))
+        return fail(QCoreApplication::translate("WorkbookFile", "The workbook was written on a system with a different byte order."));
+
+    QVariantMap settings;
+    qint64 liveSize;
+    directory >> settings >> liveSize;
+
+    const BlobReader blobs(data, PageSize, directoryOffset);
+
+    // Strings come in one segment per save since the last full one
+    qint32 segmentCount;
+    directory >> segmentCount;
+
+    QVector<StringSegment> stringSegments;
+    QVector<StringPool::Segment> segments;
+    for (qint32 index = 0; index < segmentCount && directory.status() == QDataStream::Ok; ++index) {
+
+        StringSegment segment;
+        directory >> segment.count >> segment.characters >> segment.records;
+        if (segment.count < 0 || !blobs.isValid(segment.characters, PageSize) || segment.characters.size % qint64(sizeof(QChar))
+                || !blobs.isValid(segment.records, PageSize) || segment.records.size != segment.count * qint64(sizeof(StringPool::Record)))
+            return fail(damaged);
+
+        stringSegments.append(segment);
+        segments.append({reinterpret_cast<const QChar *>(blobs.data(segment.characters)), segment.characters.size / qint64(sizeof(QChar)),
+                         reinterpret_cast<const StringPool::Record *>(blobs.data(segment.records)), segment.count});
+    }
+
+    Blob hashSlots;
+    directory >> hashSlots;
+    if (directory.status() != QDataStream::Ok || segmentCount < 0
+            || !blobs.isValid(hashSlots, PageSize) || hashSlots.size % qint64(sizeof(quint32)) || hashSlots.size / qint64(sizeof(quint32)) > INT_MAX)
+        return fail(damaged);
+
+    // Sheets are only listed here and decoded on demand
+    qint32 sheetCount;
+    directory >> sheetCount;
+    for (qint32 index = 0; index < sheetCount && directory.status() == QDataStream::Ok; ++index) {
+
+        QString name;
+        Blob section;
+        directory >> name >> section;
+
+        QByteArray bytes;
+        if (!section.size || !blobs.bytes(section, alignof(qint64), &bytes))
+            return fail(damaged);
+
+        m_sheetNames.append(name);
+        m_sheetSections.append(bytes);
+    }
+
+    if (directory.status() != QDataStream::Ok || sheetCount < 0)
+        return fail(damaged);
+
+    // The strings are taken over last, once nothing else can fail
+    const auto *slotData = hashSlots.size ? reinterpret_cast<const quint32 *>(blobs.data(hashSlots)) : nullptr;
+    if (!pool->restore(segments, slotData, int(hashSlots.size / qint64(sizeof(quint32)))))
+        return fail(damaged);
+
+    // Chunks and strings point into the mapping from now on
+    arena->addMappedFile(file);
+    m_file = file;
+    m_pool = pool;
+    m_data = data;
+    m_mappedSize = size;
+    m_directoryOffset = directoryOffset;
+    m_version = version;
+    m_documentSettings = settings;
+
+    Contents contents;
+    contents.liveSize = liveSize + directorySize + PageSize;
+    for (const StringSegment &segment : qAsConst(stringSegments))
+        contents.stringCount += segment.count;
+    contents.stringSegments = stringSegments;
+    contents.hashSlots = hashSlots;
+
+    m_fileName = fileName;
+    m_contents = contents;
+    m_mappingCurrent = true;
+    updateFileInfo();
+
+    return true;
+}
+
+
+bool WorkbookFile::save(const QString &fileName, const WorkbookSnapshot &snapshot, const QSharedPointer<StringPool> &pool, const CommitCheck &canCommit)
+{
+    m_errorString.clear();
+
+    // Written next to the file and renamed over it, so that a workbook
+    // that is mapped by an open document stays untouched
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        m_errorString = file.errorString();
+        return false;
+    }
+
+    Contents contents;
+    if (!write(&file, 0, snapshot, *pool, false, &contents)) {
+        m_errorString = file.errorString();
+        file.cancelWriting();
+        return false;
+    }
+
+    if (canCommit && !canCommit()) {
+        m_errorString = QCoreApplication::translate("WorkbookFile", "The file was changed while it was written.");
+        file.cancelWriting();
+        return false;
+    }
+
+    if (!file.commit()) {
+        m_errorString = file.errorString();
+        return false;
+    }
+
+    // Nothing in the file is where the mapping has it any more
+    m_fileName = fileName;
+    m_contents = contents;
+    m_mappingCurrent = false;
+    updateFileInfo();
+
+    return true;
+}
+
+
+bool WorkbookFile::canSaveChanges(const QString &fileName) const
+{
+    // Only to the file as it was left by the last load or save
+    const QFileInfo fileInfo(m_fileName);
+    return !m_fileName.isEmpty() && fileInfo == QFileInfo(fileName)
+            && fileInfo.size() == m_fileSize && fileInfo.lastModified().toMSecsSinceEpoch() == m_lastModified;
+}
+
+
+bool WorkbookFile::saveChanges(const WorkbookSnapshot &snapshot, const QSharedPointer<StringPool> &pool)
+{
+    m_errorString.clear();
+
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::ReadWrite) || !file.seek(m_fileSize)) {
+        m_errorString = file.errorString();
+        return false;
+    }
+
+    // Until the header is pointed at the new directory the file reads as
+    // it did before, so a save that fails half way loses nothing
+    Contents contents;
+    if (!write(&file, m_fileSize, snapshot, *pool, true, &contents)) {
+        m_errorString = file.errorString();
+        file.resize(m_fileSize);
+        return false;
+    }
+
+    file.close();
+    m_contents = contents;
+    updateFileInfo();
+
+    return true;
+}
+
+
+bool WorkbookFile::write(QFileDevice *device, const qint64 position, const WorkbookSnapshot &snapshot, const StringPool &pool, const bool append, Contents *contents) const
+{
+    BlobWriter writer(device, position);
+    if (append)
+        writer.setStored(&m_contents.storedArrays, m_mappingCurrent ? m_data : nullptr, m_mappedSize);
+    else if (!writer.append(QByteArray(int(PageSize), '\0').constData(), PageSize))
+        return false;
+
+    // Strings: those in the file already stay where they are, later ones
+    // follow as a segment of their own
+    QVector<StringSegment> segments = append ? m_contents.stringSegments : QVector<StringSegment>();
+    for (const StringSegment &segment : qAsConst(segments)) {
+        writer.reference(segment.characters);
+        writer.reference(segment.records);
+    }
+
+    const int first = append ? m_contents.stringCount : 0;
+    QVector<StringPool::Record> records;
+    QVector<quint32> hashSlots;
+    pool.exportTable(first, &records, append ? nullptr : &hashSlots);
+
+    if (!records.isEmpty()) {
+        StringSegment segment;
+        segment.count = records.size();
+
+        // All characters back to back, in pieces of a megabyte
+        if (!writer.pad(PageSize))
+            return false;
+        segment.characters.offset = writer.position();
+
+        QByteArray buffer;
+        for (int index = 0; index < records.size(); ++index) {
+            const QStringView text = pool.view(quint32(first + index));
+            buffer.append(reinterpret_cast<const char *>(text.data()), int(text.size() * qsizetype(sizeof(QChar))));
+
+            if (buffer.size() >= 1 << 20 || index == records.size() - 1) {
+                if (!writer.append(buffer.constData(), buffer.size()))
+                    return false;
+                buffer.clear();
+            }
+        }
+
+        segment.characters.size = writer.position() - segment.characters.offset;
+        if (segment.characters.size)
+            writer.reference(segment.characters);
+        else
+            segment.characters = Blob();
+
+        if (!writer.write(reinterpret_cast<const char *>(records.constData()), records.size() * qint64(sizeof(StringPool::Record)), PageSize, &segment.records))
+            return false;
+
+        segments.append(segment);
+    }
+
+    // The hash table of the pool is written with full saves only and kept
+    // as long as no strings are added; otherwise it is rebuilt on open
+    Blob slotBlob;
+    if (append && records.isEmpty()) {
+        slotBlob = m_contents.hashSlots;
+        writer.reference(slotBlob);
+    }
+    else if (!writer.write(reinterpret_cast<const char *>(hashSlots.constData()), hashSlots.size() * qint64(sizeof(quint32)), PageSize, &slotBlob)) {
+        return false;
+    }
+
+    // Each sheet gets a section of its own, so that it can be decoded
+    // without reading the others
+    QVector<Blob> sections;
+    for (int index = 0; index < snapshot.sheetCount(); ++index) {
+
+        QByteArray sectionData;
+        QDataStream section(&sectionData, QIODevice::WriteOnly);
+        section.setVersion(QDataStream::Qt_5_12);
+
+        Blob blob;
+        if (!writeSheet(writer, section, snapshot.sheet(index)) || section.status() != QDataStream::Ok
+                || !writer.write(sectionData.constData(), sectionData.size(), alignof(qint64), &blob))
+            return false;
+
+        sections.append(blob);
+    }
+
+    QByteArray directoryData;
+    QDataStream directory(&directoryData, QIODevice::WriteOnly);
+    directory.setVersion(QDataStream::Qt_5_12);
+
+    directory << quint8(QSysInfo::ByteOrder) << m_documentSettings << writer.liveSize();
+
+    directory << qint32(segments.size());
+    for (const StringSegment &segment : qAsConst(segments))
+        directory << qint32(segment.count) << segment.characters << segment.records;
+    directory << slotBlob;
+
+    directory << qint32(sections.size());
+    for (int index = 0; index < sections.size(); ++index)
+        directory << snapshot.sheetName(index) << sections.at(index);
+
+    if (directory.status() != QDataStream::Ok || !writer.pad(alignof(qint64)))
+        return false;
+
+    const Blob directoryBlob{writer.position(), directoryData.size()};
+    const qint64 liveSize = writer.liveSize() + directoryBlob.size + PageSize;
+    if (!writer.append(directoryData.constData(), directoryData.size()))
+        return false;
+
+    // The header goes last and points at the new directory. Everything it
+    // points at is on the disk before it, and it is on the disk before the
+    // save counts as done.
+    if (!FileSync::sync(*device) || !device->seek(0) || device->write(header(directoryBlob)) != HeaderSize || !FileSync::sync(*device))
+        return false;
+
+    contents->liveSize = liveSize;
+    contents->stringCount = first + records.size();
+    contents->stringSegments = segments;
+    contents->hashSlots = slotBlob;
+    contents->storedArrays = writer.takeStored();
+
+    return true;
+}
+
+
+void WorkbookFile::updateFileInfo()
+{
+    const QFileInfo fileInfo(m_fileName);
+    m_fileSize = fileInfo.size();
+    m_lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+}
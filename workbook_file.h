@@ -0,0 +1,144 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORKBOOK_FILE_H
+#define WORKBOOK_FILE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include <QVariantMap>
+#include <QVector>
+
+#include <functional>
+
+#include "abstract_sheet.h"
+#include "arena.h"
+#include "string_pool.h"
+#include "workbook_snapshot.h"
+
+class QFile;
+class QFileDevice;
+
+
+// Native workbook files keep all sheets the way they are held in memory:
+// the string pool and every column chunk are written as they are, each
+// chunk starting on a page boundary, behind a directory that describes
+// them. Opening a workbook maps the file, points the pool into the mapping
+// and reads no more than the list of sheets; a sheet is decoded when it is
+// asked for, by pointing its chunks into the mapping as well, and nothing
+// is copied until edited.
+//
+// Every chunk is listed with its statistics, so that filters can skip it
+// and column summaries are known without reading it.
+//
+// Files only ever grow between two full saves: saving changes appends the
+// chunks that were edited since, new strings and a new directory, and
+// points the header at the new directory once everything else is written.
+class WorkbookFile
+{
+public:
+    static constexpr qint64 PageSize = 4096;
+
+    // A stretch of the file
+    struct Blob {
+        qint64 offset = 0;
+        qint64 size = 0;
+    };
+
+    // An array that is in the file already; holding on to it keeps its
+    // address from being taken by other data
+    struct StoredArray {
+        QByteArray bytes;
+        Blob blob;
+    };
+    using StoredArrays = QHash<const char *, StoredArray>;
+
+    // Asked once the file is written, right before it replaces the old one
+    using CommitCheck = std::function<bool()>;
+
+    WorkbookFile();
+
+    static bool isWorkbookFile(const QString &fileName);
+
+    QString fileName() const;
+
+    QVariantMap documentSettings() const;
+    void setDocumentSettings(const QVariantMap &settings);
+
+    int sheetCount() const;
+    QString sheetName(const int index) const;
+    QSharedPointer<AbstractSheet> sheet(const int index) const;
+
+    bool load(const QString &fileName, const QSharedPointer<Arena> &arena, const QSharedPointer<StringPool> &pool);
+    bool save(const QString &fileName, const WorkbookSnapshot &snapshot, const QSharedPointer<StringPool> &pool, const CommitCheck &canCommit = nullptr);
+
+    bool canSaveChanges(const QString &fileName) const;
+    bool saveChanges(const WorkbookSnapshot &snapshot, const QSharedPointer<StringPool> &pool);
+
+    qint64 deadSize() const;
+    bool needsCompaction() const;
+
+    QString errorString() const;
+
+private:
+    struct StringSegment {
+        int count = 0;
+        Blob characters;
+        Blob records;
+    };
+
+    // What the file holds, so that later saves only add what changed
+    struct Contents {
+        qint64 liveSize = 0;
+        int stringCount = 0;
+        QVector<StringSegment> stringSegments;
+        Blob hashSlots;
+        StoredArrays storedArrays;
+    };
+
+    bool write(QFileDevice *device, const qint64 position, const WorkbookSnapshot &snapshot, const StringPool &pool, const bool append, Contents *contents) const;
+    void updateFileInfo();
+
+    QVariantMap m_documentSettings;
+    QString m_errorString;
+
+    QString m_fileName;
+    qint64 m_fileSize;
+    qint64 m_lastModified;
+    Contents m_contents;
+    bool m_mappingCurrent;
+
+    // Of the opened workbook; all sections point into the mapping
+    QSharedPointer<QFile> m_file;
+    QSharedPointer<StringPool> m_pool;
+    const uchar *m_data;
+    qint64 m_mappedSize;
+    qint64 m_directoryOffset;
+    quint16 m_version;
+    QStringList m_sheetNames;
+    QVector<QByteArray> m_sheetSections;
+};
+
+#endif // WORKBOOK_FILE_H
@@ -0,0 +1,102 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "workbook_saver.h"
+
+#include <QMutexLocker>
+
+#include "string_pool.h"
+
+
+WorkbookSaver::WorkbookSaver(const WorkbookSnapshot &snapshot, const QSharedPointer<StringPool> &pool, const QString &fileName, QObject *parent)
+    : QThread(parent)
+    , m_snapshot{snapshot}
+    , m_pool{pool}
+    , m_fileName{fileName}
+    , m_file{new WorkbookFile}
+    , m_failed{false}
+    , m_cancelled{false}
+    , m_committed{false}
+{
+
+}
+
+
+WorkbookSaver::~WorkbookSaver()
+{
+    // A rewrite that has not replaced the old file yet is dropped rather
+    // than renamed into place behind the document's back
+    cancel();
+    wait();
+}
+
+
+QString WorkbookSaver::fileName() const
+{
+    return m_fileName;
+}
+
+
+void WorkbookSaver::setDocumentSettings(const QVariantMap &settings)
+{
+    m_file->setDocumentSettings(settings);
+}
+
+
+QSharedPointer<WorkbookFile> WorkbookSaver::workbookFile() const
+{
+    return m_file;
+}
+
+
+bool WorkbookSaver::cancel()
+{
+    // Fails once the rewritten file is about to replace the old one
+    QMutexLocker locker(&m_mutex);
+    if (m_committed)
+        return false;
+
+    m_cancelled = true;
+    return true;
+}
+
+
+bool WorkbookSaver::hasFailed() const
+{
+    return m_failed;
+}
+
+
+QString WorkbookSaver::errorString() const
+{
+    return m_file->errorString();
+}
+
+
+void WorkbookSaver::run()
+{
+    m_failed = !m_file->save(m_fileName, m_snapshot, m_pool, [this]() {
+        QMutexLocker locker(&m_mutex);
+        m_committed = !m_cancelled;
+        return m_committed;
+    });
+}
@@ -0,0 +1,76 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORKBOOK_SAVER_H
+#define WORKBOOK_SAVER_H
+
+#include <QThread>
+
+#include <QMutex>
+#include <QSharedPointer>
+
+#include "workbook_file.h"
+#include "workbook_snapshot.h"
+
+class StringPool;
+
+
+// Rewrites a workbook file as a whole, leaving out everything that later
+// saves have made dead. Until the rewritten file replaces the old one the
+// rewrite can be canceled, so that changes can be saved to the old one.
+class WorkbookSaver : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit WorkbookSaver(const WorkbookSnapshot &snapshot, const QSharedPointer<StringPool> &pool, const QString &fileName, QObject *parent = nullptr);
+    ~WorkbookSaver() override;
+
+    QString fileName() const;
+
+    void setDocumentSettings(const QVariantMap &settings);
+
+    QSharedPointer<WorkbookFile> workbookFile() const;
+
+    bool cancel();
+
+    bool hasFailed() const;
+    QString errorString() const;
+
+protected:
+    void run() override;
+
+private:
+    // A snapshot, so that the sheets themselves can be edited meanwhile
+    WorkbookSnapshot m_snapshot;
+    QSharedPointer<StringPool> m_pool;
+    QString m_fileName;
+    QSharedPointer<WorkbookFile> m_file;
+    bool m_failed;
+
+    // Shared with the thread
+    QMutex m_mutex;
+    bool m_cancelled;
+    bool m_committed;
+};
+
+#endif // WORKBOOK_SAVER_H
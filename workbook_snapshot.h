@@ -0,0 +1,50 @@
+/**
+ * Copyright 2022 naracanto <https://naracanto.github.io>.
+ *
+ * This file is part of QTabelo <https://github.com/beletalabs/qtabelo>.
+ *
+ * QTabelo is an open source table editor written in C++ using the
+ * Qt framework.
+ *
+ * QTabelo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation, either version 3 of the License,
+ * or (at your option) any later version.
+ *
+ * QTabelo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with QTabelo.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORKBOOK_SNAPSHOT_H
+#define WORKBOOK_SNAPSHOT_H
+
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVector>
+
+#include "abstract_sheet.h"
+
+
+class WorkbookSnapshot
+{
+public:
+    WorkbookSnapshot();
+
+    bool isEmpty() const;
+    int sheetCount() const;
+    const AbstractSheet *sheet(const int index) const;
+    QString sheetName(const int index) const;
+
+    void addSheet(const QString &name, const QSharedPointer<const AbstractSheet> &sheet);
+
+private:
+    QVector<QSharedPointer<const AbstractSheet>> m_sheets;
+    QStringList m_sheetNames;
+};
+
+#endif // WORKBOOK_SNAPSHOT_H